@@ -0,0 +1,97 @@
+#include "BenchmarkData.h"
+#include <QDir>
+#include <QFile>
+#include <cmath>
+#include <random>
+
+namespace
+{
+  // One buffer view and one accessor per attribute, appended to the only buffer
+  int addAccessor(tinygltf::Model &model, const void *data, size_t bytes, int count, int type, int componentType)
+  {
+    tinygltf::Buffer &buffer = model.buffers[0];
+    tinygltf::BufferView view;
+    view.buffer = 0;
+    view.byteOffset = buffer.data.size();
+    view.byteLength = bytes;
+    const unsigned char *begin = static_cast<const unsigned char *>(data);
+    buffer.data.insert(buffer.data.end(), begin, begin + bytes);
+    model.bufferViews.push_back(view);
+
+    tinygltf::Accessor accessor;
+    accessor.bufferView = static_cast<int>(model.bufferViews.size()) - 1;
+    accessor.byteOffset = 0;
+    accessor.componentType = componentType;
+    accessor.type = type;
+    accessor.count = count;
+    model.accessors.push_back(accessor);
+    return static_cast<int>(model.accessors.size()) - 1;
+  }
+}
+
+QString BenchmarkData::sourcePath(const QString &relativePath)
+{
+  return QDir(PEELING_SOURCE_DIR).filePath(relativePath);
+}
+
+std::string BenchmarkData::readFile(const QString &relativePath)
+{
+  QFile file(sourcePath(relativePath));
+  if(!file.open(QIODevice::ReadOnly))
+  {
+    return std::string();
+  }
+  return file.readAll().toStdString();
+}
+
+tinygltf::Model BenchmarkData::syntheticModel(int vertexCount)
+{
+  std::mt19937 random(vertexCount);
+  std::uniform_real_distribution<float> noise(-0.05f, 0.05f);
+
+  std::vector<float> positions(vertexCount * 3);
+  std::vector<float> normals(vertexCount * 3);
+  std::vector<float> uvs(vertexCount * 2);
+  std::vector<float> colors(vertexCount * 3);
+  const float golden = 2.39996323f; // golden angle, spreads the vertices over the sphere
+  for(int i = 0; i < vertexCount; ++i)
+  {
+    const float y = 1.0f - 2.0f * (i + 0.5f) / vertexCount;
+    const float ring = std::sqrt(1.0f - y * y);
+    const float nx = std::cos(golden * i) * ring;
+    const float nz = std::sin(golden * i) * ring;
+    const float radius = 50.0f * (1.0f + noise(random));
+
+    positions[i * 3] = nx * radius;
+    positions[i * 3 + 1] = y * radius;
+    positions[i * 3 + 2] = nz * radius;
+    normals[i * 3] = nx;
+    normals[i * 3 + 1] = y;
+    normals[i * 3 + 2] = nz;
+    uvs[i * 2] = 0.5f + nx * 0.5f;
+    uvs[i * 2 + 1] = 0.5f + y * 0.5f;
+    colors[i * 3] = uvs[i * 2];
+    colors[i * 3 + 1] = uvs[i * 2 + 1];
+    colors[i * 3 + 2] = 0.5f;
+  }
+  const std::vector<uint32_t> indices = {0, 1, 2};
+
+  tinygltf::Model model;
+  model.buffers.resize(1);
+  tinygltf::Primitive primitive;
+  primitive.attributes["POSITION"] = addAccessor(model, positions.data(), positions.size() * sizeof(float), vertexCount,
+                                                 TINYGLTF_TYPE_VEC3, TINYGLTF_COMPONENT_TYPE_FLOAT);
+  primitive.attributes["NORMAL"] = addAccessor(model, normals.data(), normals.size() * sizeof(float), vertexCount,
+                                               TINYGLTF_TYPE_VEC3, TINYGLTF_COMPONENT_TYPE_FLOAT);
+  primitive.attributes["TEXCOORD_0"] = addAccessor(model, uvs.data(), uvs.size() * sizeof(float), vertexCount,
+                                                   TINYGLTF_TYPE_VEC2, TINYGLTF_COMPONENT_TYPE_FLOAT);
+  primitive.attributes["COLOR_0"] = addAccessor(model, colors.data(), colors.size() * sizeof(float), vertexCount,
+                                                TINYGLTF_TYPE_VEC3, TINYGLTF_COMPONENT_TYPE_FLOAT);
+  primitive.indices = addAccessor(model, indices.data(), indices.size() * sizeof(uint32_t), static_cast<int>(indices.size()),
+                                  TINYGLTF_TYPE_SCALAR, TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT);
+
+  tinygltf::Mesh mesh;
+  mesh.primitives.push_back(primitive);
+  model.meshes.push_back(mesh);
+  return model;
+}
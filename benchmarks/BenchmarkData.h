@@ -0,0 +1,21 @@
+#ifndef BENCHMARKDATA_H
+#define BENCHMARKDATA_H
+
+#include <QString>
+#include <string>
+#include <vector>
+#include "tiny_gltf.h"
+
+// Inputs of the benchmarks: the assets of the repository and synthetic meshes.
+// PEELING_SOURCE_DIR is set by benchmarks/CMakeLists.txt.
+namespace BenchmarkData
+{
+  QString sourcePath(const QString &relativePath);
+  std::string readFile(const QString &relativePath);
+
+  // A single primitive with every attribute of the brain asset (positions, normals, UVs, colors and indices),
+  // on a noisy sphere so the bounding box is not trivial
+  tinygltf::Model syntheticModel(int vertexCount);
+}
+
+#endif // BENCHMARKDATA_H
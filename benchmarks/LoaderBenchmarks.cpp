@@ -0,0 +1,168 @@
+#include <benchmark/benchmark.h>
+#include <QBuffer>
+#include <QImage>
+#include <webp/encode.h>
+#include "BenchmarkData.h"
+#include "SceneImporter.h"
+
+namespace tinygltf
+{
+  // Defined by the TINYGLTF_IMPLEMENTATION of SceneImporter.cpp, tiny_gltf.h only declares them in the implementation
+  std::string base64_encode(unsigned char const *bytes, unsigned int length);
+  std::string base64_decode(std::string const &encoded);
+}
+
+// ------------------------------------------------------ glTF parsing ------------------------------------------------------
+
+// The whole import of the brain asset from memory: JSON, base64 buffers and images, without the file read
+static void BM_ParseBrainGltf(benchmark::State &state)
+{
+  const std::string json = BenchmarkData::readFile("res/brain/brain.gltf");
+  if(json.empty())
+  {
+    state.SkipWithError("res/brain/brain.gltf not found");
+    return;
+  }
+  const std::string baseDirectory = BenchmarkData::sourcePath("res/brain").toStdString();
+
+  for(auto _ : state)
+  {
+    tinygltf::TinyGLTF loader;
+    loader.SetImageLoader(LoadWebPOrDefaultImage, nullptr);
+    tinygltf::Model model;
+    std::string err;
+    std::string warn;
+    const bool loaded = loader.LoadASCIIFromString(&model, &err, &warn, json.data(), static_cast<unsigned int>(json.size()), baseDirectory);
+    benchmark::DoNotOptimize(loaded);
+    benchmark::DoNotOptimize(model.buffers.data());
+  }
+  state.SetBytesProcessed(state.iterations() * json.size());
+}
+BENCHMARK(BM_ParseBrainGltf)->Unit(benchmark::kMillisecond);
+
+// The parsing and the conversion to a SceneData, what a widget waits for before the upload
+static void BM_ImportBrainScene(benchmark::State &state)
+{
+  const QString fileName = BenchmarkData::sourcePath("res/brain/brain.gltf");
+  for(auto _ : state)
+  {
+    SceneData scene;
+    const bool imported = SceneImporter::import(fileName, scene);
+    if(!imported)
+    {
+      state.SkipWithError("res/brain/brain.gltf could not be imported");
+      return;
+    }
+    benchmark::DoNotOptimize(scene.vertices.data());
+  }
+}
+BENCHMARK(BM_ImportBrainScene)->Unit(benchmark::kMillisecond);
+
+// ------------------------------------------------------ base64 ------------------------------------------------------
+
+static void BM_Base64Decode(benchmark::State &state)
+{
+  std::vector<unsigned char> bytes(state.range(0));
+  for(size_t i = 0; i < bytes.size(); ++i)
+  {
+    bytes[i] = static_cast<unsigned char>(i * 2654435761u >> 24);
+  }
+  const std::string encoded = tinygltf::base64_encode(bytes.data(), static_cast<unsigned int>(bytes.size()));
+
+  for(auto _ : state)
+  {
+    std::string decoded = tinygltf::base64_decode(encoded);
+    benchmark::DoNotOptimize(decoded.data());
+  }
+  state.SetBytesProcessed(state.iterations() * encoded.size());
+}
+BENCHMARK(BM_Base64Decode)->RangeMultiplier(8)->Range(64 << 10, 64 << 20)->Unit(benchmark::kMillisecond);
+
+// The buffer of the brain asset, as embedded in brain.gltf
+static void BM_Base64DecodeBrain(benchmark::State &state)
+{
+  const std::string json = BenchmarkData::readFile("res/brain/brain.gltf");
+  const std::string header = "base64,";
+  const size_t begin = json.find(header);
+  if(begin == std::string::npos)
+  {
+    state.SkipWithError("no base64 buffer in res/brain/brain.gltf");
+    return;
+  }
+  const size_t end = json.find('"', begin);
+  const std::string encoded = json.substr(begin + header.size(), end - begin - header.size());
+
+  for(auto _ : state)
+  {
+    std::string decoded = tinygltf::base64_decode(encoded);
+    benchmark::DoNotOptimize(decoded.data());
+  }
+  state.SetBytesProcessed(state.iterations() * encoded.size());
+}
+BENCHMARK(BM_Base64DecodeBrain)->Unit(benchmark::kMillisecond);
+
+// ------------------------------------------------------ Images ------------------------------------------------------
+
+namespace
+{
+  // A smooth gradient with some noise, compresses like a texture rather than like a flat color
+  std::vector<uint8_t> syntheticImage(int size)
+  {
+    std::vector<uint8_t> pixels(size * size * 4);
+    for(int y = 0; y < size; ++y)
+    {
+      for(int x = 0; x < size; ++x)
+      {
+        uint8_t *pixel = &pixels[(y * size + x) * 4];
+        const uint8_t noise = static_cast<uint8_t>((x * 7919 + y * 104729) & 15);
+        pixel[0] = static_cast<uint8_t>(x * 255 / size) ^ noise;
+        pixel[1] = static_cast<uint8_t>(y * 255 / size);
+        pixel[2] = static_cast<uint8_t>((x + y) * 127 / size);
+        pixel[3] = 255;
+      }
+    }
+    return pixels;
+  }
+
+  void decode(benchmark::State &state, const std::vector<uint8_t> &encoded, int size)
+  {
+    for(auto _ : state)
+    {
+      tinygltf::Image image;
+      std::string err;
+      std::string warn;
+      const bool decoded = LoadWebPOrDefaultImage(&image, 0, &err, &warn, 0, 0, encoded.data(), static_cast<int>(encoded.size()), nullptr);
+      benchmark::DoNotOptimize(decoded);
+      benchmark::DoNotOptimize(image.image.data());
+    }
+    state.SetItemsProcessed(state.iterations() * size * size); // pixels
+  }
+}
+
+static void BM_LoadWebPImage(benchmark::State &state)
+{
+  const int size = static_cast<int>(state.range(0));
+  const std::vector<uint8_t> pixels = syntheticImage(size);
+  uint8_t *output = nullptr;
+  const size_t bytes = WebPEncodeRGBA(pixels.data(), size, size, size * 4, 90.0f, &output);
+  const std::vector<uint8_t> encoded(output, output + bytes);
+  WebPFree(output);
+
+  decode(state, encoded, size);
+}
+BENCHMARK(BM_LoadWebPImage)->RangeMultiplier(4)->Range(256, 4096)->Unit(benchmark::kMillisecond);
+
+// The images that are not WebP go through stb_image
+static void BM_LoadPngImage(benchmark::State &state)
+{
+  const int size = static_cast<int>(state.range(0));
+  std::vector<uint8_t> pixels = syntheticImage(size);
+  QByteArray png;
+  QBuffer buffer(&png);
+  buffer.open(QIODevice::WriteOnly);
+  QImage(pixels.data(), size, size, QImage::Format_RGBA8888).save(&buffer, "PNG");
+  const std::vector<uint8_t> encoded(png.begin(), png.end());
+
+  decode(state, encoded, size);
+}
+BENCHMARK(BM_LoadPngImage)->RangeMultiplier(4)->Range(256, 4096)->Unit(benchmark::kMillisecond);
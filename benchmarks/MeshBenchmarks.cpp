@@ -0,0 +1,83 @@
+#include <benchmark/benchmark.h>
+#include "BenchmarkData.h"
+#include "SceneImporter.h"
+
+// The vertex assembly of SceneImporter: the attribute loops and centerModel
+static void BM_AssembleVertices(benchmark::State &state)
+{
+  const int vertexCount = static_cast<int>(state.range(0));
+  const tinygltf::Model model = BenchmarkData::syntheticModel(vertexCount);
+  const tinygltf::Primitive &primitive = model.meshes[0].primitives[0];
+
+  std::vector<SceneData::Vertex> vertices;
+  for(auto _ : state)
+  {
+    SceneImporter::assembleVertices(model, primitive, vertices);
+    benchmark::DoNotOptimize(vertices.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * vertexCount);
+  state.SetBytesProcessed(state.iterations() * vertexCount * sizeof(SceneData::Vertex));
+}
+BENCHMARK(BM_AssembleVertices)->RangeMultiplier(10)->Range(10000, 10000000)->Unit(benchmark::kMillisecond);
+
+static void BM_CenterModel(benchmark::State &state)
+{
+  const int vertexCount = static_cast<int>(state.range(0));
+  const tinygltf::Model model = BenchmarkData::syntheticModel(vertexCount);
+  std::vector<SceneData::Vertex> source;
+  SceneImporter::assembleVertices(model, model.meshes[0].primitives[0], source);
+
+  std::vector<SceneData::Vertex> vertices;
+  for(auto _ : state)
+  {
+    // The vertices shrink at every call, they would end up denormal
+    state.PauseTiming();
+    vertices = source;
+    state.ResumeTiming();
+    SceneImporter::centerModel(vertices);
+    benchmark::DoNotOptimize(vertices.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * vertexCount);
+}
+BENCHMARK(BM_CenterModel)->RangeMultiplier(10)->Range(10000, 10000000)->Unit(benchmark::kMillisecond);
+
+// What a depth-only pass reads of each GLTFLoader::VertexLayout: every position, strided by sizeof(Vertex) when
+// interleaved, packed when split. Only a CPU bound of the fetch, VertexLayoutBenchmark measures the driver.
+static void BM_PositionFetch(benchmark::State &state)
+{
+  const int vertexCount = static_cast<int>(state.range(0));
+  const bool split = state.range(1) != 0;
+  const tinygltf::Model model = BenchmarkData::syntheticModel(vertexCount);
+  std::vector<SceneData::Vertex> vertices;
+  SceneImporter::assembleVertices(model, model.meshes[0].primitives[0], vertices);
+  std::vector<QVector3D> positions;
+  for(const auto &vertex : vertices)
+  {
+    positions.push_back(vertex.position);
+  }
+
+  for(auto _ : state)
+  {
+    QVector3D sum;
+    if(split)
+    {
+      for(const QVector3D &position : positions)
+      {
+        sum += position;
+      }
+    }
+    else
+    {
+      for(const SceneData::Vertex &vertex : vertices)
+      {
+        sum += vertex.position;
+      }
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetLabel(split ? "split" : "interleaved");
+  state.SetBytesProcessed(state.iterations() * vertexCount * (split ? sizeof(QVector3D) : sizeof(SceneData::Vertex)));
+}
+BENCHMARK(BM_PositionFetch)->ArgsProduct({{100000, 10000000}, {0, 1}})->Unit(benchmark::kMillisecond);
@@ -0,0 +1,30 @@
+#include <benchmark/benchmark.h>
+#include "BenchmarkData.h"
+#include "ShaderManager.h"
+
+// Read, parse and expand main.fs.glsl and its includes, as on the first build of a program
+static void BM_BuildShaderCold(benchmark::State &state)
+{
+  const QString directory = BenchmarkData::sourcePath("shaders/Mix");
+  for(auto _ : state)
+  {
+    ShaderManager manager(directory);
+    manager.loadModule("main.fs.glsl");
+    const QString source = manager.buildShader("main.fs.glsl");
+    benchmark::DoNotOptimize(source.constData());
+  }
+}
+BENCHMARK(BM_BuildShaderCold)->Unit(benchmark::kMicrosecond);
+
+// The modules are parsed once, only the expansion is measured, as for the variants of a program
+static void BM_BuildShaderWarm(benchmark::State &state)
+{
+  ShaderManager manager(BenchmarkData::sourcePath("shaders/Mix"));
+  manager.loadModule("main.fs.glsl");
+  for(auto _ : state)
+  {
+    const QString source = manager.buildShader("main.fs.glsl");
+    benchmark::DoNotOptimize(source.constData());
+  }
+}
+BENCHMARK(BM_BuildShaderWarm)->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+"""Compare a Google Benchmark JSON output to a baseline.
+
+Usage: check_regressions.py baseline.json current.json [--tolerance 0.15]
+       check_regressions.py baseline.json current.json --record
+
+The median of each benchmark is compared to the baseline, the script fails if one is slower
+by more than the tolerance, or if there is no baseline. --record makes the current results
+the baseline instead of comparing them.
+"""
+
+import argparse
+import json
+import os
+import shutil
+import sys
+
+
+def medians(path):
+    with open(path) as file:
+        results = json.load(file)
+    times = {}
+    for benchmark in results.get("benchmarks", []):
+        # Runs with repetitions report aggregates, the median is the least noisy
+        if benchmark.get("aggregate_name", "median") != "median":
+            continue
+        if benchmark.get("error_occurred"):
+            continue
+        name = benchmark.get("run_name", benchmark["name"])
+        times[name] = benchmark["real_time"], benchmark["time_unit"]
+    return times
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--tolerance", type=float, default=0.15)
+    parser.add_argument("--record", action="store_true", help="replace the baseline with the current results")
+    arguments = parser.parse_args()
+
+    if arguments.record:
+        shutil.copyfile(arguments.current, arguments.baseline)
+        print("{} recorded".format(arguments.baseline))
+        return 0
+    if not os.path.exists(arguments.baseline):
+        print("No baseline {}, record one with the record_benchmarks target".format(arguments.baseline))
+        return 1
+
+    baseline = medians(arguments.baseline)
+    current = medians(arguments.current)
+    regressions = 0
+    for name, (time, unit) in sorted(current.items()):
+        if name not in baseline:
+            print("{:<50} {:>12.3f} {:<3} (new)".format(name, time, unit))
+            continue
+        reference, referenceUnit = baseline[name]
+        if referenceUnit != unit:
+            print("{:<50} time unit changed, not compared".format(name))
+            continue
+        change = time / reference - 1.0
+        regressed = change > arguments.tolerance
+        regressions += regressed
+        print("{:<50} {:>12.3f} {:<3} {:+7.1%}{}".format(name, time, unit, change, "  REGRESSION" if regressed else ""))
+
+    if regressions:
+        print("{} benchmarks are more than {:.0%} slower than {}".format(regressions, arguments.tolerance, arguments.baseline))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,7 +1,9 @@
 varying vec2 v_texCoord;
 
+uniform vec2 u_uvScale; // part of the layer textures that was rendered
+
 void main()
 {
     gl_Position = gl_Vertex;
-    v_texCoord = gl_Position.xy * 0.5 + 0.5; 
+    v_texCoord = (gl_Position.xy * 0.5 + 0.5) * u_uvScale;
 }
\ No newline at end of file
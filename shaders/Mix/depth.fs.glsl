@@ -0,0 +1,7 @@
+// Depth-only pre-pass of a layer, see PeelingRenderer::renderDepth: only the peeling test, the colors are masked
+#include "peeling.frag"
+
+void main()
+{
+  peeling(vec4(0.0));
+}
@@ -0,0 +1,11 @@
+uniform mat4 u_projection;
+uniform mat4 u_view;
+uniform mat4 u_model;
+
+// Same expression as main.vs.glsl, the shaded pass tests its depth for equality with this one
+invariant gl_Position;
+
+void main()
+{
+    gl_Position = u_projection * u_view * u_model * gl_ModelViewMatrix * gl_Vertex;
+}
@@ -0,0 +1,11 @@
+// Per draw data of the multi-draw path, see src/Utilitaire/MultiDrawBatch.h
+struct DrawData
+{
+    mat4 model;
+    ivec4 material; // index in u_materials, unused
+};
+
+layout(std430, binding = 0) readonly buffer DrawBlock
+{
+    DrawData u_draws[];
+};
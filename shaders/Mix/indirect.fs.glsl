@@ -0,0 +1,31 @@
+varying vec3 v_color;
+varying vec3 v_normal;
+varying vec2 v_texcoord;
+flat in int v_drawID;
+
+out vec4 fragColor;
+
+
+#include "drawdata.glsl"
+#include "material.glsl"
+#include "peeling.frag"
+
+// Same color as main.fs.glsl, the material comes from the draw data instead of a uniform
+vec4 basicColor()
+{
+  int material = u_draws[v_drawID].material.x;
+  vec4 color = materialColor(material, v_color, v_normal, v_texcoord);
+
+  color = vec4(v_normal, 0.5);
+  color.a = 0.5;
+  return color;
+}
+
+void main()
+{
+  vec4 color = basicColor();
+
+  peeling(color);
+
+  fragColor = color;
+}
@@ -0,0 +1,20 @@
+#extension GL_ARB_shader_draw_parameters : require
+
+uniform mat4 u_projection;
+uniform mat4 u_view;
+
+#include "drawdata.glsl"
+
+varying vec3 v_color;
+varying vec3 v_normal;
+varying vec2 v_texcoord;
+flat out int v_drawID;
+
+void main()
+{
+    gl_Position = u_projection * u_view * u_draws[gl_DrawIDARB].model * gl_ModelViewMatrix * gl_Vertex;
+    v_normal = gl_Normal;
+    v_color = gl_Color.rgb;
+    v_texcoord = gl_MultiTexCoord0.xy;
+    v_drawID = gl_DrawIDARB;
+}
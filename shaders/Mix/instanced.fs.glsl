@@ -0,0 +1,22 @@
+varying float v_scalar;
+
+out vec4 fragColor;
+
+uniform int u_material; // material of the template mesh, its colormap colors the scalars
+
+
+#include "material.glsl"
+#include "peeling.frag"
+
+void main()
+{
+  // the colormaps repeat, do not let the maximum wrap to the minimum
+  float coordinate = clamp(v_scalar, 0.0, 0.999);
+  ivec4 info = u_materials[u_material].texture;
+  vec4 color = info.x == 1 ? colormap(info.y, coordinate) : vec4(vec3(coordinate), 1.0);
+  color.a = 0.5;
+
+  peeling(color);
+
+  fragColor = color;
+}
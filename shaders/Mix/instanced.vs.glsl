@@ -0,0 +1,25 @@
+uniform mat4 u_projection;
+uniform mat4 u_view;
+uniform mat4 u_model;
+
+// -- Subjects, see src/Utilitaire/SubjectInstances.h --
+layout(std140) uniform SubjectBlock
+{
+    mat4 u_subjectModel[256];
+};
+uniform samplerBuffer u_subjectScalars; // one value per vertex, subject after subject
+uniform int u_instanceBase;             // first subject of the draw
+uniform int u_verticesPerSubject;
+uniform int u_vertexOffset;             // first vertex of the mesh in a subject
+uniform vec2 u_scalarRange;
+
+varying float v_scalar;
+
+void main()
+{
+    int subject = u_instanceBase + gl_InstanceID;
+    float scalar = texelFetch(u_subjectScalars, subject * u_verticesPerSubject + u_vertexOffset + gl_VertexID).r;
+
+    gl_Position = u_projection * u_view * u_subjectModel[gl_InstanceID] * u_model * gl_Vertex;
+    v_scalar = (scalar - u_scalarRange.x) / max(u_scalarRange.y - u_scalarRange.x, 1e-6);
+}
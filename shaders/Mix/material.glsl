@@ -0,0 +1,68 @@
+// Materials of the meshes, see src/Utilitaire/MaterialLibrary.h
+// MATERIAL_KIND specializes a program for one kind of material, -1 reads the kind of each material.
+#ifndef MATERIAL_KIND
+#define MATERIAL_KIND -1
+#endif
+struct Material
+{
+    ivec4 texture; // kind (0: vertex color, 1: colormap, 2: texture array), colormap row or array, layer, unused
+};
+
+layout(std140) uniform MaterialBlock
+{
+    Material u_materials[256];
+};
+
+uniform sampler2D u_colormapAtlas;         // one colormap per row
+uniform int u_colormapCount;
+uniform sampler2DArray u_textureArrays[4]; // 2D textures grouped by size
+
+vec4 colormap(int row, float value)
+{
+    return texture(u_colormapAtlas, vec2(value, (float(row) + 0.5) / float(u_colormapCount)));
+}
+
+// The samplers of an array can only be indexed with constants
+vec4 arrayTexture(int array, int layer, vec2 texcoord)
+{
+    vec3 coordinates = vec3(texcoord, float(layer));
+    switch(array)
+    {
+        case 0: return texture(u_textureArrays[0], coordinates);
+        case 1: return texture(u_textureArrays[1], coordinates);
+        case 2: return texture(u_textureArrays[2], coordinates);
+        default: return texture(u_textureArrays[3], coordinates);
+    }
+}
+
+int materialKind(int material)
+{
+#if MATERIAL_KIND >= 0
+    return MATERIAL_KIND;
+#else
+    return u_materials[material].texture.x;
+#endif
+}
+
+// Color of a fragment of a mesh using the material
+vec4 materialColor(int material, vec3 vertexColor, vec3 normal, vec2 texcoord)
+{
+    ivec4 info = u_materials[material].texture;
+#if MATERIAL_KIND == 0
+    return vertexColor != vec3(0.0, 0.0, 0.0) ? vec4(vertexColor, 1.0) : vec4(normal, 1.0);
+#elif MATERIAL_KIND == 1
+    return colormap(info.y, texcoord.x);
+#elif MATERIAL_KIND == 2
+    return arrayTexture(info.y, info.z, texcoord);
+#else
+    if(info.x == 1)
+    {
+        return colormap(info.y, texcoord.x);
+    }
+    if(info.x == 2)
+    {
+        return arrayTexture(info.y, info.z, texcoord);
+    }
+    return vertexColor != vec3(0.0, 0.0, 0.0) ? vec4(vertexColor, 1.0) : vec4(normal, 1.0);
+#endif
+}
@@ -1,6 +1,10 @@
- uniform sampler2D u_previousDepthTexture;
+// PEEL_LAYER is defined to 1 by the programs of the layers after the first one, see PeelingRenderer::Variant.
+// The first layer keeps every fragment, so its programs do not sample the previous depth at all.
+#ifndef PEEL_LAYER
+#define PEEL_LAYER 0
+#endif
 
- uniform int u_layer;
+ uniform sampler2D u_previousDepthTexture;
 
 // we can use the previous depth texture because the texture size is the same as the color texture
  vec2 getTexCoord()
@@ -10,14 +14,14 @@
 
  void peeling(vec4 color)
  {
-    if(u_layer != 0)// perform the peeling
+#if PEEL_LAYER
+    // perform the peeling
+    vec2 texCoord = getTexCoord();
+    vec4 previousDepth = texture(u_previousDepthTexture, texCoord);
+    float epsilon = 0.0000001;
+    if(gl_FragCoord.z <= previousDepth.r + epsilon)
     {
-      vec2 texCoord = getTexCoord();
-      vec4 previousDepth = texture(u_previousDepthTexture, texCoord);
-      float epsilon = 0.0000001;
-      if(gl_FragCoord.z <= previousDepth.r + epsilon)
-      {
-        discard;
-      }
+      discard;
     }
- }
\ No newline at end of file
+#endif
+ }
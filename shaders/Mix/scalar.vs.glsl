@@ -0,0 +1,15 @@
+uniform mat4 u_projection;
+uniform mat4 u_view;
+uniform mat4 u_model;
+
+// -- Streamed scalars, see src/Utilitaire/ScalarStream.h --
+in float a_scalar;      // one value per vertex, the current frame of the series
+uniform vec2 u_scalarRange;
+
+varying float v_scalar;
+
+void main()
+{
+    gl_Position = u_projection * u_view * u_model * gl_Vertex;
+    v_scalar = (a_scalar - u_scalarRange.x) / max(u_scalarRange.y - u_scalarRange.x, 1e-6);
+}
@@ -0,0 +1,208 @@
+#include "BatchRenderer.h"
+#include <QGuiApplication>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QDir>
+#include <algorithm>
+#include <iostream>
+
+BatchRenderer::BatchRenderer(const Settings &settings) :
+                    m_settings(settings),
+                    m_capture(settings.encoderThreads),
+                    m_outputTexture(nullptr)
+{
+  m_settings.layers = std::max(1, std::min(m_settings.layers, static_cast<int>(PeelingRenderer::MaxLayers)));
+  m_settings.frames = std::max(1, m_settings.frames);
+  m_trackBall.moveFront(5.0f - m_settings.distance); // the track ball starts at a distance of 5
+  m_trackBall.rotateUp(m_settings.elevation);
+}
+
+BatchRenderer::~BatchRenderer()
+{
+}
+
+bool BatchRenderer::run()
+{
+  if(!QDir().mkpath(m_settings.outputDirectory))
+  {
+    std::cerr << "Unable to create " << m_settings.outputDirectory.toStdString() << std::endl;
+    return false;
+  }
+
+  QOffscreenSurface surface;
+  surface.setFormat(QSurfaceFormat::defaultFormat());
+  surface.create();
+
+  QOpenGLContext context;
+  context.setFormat(surface.format());
+  if(!context.create() || !context.makeCurrent(&surface))
+  {
+    std::cerr << "Unable to create an offscreen OpenGL context" << std::endl;
+    if(QGuiApplication::platformName() == "offscreen")
+    {
+      // The offscreen platform of Qt 5 only has OpenGL through GLX, which needs an X server
+      std::cerr << "The offscreen platform has no OpenGL without an X server: run the batch mode under Xvfb "
+                   "(xvfb-run), or with an EGL platform (QT_QPA_PLATFORM=minimalegl or eglfs)" << std::endl;
+    }
+    return false;
+  }
+
+  if(!initialize())
+  {
+    cleanUp();
+    context.doneCurrent();
+    return false;
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+  const int reportInterval = std::max(1, m_settings.frames / 10);
+  for(int frame = 0; frame < m_settings.frames; ++frame)
+  {
+    renderFrame(frame);
+
+    // Hand the frames read back so far to the encoders, and do not get too far ahead of them
+    m_capture.poll();
+    waitForEncoders(2 * m_settings.encoderThreads);
+
+    if((frame + 1) % reportInterval == 0)
+    {
+      std::cout << "Frame " << frame + 1 << "/" << m_settings.frames << " - "
+                << (frame + 1) * 1000.0 / std::max<qint64>(1, timer.elapsed()) << " frames/s" << std::endl;
+    }
+  }
+
+  m_capture.finish();
+  std::cout << m_settings.frames << " frames written to " << m_settings.outputDirectory.toStdString()
+            << " in " << timer.elapsed() / 1000.0 << " s" << std::endl;
+  const FrameHistogram &cpu = m_telemetry.cpuHistogram();
+  std::cout << "CPU time per frame: p50 " << cpu.percentile(50) << " ms, p95 " << cpu.percentile(95)
+            << " ms, p99 " << cpu.percentile(99) << " ms, max " << cpu.max() << " ms" << std::endl;
+
+  cleanUp();
+  context.doneCurrent();
+  return true;
+}
+
+bool BatchRenderer::initialize()
+{
+  initializeOpenGLFunctions();
+
+  m_renderer.setTextureOptions(m_settings.textures);
+  if(!m_renderer.setVertexLayout(m_settings.vertexLayout))
+  {
+    return false;
+  }
+  const bool initialized = m_renderer.initialize(m_settings.shaderDirectory);
+  // Before the model is loaded, the automatic vertex layout is measured with or without the pre-pass
+  m_renderer.setDepthPrePass(m_settings.depthPrePass);
+  if(!initialized || !m_renderer.loadModel(m_settings.modelFile))
+  {
+    std::cerr << "Unable to load " << m_settings.modelFile.toStdString() << std::endl;
+    return false;
+  }
+  // The model was loaded while the shaders were compiled, every frame needs the final programs
+  if(!m_renderer.waitForPrograms())
+  {
+    std::cerr << "Unable to compile the shaders of " << m_settings.shaderDirectory.toStdString() << std::endl;
+    return false;
+  }
+  m_frameSync.initialize();
+  m_capture.initialize();
+  if(!m_settings.traceFile.isEmpty())
+  {
+    m_telemetry.start(m_settings.traceFile);
+  }
+
+  const QSize &size = m_settings.size;
+  m_renderer.renderTargets().fit(size.width(), size.height(), m_settings.layers);
+  if(!m_renderer.renderTargets().isAllocated())
+  {
+    return false;
+  }
+
+  // The peeling layers are float textures, the blended frame only needs 8 bits per channel
+  m_outputTexture = new QOpenGLTexture(QOpenGLTexture::Target2D);
+  m_outputTexture->create();
+  m_outputTexture->setSize(size.width(), size.height());
+  m_outputTexture->setFormat(QOpenGLTexture::RGBA8_UNorm);
+  m_outputTexture->allocateStorage();
+  if(!m_outputFramebuffer.create() || !m_outputFramebuffer.attach(m_outputTexture->textureId(), 0))
+  {
+    std::cerr << "Error: Output framebuffer is not complete" << std::endl;
+    return false;
+  }
+
+  const float aspect = static_cast<float>(size.width()) / static_cast<float>(size.height());
+  m_projectionMatrix.perspective(45.0f, aspect, 0.01f, 10000.0f);
+  glViewport(0, 0, size.width(), size.height());
+  return true;
+}
+
+void BatchRenderer::renderFrame(int frame)
+{
+  QElapsedTimer cpuTimer;
+  cpuTimer.start();
+  const qint64 frameStart = m_telemetry.elapsedMicroseconds();
+
+  // Let the CPU record this frame while the GPU still renders the previous ones
+  m_frameSync.beginFrame();
+
+  m_renderer.setCamera(m_trackBall.getViewMatrix(), m_projectionMatrix, m_trackBall.getPosition());
+
+  m_outputFramebuffer.bind();
+  glClearColor(0.8f, 0.8f, 0.8f, 1.0f);
+  glClear(GL_COLOR_BUFFER_BIT);
+
+  m_renderer.peel(m_settings.size, 0, m_settings.layers);
+  m_renderer.blend(m_outputFramebuffer.handle(), m_settings.size, m_settings.layers);
+
+  const QString fileName = QString("%1/frame_%2.%3").arg(m_settings.outputDirectory)
+                             .arg(frame, 5, 10, QChar('0')).arg(m_settings.format);
+  m_capture.captureFramebuffer(m_outputFramebuffer.handle(), QRect(QPoint(0, 0), m_settings.size), fileName);
+  m_outputFramebuffer.release();
+
+  m_frameSync.endFrame();
+
+  // Without timer queries, the GPU time of the batch frames is not measured
+  const GLStateCache::Counters &counters = m_renderer.stateCache().counters();
+  FrameTelemetry::Sample sample;
+  sample.frame = frame;
+  sample.startMicroseconds = frameStart;
+  sample.cpuMilliseconds = cpuTimer.nsecsElapsed() / 1.0e6;
+  sample.layers = m_settings.layers;
+  sample.draws = counters.draws;
+  sample.uniformUpdates = counters.uniformUpdates;
+  sample.uploadedBytes = counters.uploadedBytes; // the first frame counts the model
+  m_renderer.stateCache().resetCounters();
+  m_telemetry.record(sample, false);
+
+  m_trackBall.rotateLeft(360.0f / m_settings.frames);
+}
+
+void BatchRenderer::waitForEncoders(int maxQueued)
+{
+  while(m_capture.pendingEncodes() > maxQueued)
+  {
+    QThread::msleep(1);
+    m_capture.poll();
+  }
+}
+
+void BatchRenderer::cleanUp()
+{
+  m_telemetry.stop();
+  m_capture.finish();
+  m_capture.destroy();
+  m_frameSync.destroy();
+  m_outputFramebuffer.destroy();
+  if(m_outputTexture)
+  {
+    m_outputTexture->destroy();
+    delete m_outputTexture;
+    m_outputTexture = nullptr;
+  }
+  m_renderer.destroy();
+}
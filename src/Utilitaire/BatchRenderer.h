@@ -0,0 +1,67 @@
+#ifndef BATCHRENDERER_H
+#define BATCHRENDERER_H
+
+#include <QOpenGLFunctions>
+#include <QOpenGLTexture>
+#include <QThread>
+#include <QString>
+#include <QSize>
+#include "PeelingRenderer.h"
+#include "RenderTarget.h"
+#include "FrameSync.h"
+#include "FrameCapture.h"
+#include "FrameTelemetry.h"
+#include "../Cameras/TrackBall.h"
+
+// Renders a turntable of a glTF model to an image sequence, without any window.
+// The frames are rendered in an offscreen context with every layer peeled at full resolution.
+// Each frame is read back asynchronously, so the GPU renders frame N+1 while the capture workers
+// encode and write frame N. The number of images waiting to be encoded is bounded.
+class BatchRenderer : protected QOpenGLFunctions
+{
+  public:
+    struct Settings
+    {
+      QString modelFile;
+      QString shaderDirectory = "../shaders/Mix";
+      QString outputDirectory = "../Turntable";
+      QString format = "png";  // png or raw
+      int frames = 360;        // one full turn
+      QSize size = QSize(1920, 1080);
+      int layers = PeelingRenderer::MaxLayers;
+      float distance = 5.0f;   // of the camera to the model
+      float elevation = 0.0f;  // degrees
+      int encoderThreads = QThread::idealThreadCount();
+      TextureProcessor::Options textures;
+      QString traceFile;       // frame samples, CSV or Chrome trace, empty to disable
+      QString vertexLayout = "auto"; // interleaved, split or auto, see PeelingRenderer::setVertexLayout
+      bool depthPrePass = false;
+    };
+
+    explicit BatchRenderer(const Settings &settings);
+    ~BatchRenderer();
+
+    // Render the whole sequence, returns false if the context, the model or the output could not be created
+    bool run();
+
+  private:
+    bool initialize();
+    void renderFrame(int frame);
+    void waitForEncoders(int maxQueued); // Keep reading back while too many images are queued
+    void cleanUp();
+
+    Settings m_settings;
+    PeelingRenderer m_renderer;
+    FrameSync m_frameSync;
+    FrameCapture m_capture;
+    FrameTelemetry m_telemetry;
+    TrackBall m_trackBall;
+
+    // -- Output of the blend pass --
+    QOpenGLTexture *m_outputTexture;
+    Framebuffer m_outputFramebuffer;
+
+    QMatrix4x4 m_projectionMatrix;
+};
+
+#endif // BATCHRENDERER_H
@@ -0,0 +1,185 @@
+#include "FrameCapture.h"
+#include <QRunnable>
+#include <QImage>
+#include <QFile>
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+  // Flip and encode an image on a worker thread
+  class EncodeTask : public QRunnable
+  {
+    public:
+      EncodeTask(const QImage &image, const QRect &region, const QString &fileName, QAtomicInt *counter)
+          : m_image(image), m_region(region), m_fileName(fileName), m_counter(counter)
+      {
+      }
+
+      void run() override
+      {
+        // OpenGL rows start at the bottom
+        const QImage cropped = m_image.copy(m_region);
+        if(m_fileName.endsWith(".raw"))
+        {
+          QFile file(m_fileName);
+          if(file.open(QIODevice::WriteOnly))
+          {
+            file.write(reinterpret_cast<const char *>(cropped.constBits()), cropped.sizeInBytes());
+          }
+          else
+          {
+            qWarning() << "Unable to write" << m_fileName;
+          }
+        }
+        else if(!cropped.mirrored().save(m_fileName))
+        {
+          qWarning() << "Unable to write" << m_fileName;
+        }
+        m_counter->deref();
+      }
+
+    private:
+      QImage m_image;
+      QRect m_region;
+      QString m_fileName;
+      QAtomicInt *m_counter;
+  };
+}
+
+FrameCapture::FrameCapture(int encoderThreads)
+{
+  m_encoders.setMaxThreadCount(std::max(1, encoderThreads));
+}
+
+FrameCapture::~FrameCapture()
+{
+  m_encoders.waitForDone();
+}
+
+void FrameCapture::initialize()
+{
+  initializeOpenGLFunctions();
+}
+
+void FrameCapture::destroy()
+{
+  for(auto &readback : m_pending)
+  {
+    glDeleteSync(readback.fence);
+    glDeleteBuffers(1, &readback.buffer.handle);
+  }
+  m_pending.clear();
+
+  for(auto &buffer : m_freeBuffers)
+  {
+    glDeleteBuffers(1, &buffer.handle);
+  }
+  m_freeBuffers.clear();
+}
+
+FrameCapture::PixelBuffer FrameCapture::acquireBuffer(int bytes)
+{
+  for(size_t i = 0; i < m_freeBuffers.size(); ++i)
+  {
+    if(m_freeBuffers[i].capacity >= bytes)
+    {
+      PixelBuffer buffer = m_freeBuffers[i];
+      m_freeBuffers.erase(m_freeBuffers.begin() + i);
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.handle);
+      return buffer;
+    }
+  }
+
+  PixelBuffer buffer = {0, bytes};
+  glGenBuffers(1, &buffer.handle);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.handle);
+  glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+  return buffer;
+}
+
+void FrameCapture::captureTexture(GLenum target, GLuint textureId, const QSize &textureSize, const QRect &region, const QString &fileName)
+{
+  const PixelBuffer buffer = acquireBuffer(4 * textureSize.width() * textureSize.height());
+
+  // With a pack buffer bound, the pointer is an offset in the buffer and the call returns immediately
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glBindTexture(target, textureId);
+  glGetTexImage(target, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  glBindTexture(target, 0);
+
+  enqueue(buffer, textureSize, region, fileName);
+}
+
+void FrameCapture::captureFramebuffer(GLuint framebuffer, const QRect &region, const QString &fileName)
+{
+  const PixelBuffer buffer = acquireBuffer(4 * region.width() * region.height());
+
+  GLint previousFramebuffer = 0;
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousFramebuffer);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(region.x(), region.y(), region.width(), region.height(), GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, previousFramebuffer);
+
+  enqueue(buffer, region.size(), QRect(QPoint(0, 0), region.size()), fileName);
+}
+
+void FrameCapture::enqueue(const PixelBuffer &buffer, const QSize &size, const QRect &region, const QString &fileName)
+{
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  m_pending.push_back({buffer, fence, size, region, fileName});
+}
+
+bool FrameCapture::poll()
+{
+  for(auto it = m_pending.begin(); it != m_pending.end();)
+  {
+    // The first wait flushes so that the fence is eventually signaled
+    const GLenum status = glClientWaitSync(it->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if(status == GL_TIMEOUT_EXPIRED)
+    {
+      ++it;
+      continue;
+    }
+
+    encode(*it);
+    glDeleteSync(it->fence);
+    m_freeBuffers.push_back(it->buffer);
+    it = m_pending.erase(it);
+  }
+  return !m_pending.empty();
+}
+
+void FrameCapture::encode(Readback &readback)
+{
+  const int bytes = 4 * readback.size.width() * readback.size.height();
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer.handle);
+  const void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+  if(!pixels)
+  {
+    qWarning() << "Unable to map the readback of" << readback.fileName;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return;
+  }
+
+  // Copy the pixels so that the buffer can be unmapped and reused right away
+  QImage image(readback.size, QImage::Format_RGBA8888);
+  memcpy(image.bits(), pixels, bytes);
+  glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  m_queuedEncodes.ref();
+  m_encoders.start(new EncodeTask(image, readback.region, readback.fileName, &m_queuedEncodes));
+}
+
+void FrameCapture::finish()
+{
+  while(poll())
+  {
+    QThread::usleep(500);
+  }
+  m_encoders.waitForDone();
+}
@@ -0,0 +1,64 @@
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <QOpenGLExtraFunctions>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QString>
+#include <QRect>
+#include <vector>
+
+// Reads textures and framebuffers back to image files without blocking the rendering.
+// The pixels are copied into pixel buffer objects by the GPU, a fence tells when the copy is done,
+// then the pixels are mapped and handed to a pool of worker threads that flip and encode them.
+// Files ending with .raw are written as raw RGBA8 rows (bottom to top), the others go through QImage.
+class FrameCapture : protected QOpenGLExtraFunctions
+{
+  public:
+    explicit FrameCapture(int encoderThreads = QThread::idealThreadCount());
+    ~FrameCapture();
+
+    void initialize(); // Must be called with a current context
+    void destroy();
+
+    // Queue the readback of the level 0 of a texture, only region is written (origin at the bottom left)
+    void captureTexture(GLenum target, GLuint textureId, const QSize &textureSize, const QRect &region, const QString &fileName);
+    // Queue the readback of a region of a framebuffer
+    void captureFramebuffer(GLuint framebuffer, const QRect &region, const QString &fileName);
+
+    // Send the readbacks completed by the GPU to the encoders, never waits.
+    // Returns true while readbacks are still pending on the GPU.
+    bool poll();
+    bool hasPendingReadbacks() const { return !m_pending.empty(); }
+
+    // Block until every pending readback is encoded
+    void finish();
+    int pendingEncodes() const { return m_queuedEncodes.loadAcquire(); } // images waiting or being encoded
+
+  private:
+    struct PixelBuffer
+    {
+      GLuint handle;
+      int capacity; // bytes
+    };
+
+    struct Readback
+    {
+      PixelBuffer buffer;
+      GLsync fence;
+      QSize size;    // size of the pixels in the buffer
+      QRect region;  // part of the pixels to write
+      QString fileName;
+    };
+
+    PixelBuffer acquireBuffer(int bytes);
+    void enqueue(const PixelBuffer &buffer, const QSize &size, const QRect &region, const QString &fileName);
+    void encode(Readback &readback);
+
+    std::vector<Readback> m_pending;
+    std::vector<PixelBuffer> m_freeBuffers; // reused by the next readbacks
+    QThreadPool m_encoders;
+    QAtomicInt m_queuedEncodes;
+};
+
+#endif // FRAMECAPTURE_H
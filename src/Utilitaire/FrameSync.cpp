@@ -0,0 +1,140 @@
+#include "FrameSync.h"
+#include <algorithm>
+
+FrameSync::FrameSync(int maxFramesInFlight)
+    : m_maxFramesInFlight(maxFramesInFlight)
+    , m_waitTime(0.0)
+    , m_frameCount(0)
+    , m_latency(0.0)
+    , m_latencyCount(0)
+    , m_timestamps(false)
+{
+}
+
+void FrameSync::initialize()
+{
+    initializeOpenGLFunctions();
+    m_clock.start();
+
+    // Timestamps need OpenGL 3.3 or GL_ARB_timer_query
+    QOpenGLTimerQuery *query = new QOpenGLTimerQuery();
+    m_timestamps = query->create();
+    if (m_timestamps) {
+        m_freeQueries.push_back(query);
+    } else {
+        delete query;
+    }
+}
+
+void FrameSync::destroy()
+{
+    for (auto &frame : m_frames) {
+        glDeleteSync(frame.fence);
+        if (frame.completion) {
+            m_freeQueries.push_back(frame.completion);
+        }
+    }
+    m_frames.clear();
+    for (QOpenGLTimerQuery *query : m_freeQueries) {
+        query->destroy();
+        delete query;
+    }
+    m_freeQueries.clear();
+    m_timestamps = false;
+}
+
+void FrameSync::beginFrame()
+{
+    retireCompletedFrames();
+
+    const qint64 start = m_clock.nsecsElapsed();
+    while (!m_frames.empty() && static_cast<int>(m_frames.size()) >= std::max(m_maxFramesInFlight, 1)) {
+        waitFor(m_frames.front());
+        m_frames.pop_front();
+    }
+    m_waitTime += (m_clock.nsecsElapsed() - start) / 1.0e6;
+    m_frameCount++;
+}
+
+void FrameSync::endFrame()
+{
+    Frame frame = {nullptr, m_clock.nsecsElapsed(), nullptr, 0};
+    if (m_timestamps) {
+        if (m_freeQueries.empty()) {
+            QOpenGLTimerQuery *query = new QOpenGLTimerQuery();
+            query->create();
+            m_freeQueries.push_back(query);
+        }
+        frame.completion = m_freeQueries.back();
+        m_freeQueries.pop_back();
+        frame.gpuSubmitTime = frame.completion->waitForTimestamp(); // when the previous commands reached the server
+        frame.completion->recordTimestamp();                         // when they are done
+    }
+    frame.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_frames.push_back(frame);
+
+    // Without any frame in flight, wait for the frame right away
+    if (m_maxFramesInFlight <= 0) {
+        const qint64 start = m_clock.nsecsElapsed();
+        waitFor(m_frames.back());
+        m_frames.pop_back();
+        m_waitTime += (m_clock.nsecsElapsed() - start) / 1.0e6;
+    }
+}
+
+void FrameSync::retireCompletedFrames()
+{
+    while (!m_frames.empty()) {
+        Frame &frame = m_frames.front();
+        if (glClientWaitSync(frame.fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            return;
+        }
+        retire(frame);
+        m_frames.pop_front();
+    }
+}
+
+void FrameSync::waitFor(Frame &frame)
+{
+    // Flush on the first try so the fence is guaranteed to be signaled eventually
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    GLenum result;
+    do {
+        result = glClientWaitSync(frame.fence, flags, 1000000); // 1 ms
+        flags = 0;
+    } while (result == GL_TIMEOUT_EXPIRED);
+
+    retire(frame);
+}
+
+void FrameSync::retire(Frame &frame)
+{
+    if (frame.completion) {
+        // The timestamp was recorded before the fence, it is available once the fence is signaled
+        const GLuint64 completed = frame.completion->waitForResult();
+        m_latency += static_cast<qint64>(completed - frame.gpuSubmitTime) / 1.0e6;
+        m_freeQueries.push_back(frame.completion);
+    } else {
+        m_latency += (m_clock.nsecsElapsed() - frame.submitTime) / 1.0e6;
+    }
+    m_latencyCount++;
+    glDeleteSync(frame.fence);
+}
+
+double FrameSync::averageWaitTime() const
+{
+    return m_frameCount > 0 ? m_waitTime / m_frameCount : 0.0;
+}
+
+double FrameSync::averageLatency() const
+{
+    return m_latencyCount > 0 ? m_latency / m_latencyCount : 0.0;
+}
+
+void FrameSync::resetStatistics()
+{
+    m_waitTime = 0.0;
+    m_frameCount = 0;
+    m_latency = 0.0;
+    m_latencyCount = 0;
+}
@@ -0,0 +1,63 @@
+#ifndef FRAMESYNC_H
+#define FRAMESYNC_H
+
+#include <QOpenGLExtraFunctions>
+#include <QElapsedTimer>
+#include <QOpenGLTimerQuery>
+#include <deque>
+#include <vector>
+
+// Limits the number of frames the CPU can record ahead of the GPU with fences.
+// While the GPU renders frame N, the CPU is free to record frame N+1, up to maxFramesInFlight frames.
+// A limit of 0 waits for every frame to complete, like a glFinish() at the end of each frame.
+// It also measures how long the CPU waits and how long a frame takes from submission to completion.
+// The latency is measured on the GPU clock with GL_TIMESTAMP queries: the time the end of the frame reached the
+// server, and the time its commands completed. Without timer queries it is the time the CPU noticed the fence,
+// which depends on how often it is polled, so it is only an upper bound (isLatencyExact() is false).
+class FrameSync : protected QOpenGLExtraFunctions
+{
+  public:
+    explicit FrameSync(int maxFramesInFlight = 2);
+
+    void initialize(); // Must be called with a current context
+    void destroy();
+
+    void setMaxFramesInFlight(int frames) { m_maxFramesInFlight = frames; }
+    int maxFramesInFlight() const { return m_maxFramesInFlight; }
+
+    void beginFrame(); // Wait until the number of frames in flight is below the limit
+    void endFrame();   // Mark the end of the commands of the frame
+
+    // -- Statistics since the last reset --
+    double averageWaitTime() const;    // ms spent by the CPU waiting for the GPU per frame
+    double averageLatency() const;     // ms between the end of the recording and the completion of a frame
+    bool isLatencyExact() const { return m_timestamps; }
+    void resetStatistics();
+
+  private:
+    struct Frame
+    {
+      GLsync fence;
+      qint64 submitTime; // ns, CPU clock
+      QOpenGLTimerQuery *completion; // GPU time the commands of the frame completed, nullptr without timestamps
+      GLuint64 gpuSubmitTime; // ns, GPU clock
+    };
+
+    void retireCompletedFrames(); // Release the fences already signaled, without waiting
+    void waitFor(Frame &frame);
+    void retire(Frame &frame); // once its fence is signaled
+
+    int m_maxFramesInFlight;
+    std::deque<Frame> m_frames;
+    QElapsedTimer m_clock;
+
+    double m_waitTime;
+    int m_frameCount;
+    double m_latency;
+    int m_latencyCount;
+
+    bool m_timestamps;
+    std::vector<QOpenGLTimerQuery *> m_freeQueries;
+};
+
+#endif // FRAMESYNC_H
@@ -0,0 +1,267 @@
+#include "FrameTelemetry.h"
+#include <QDebug>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// ------------------------------------------------------ FrameHistogram ------------------------------------------------------
+
+FrameHistogram::FrameHistogram()
+    : m_buckets(BucketCount + 1, 0)
+    , m_count(0)
+    , m_max(0.0)
+{
+}
+
+void FrameHistogram::add(double milliseconds)
+{
+  const int bucket = static_cast<int>(std::max(0.0, milliseconds) / BucketWidth);
+  m_buckets[std::min(bucket, static_cast<int>(BucketCount))]++;
+  m_count++;
+  m_max = std::max(m_max, milliseconds);
+}
+
+void FrameHistogram::reset()
+{
+  std::fill(m_buckets.begin(), m_buckets.end(), 0);
+  m_count = 0;
+  m_max = 0.0;
+}
+
+double FrameHistogram::percentile(double p) const
+{
+  if(m_count == 0)
+  {
+    return 0.0;
+  }
+  const int rank = std::max(1, static_cast<int>(std::ceil(p / 100.0 * m_count)));
+  int cumulated = 0;
+  for(int bucket = 0; bucket < BucketCount; ++bucket)
+  {
+    cumulated += m_buckets[bucket];
+    if(cumulated >= rank)
+    {
+      return std::min((bucket + 1) * BucketWidth, m_max);
+    }
+  }
+  return m_max;
+}
+
+// ------------------------------------------------------ FrameTelemetry ------------------------------------------------------
+
+FrameTelemetry::FrameTelemetry(int capacity)
+    : m_mask(0)
+    , m_head(0)
+    , m_tail(0)
+    , m_stopping(false)
+    , m_dropped(0)
+    , m_chromeTrace(false)
+{
+  size_t size = 1;
+  while(size < static_cast<size_t>(std::max(2, capacity)))
+  {
+    size *= 2;
+  }
+  m_ring.resize(size);
+  m_mask = size - 1;
+  m_clock.start();
+}
+
+FrameTelemetry::~FrameTelemetry()
+{
+  stop();
+}
+
+bool FrameTelemetry::start(const QString &fileName)
+{
+  if(isRecording())
+  {
+    return true;
+  }
+
+  m_file.setFileName(fileName);
+  if(!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+  {
+    qWarning() << "Unable to write the frame trace" << fileName;
+    return false;
+  }
+  m_chromeTrace = !fileName.endsWith(".csv", Qt::CaseInsensitive);
+  m_head.store(0, std::memory_order_relaxed);
+  m_tail.store(0, std::memory_order_relaxed);
+  m_stopping.store(false, std::memory_order_relaxed);
+  m_dropped = 0;
+
+  writeHeader();
+  m_writer = std::thread(&FrameTelemetry::writeLoop, this);
+  return true;
+}
+
+void FrameTelemetry::stop()
+{
+  if(!isRecording())
+  {
+    return;
+  }
+
+  // The frames still waiting for their GPU time are written without it
+  while(!m_waitingForGpu.empty())
+  {
+    push(m_waitingForGpu.front());
+    m_waitingForGpu.pop_front();
+  }
+
+  m_stopping.store(true, std::memory_order_release);
+  m_writer.join();
+  writeFooter();
+  m_file.close();
+  if(m_dropped > 0)
+  {
+    qWarning() << m_dropped << "frames were not written to" << m_file.fileName() << ", the writer fell behind";
+  }
+}
+
+void FrameTelemetry::record(const Sample &sample, bool gpuPending)
+{
+  m_cpuHistogram.add(sample.cpuMilliseconds);
+  if(sample.gpuMilliseconds >= 0.0)
+  {
+    m_gpuHistogram.add(sample.gpuMilliseconds);
+  }
+  if(!isRecording())
+  {
+    return;
+  }
+
+  if(!gpuPending)
+  {
+    push(sample);
+    return;
+  }
+  m_waitingForGpu.push_back(sample);
+  if(m_waitingForGpu.size() > MaxWaitingForGpu)
+  {
+    push(m_waitingForGpu.front());
+    m_waitingForGpu.pop_front();
+  }
+}
+
+void FrameTelemetry::reportGpuTime(quint64 frame, double milliseconds)
+{
+  m_gpuHistogram.add(milliseconds);
+
+  // The results come in order, the older frames were not measured
+  while(!m_waitingForGpu.empty() && m_waitingForGpu.front().frame <= frame)
+  {
+    Sample &sample = m_waitingForGpu.front();
+    if(sample.frame == frame)
+    {
+      sample.gpuMilliseconds = milliseconds;
+    }
+    push(sample);
+    m_waitingForGpu.pop_front();
+  }
+}
+
+void FrameTelemetry::resetStatistics()
+{
+  m_cpuHistogram.reset();
+  m_gpuHistogram.reset();
+}
+
+void FrameTelemetry::push(const Sample &sample)
+{
+  const size_t head = m_head.load(std::memory_order_relaxed);
+  if(head - m_tail.load(std::memory_order_acquire) > m_mask)
+  {
+    m_dropped++;
+    return;
+  }
+  m_ring[head & m_mask] = sample;
+  m_head.store(head + 1, std::memory_order_release);
+}
+
+bool FrameTelemetry::pop(Sample &sample)
+{
+  const size_t tail = m_tail.load(std::memory_order_relaxed);
+  if(tail == m_head.load(std::memory_order_acquire))
+  {
+    return false;
+  }
+  sample = m_ring[tail & m_mask];
+  m_tail.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+// ------------------------------------------------------ Writer thread ------------------------------------------------------
+
+void FrameTelemetry::writeLoop()
+{
+  Sample sample;
+  for(;;)
+  {
+    // Read before draining, the samples pushed before stop() are all written
+    const bool stopping = m_stopping.load(std::memory_order_acquire);
+    while(pop(sample))
+    {
+      writeSample(sample);
+    }
+    if(stopping)
+    {
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  m_file.flush();
+}
+
+void FrameTelemetry::writeHeader()
+{
+  if(!m_chromeTrace)
+  {
+    m_file.write("frame,start_us,cpu_ms,gpu_ms,layers,draws,uniform_updates,uploaded_bytes\n");
+    return;
+  }
+
+  // The GPU durations are drawn on their own track from the start of the CPU frame,
+  // the timer queries give how long the GPU worked, not when
+  m_file.write("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+               "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Depth peeling\"}},\n"
+               "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU frames\"}},\n"
+               "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU frames\"}}");
+}
+
+void FrameTelemetry::writeSample(const Sample &sample)
+{
+  if(!m_chromeTrace)
+  {
+    m_file.write(QString("%1,%2,%3,%4,%5,%6,%7,%8\n")
+                   .arg(sample.frame).arg(sample.startMicroseconds)
+                   .arg(sample.cpuMilliseconds, 0, 'f', 3)
+                   .arg(sample.gpuMilliseconds >= 0.0 ? QString::number(sample.gpuMilliseconds, 'f', 3) : QString())
+                   .arg(sample.layers).arg(sample.draws).arg(sample.uniformUpdates).arg(sample.uploadedBytes)
+                   .toUtf8());
+    return;
+  }
+
+  QString events = QString(",\n{\"name\":\"Frame\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%1,\"dur\":%2,"
+                           "\"args\":{\"frame\":%3,\"layers\":%4,\"draws\":%5,\"uniformUpdates\":%6,\"uploadedBytes\":%7}}")
+                     .arg(sample.startMicroseconds).arg(sample.cpuMilliseconds * 1000.0, 0, 'f', 1)
+                     .arg(sample.frame).arg(sample.layers).arg(sample.draws).arg(sample.uniformUpdates).arg(sample.uploadedBytes);
+  if(sample.gpuMilliseconds >= 0.0)
+  {
+    events += QString(",\n{\"name\":\"GPU frame\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":%1,\"dur\":%2,"
+                      "\"args\":{\"frame\":%3}}")
+                .arg(sample.startMicroseconds).arg(sample.gpuMilliseconds * 1000.0, 0, 'f', 1).arg(sample.frame);
+  }
+  events += QString(",\n{\"name\":\"Work\",\"ph\":\"C\",\"pid\":1,\"ts\":%1,\"args\":{\"layers\":%2,\"draws\":%3,\"uniformUpdates\":%4}}")
+              .arg(sample.startMicroseconds).arg(sample.layers).arg(sample.draws).arg(sample.uniformUpdates);
+  m_file.write(events.toUtf8());
+}
+
+void FrameTelemetry::writeFooter()
+{
+  if(m_chromeTrace)
+  {
+    m_file.write("\n]}\n");
+  }
+}
@@ -0,0 +1,106 @@
+#ifndef FRAMETELEMETRY_H
+#define FRAMETELEMETRY_H
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QString>
+#include <atomic>
+#include <deque>
+#include <thread>
+#include <vector>
+
+// Frame times in buckets of 0.1 ms up to 250 ms, the percentiles are exact to a bucket
+class FrameHistogram
+{
+  public:
+    FrameHistogram();
+
+    void add(double milliseconds);
+    void reset();
+
+    int count() const { return m_count; }
+    double max() const { return m_max; }
+    // Upper bound of the bucket holding the percentile p (0 to 100), 0 without frames
+    double percentile(double p) const;
+
+  private:
+    static const int BucketCount = 2500;
+    static constexpr double BucketWidth = 0.1; // ms
+
+    std::vector<int> m_buckets; // the last one holds the longer frames
+    int m_count;
+    double m_max;
+};
+
+// Records one sample per frame: CPU time, GPU time, peeled layers, draws, uniform updates and uploaded bytes.
+// The render thread pushes the samples into a lock-free single producer, single consumer ring buffer,
+// a writer thread drains it to a CSV file or to a Chrome trace (JSON trace events, opened by Perfetto
+// and chrome://tracing). The render thread never waits for the writer, the samples that do not fit are dropped.
+// The GPU time of a frame arrives a few frames later (see GpuFrameTimer), the sample is held until then.
+class FrameTelemetry
+{
+  public:
+    struct Sample
+    {
+      quint64 frame = 0;
+      qint64 startMicroseconds = 0; // see elapsedMicroseconds()
+      double cpuMilliseconds = 0.0;
+      double gpuMilliseconds = -1.0; // -1 if unknown
+      int layers = 0;
+      int draws = 0;
+      int uniformUpdates = 0;
+      qint64 uploadedBytes = 0;
+    };
+
+    explicit FrameTelemetry(int capacity = 4096); // rounded up to a power of two
+    ~FrameTelemetry();
+
+    // Start writing the samples, a .csv file gets a CSV table, any other one a Chrome trace
+    bool start(const QString &fileName);
+    // Write the samples still held or queued, and close the file
+    void stop();
+    bool isRecording() const { return m_writer.joinable(); }
+    qint64 elapsedMicroseconds() const { return m_clock.nsecsElapsed() / 1000; } // since the construction
+
+    // -- Render thread --
+    // With gpuPending, the sample is written once reportGpuTime() gives the GPU time of its frame
+    void record(const Sample &sample, bool gpuPending);
+    void reportGpuTime(quint64 frame, double milliseconds);
+
+    // Frames recorded since the last reset, whether they are written or not
+    const FrameHistogram &cpuHistogram() const { return m_cpuHistogram; }
+    const FrameHistogram &gpuHistogram() const { return m_gpuHistogram; }
+    void resetStatistics();
+    quint64 droppedSamples() const { return m_dropped; }
+
+  private:
+    static const int MaxWaitingForGpu = 16; // the GPU timer skips the frames it has no query for
+
+    void push(const Sample &sample);
+    bool pop(Sample &sample);
+    void writeLoop(); // in the writer thread
+    void writeHeader();
+    void writeSample(const Sample &sample);
+    void writeFooter();
+
+    // -- Ring buffer, m_head is only written by the render thread and m_tail by the writer --
+    std::vector<Sample> m_ring;
+    size_t m_mask;
+    std::atomic<size_t> m_head;
+    std::atomic<size_t> m_tail;
+    std::atomic<bool> m_stopping;
+    std::thread m_writer;
+    quint64 m_dropped;
+
+    // -- Render thread --
+    std::deque<Sample> m_waitingForGpu;
+    FrameHistogram m_cpuHistogram;
+    FrameHistogram m_gpuHistogram;
+    QElapsedTimer m_clock;
+
+    // -- Writer thread --
+    QFile m_file;
+    bool m_chromeTrace;
+};
+
+#endif // FRAMETELEMETRY_H
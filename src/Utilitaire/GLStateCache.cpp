@@ -0,0 +1,154 @@
+#include "GLStateCache.h"
+
+GLStateCache::GLStateCache()
+    : m_program(0)
+    , m_activeUnit(-1)
+{
+}
+
+void GLStateCache::initialize()
+{
+  initializeOpenGLFunctions();
+  invalidateBindings();
+}
+
+void GLStateCache::invalidateBindings()
+{
+  m_program = 0;
+  invalidateTextures();
+}
+
+void GLStateCache::invalidateTextures()
+{
+  m_activeUnit = -1;
+  m_textures.clear();
+}
+
+void GLStateCache::invalidateUniforms()
+{
+  m_intUniforms.clear();
+  m_vectorUniforms.clear();
+  m_matrixUniforms.clear();
+}
+
+void GLStateCache::bindProgram(QOpenGLShaderProgram &program)
+{
+  if(m_program == program.programId())
+  {
+    m_counters.skippedBinds++;
+    return;
+  }
+  program.bind();
+  m_program = program.programId();
+  m_counters.programBinds++;
+}
+
+void GLStateCache::releaseProgram()
+{
+  glUseProgram(0);
+  m_program = 0;
+}
+
+// A binding unknown to the cache is always applied, the cache never assumes a texture is unbound
+void GLStateCache::bindTexture(int unit, GLenum target, GLuint texture)
+{
+  if(unit < static_cast<int>(m_textures.size()) && m_textures[unit].target == target && m_textures[unit].texture == texture && texture != 0)
+  {
+    m_counters.skippedBinds++;
+    return;
+  }
+
+  if(m_activeUnit != unit)
+  {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    m_activeUnit = unit;
+  }
+  glBindTexture(target, texture);
+  m_counters.textureBinds++;
+
+  if(unit >= static_cast<int>(m_textures.size()))
+  {
+    m_textures.resize(unit + 1, {0, 0});
+  }
+  m_textures[unit] = {target, texture};
+}
+
+quint64 GLStateCache::uniformKey(QOpenGLShaderProgram &program, int location)
+{
+  return (static_cast<quint64>(program.programId()) << 32) | static_cast<quint32>(location);
+}
+
+void GLStateCache::setUniform(QOpenGLShaderProgram &program, int location, int value)
+{
+  if(location < 0)
+  {
+    return;
+  }
+
+  const quint64 key = uniformKey(program, location);
+  auto it = m_intUniforms.find(key);
+  if(it != m_intUniforms.end() && it->second == value)
+  {
+    m_counters.skippedUniforms++;
+    return;
+  }
+  program.setUniformValue(location, value);
+  m_intUniforms[key] = value;
+  m_counters.uniformUpdates++;
+  m_counters.uploadedBytes += sizeof(GLint);
+}
+
+void GLStateCache::setUniform(QOpenGLShaderProgram &program, int location, const QVector2D &value)
+{
+  if(location < 0)
+  {
+    return;
+  }
+
+  const quint64 key = uniformKey(program, location);
+  auto it = m_vectorUniforms.find(key);
+  if(it != m_vectorUniforms.end() && it->second == value)
+  {
+    m_counters.skippedUniforms++;
+    return;
+  }
+  program.setUniformValue(location, value);
+  m_vectorUniforms[key] = value;
+  m_counters.uniformUpdates++;
+  m_counters.uploadedBytes += 2 * sizeof(GLfloat);
+}
+
+void GLStateCache::setUniform(QOpenGLShaderProgram &program, int location, const QMatrix4x4 &value)
+{
+  if(location < 0)
+  {
+    return;
+  }
+
+  const quint64 key = uniformKey(program, location);
+  auto it = m_matrixUniforms.find(key);
+  if(it != m_matrixUniforms.end() && it->second == value)
+  {
+    m_counters.skippedUniforms++;
+    return;
+  }
+  program.setUniformValue(location, value);
+  m_matrixUniforms[key] = value;
+  m_counters.uniformUpdates++;
+  m_counters.uploadedBytes += 16 * sizeof(GLfloat);
+}
+
+void GLStateCache::setUniform(QOpenGLShaderProgram &program, const char *name, int value)
+{
+  setUniform(program, program.uniformLocation(name), value);
+}
+
+void GLStateCache::setUniform(QOpenGLShaderProgram &program, const char *name, const QVector2D &value)
+{
+  setUniform(program, program.uniformLocation(name), value);
+}
+
+void GLStateCache::setUniform(QOpenGLShaderProgram &program, const char *name, const QMatrix4x4 &value)
+{
+  setUniform(program, program.uniformLocation(name), value);
+}
@@ -0,0 +1,71 @@
+#ifndef GLSTATECACHE_H
+#define GLSTATECACHE_H
+
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QMatrix4x4>
+#include <QVector2D>
+#include <unordered_map>
+#include <vector>
+
+// Skips the program binds, texture binds and uniform updates that would not change the GL state.
+// The bindings are forgotten by invalidateBindings() since code outside the cache may change them,
+// the uniforms belong to the programs and stay valid until invalidateUniforms() (e.g. after a link).
+// Every call is counted, so redundant state changes can be measured per frame.
+class GLStateCache : protected QOpenGLFunctions
+{
+  public:
+    struct Counters
+    {
+      int programBinds = 0;
+      int textureBinds = 0;
+      int uniformUpdates = 0;
+      int skippedBinds = 0;    // program and texture binds
+      int skippedUniforms = 0;
+      int draws = 0;
+      qint64 uploadedBytes = 0; // uniform values and buffer data sent to the GPU
+    };
+
+    GLStateCache();
+
+    void initialize(); // Must be called with a current context
+    void invalidateBindings(); // program and textures
+    void invalidateTextures();
+    void invalidateUniforms();
+
+    void bindProgram(QOpenGLShaderProgram &program);
+    void releaseProgram();
+    void bindTexture(int unit, GLenum target, GLuint texture);
+
+    // The program must be bound with bindProgram()
+    void setUniform(QOpenGLShaderProgram &program, int location, int value);
+    void setUniform(QOpenGLShaderProgram &program, int location, const QVector2D &value);
+    void setUniform(QOpenGLShaderProgram &program, int location, const QMatrix4x4 &value);
+    void setUniform(QOpenGLShaderProgram &program, const char *name, int value);
+    void setUniform(QOpenGLShaderProgram &program, const char *name, const QVector2D &value);
+    void setUniform(QOpenGLShaderProgram &program, const char *name, const QMatrix4x4 &value);
+
+    void countDraw() { m_counters.draws++; }
+    void countUpload(qint64 bytes) { m_counters.uploadedBytes += bytes; }
+    const Counters &counters() const { return m_counters; }
+    void resetCounters() { m_counters = Counters(); }
+
+  private:
+    struct TextureBinding
+    {
+      GLenum target;
+      GLuint texture;
+    };
+
+    static quint64 uniformKey(QOpenGLShaderProgram &program, int location);
+
+    GLuint m_program;    // 0 if unknown or released
+    int m_activeUnit;    // -1 if unknown
+    std::vector<TextureBinding> m_textures; // per unit, texture 0 if unknown
+    std::unordered_map<quint64, int> m_intUniforms;
+    std::unordered_map<quint64, QVector2D> m_vectorUniforms;
+    std::unordered_map<quint64, QMatrix4x4> m_matrixUniforms;
+    Counters m_counters;
+};
+
+#endif // GLSTATECACHE_H
@@ -0,0 +1,91 @@
+#include "GpuFrameTimer.h"
+
+GpuFrameTimer::GpuFrameTimer(int queryCount)
+    : m_queryCount(queryCount)
+    , m_current(-1)
+    , m_next(0)
+    , m_oldest(0)
+{
+}
+
+GpuFrameTimer::~GpuFrameTimer()
+{
+    for (auto &slot : m_queries) {
+        delete slot.query;
+    }
+}
+
+bool GpuFrameTimer::create()
+{
+    destroy();
+    for (int i = 0; i < m_queryCount; ++i) {
+        QOpenGLTimerQuery *query = new QOpenGLTimerQuery();
+        if (!query->create()) {
+            delete query;
+            destroy();
+            return false;
+        }
+        m_queries.push_back({query, false, 0, 0, 1.0f});
+    }
+    return true;
+}
+
+void GpuFrameTimer::destroy()
+{
+    for (auto &slot : m_queries) {
+        slot.query->destroy();
+        delete slot.query;
+    }
+    m_queries.clear();
+    m_current = -1;
+    m_next = 0;
+    m_oldest = 0;
+}
+
+void GpuFrameTimer::begin()
+{
+    // Every query is still in flight, this frame is not measured rather than waiting for the GPU
+    if (!isSupported() || m_queries[m_next].pending) {
+        m_current = -1;
+        return;
+    }
+    m_current = m_next;
+    m_queries[m_current].query->begin();
+}
+
+void GpuFrameTimer::end(int tag, quint64 frame, float scale)
+{
+    if (m_current < 0) {
+        return;
+    }
+    Slot &slot = m_queries[m_current];
+    slot.query->end();
+    slot.pending = true;
+    slot.tag = tag;
+    slot.frame = frame;
+    slot.scale = scale;
+    m_next = (m_current + 1) % m_queryCount;
+    m_current = -1;
+}
+
+bool GpuFrameTimer::takeResult(double &milliseconds, int &tag, quint64 *frame, float *scale)
+{
+    if (!isSupported()) {
+        return false;
+    }
+    Slot &slot = m_queries[m_oldest];
+    if (!slot.pending || !slot.query->isResultAvailable()) {
+        return false;
+    }
+    milliseconds = slot.query->waitForResult() / 1.0e6; // available, so it does not wait
+    tag = slot.tag;
+    if (frame) {
+        *frame = slot.frame;
+    }
+    if (scale) {
+        *scale = slot.scale;
+    }
+    slot.pending = false;
+    m_oldest = (m_oldest + 1) % m_queryCount;
+    return true;
+}
@@ -0,0 +1,45 @@
+#ifndef GPUFRAMETIMER_H
+#define GPUFRAMETIMER_H
+
+#include <QOpenGLTimerQuery>
+#include <vector>
+
+// Measures the GPU time of a frame with timer queries without stalling the pipeline.
+// Several queries are kept in flight, a result is read back only when the GPU made it available,
+// so it arrives a few frames after the measured frame. Each measure carries a tag, a frame number and the render
+// scale of the frame given at end().
+class GpuFrameTimer
+{
+  public:
+    explicit GpuFrameTimer(int queryCount = 4);
+    ~GpuFrameTimer();
+
+    // Must be called with a current context, returns false if timer queries are not supported
+    bool create();
+    void destroy();
+    bool isSupported() const { return !m_queries.empty(); }
+
+    void begin();
+    void end(int tag = 0, quint64 frame = 0, float scale = 1.0f);
+
+    // Oldest available result, returns false if no measure is ready yet
+    bool takeResult(double &milliseconds, int &tag, quint64 *frame = nullptr, float *scale = nullptr);
+
+  private:
+    struct Slot
+    {
+      QOpenGLTimerQuery *query;
+      bool pending; // ended and not read back yet
+      int tag;
+      quint64 frame;
+      float scale;
+    };
+
+    int m_queryCount;
+    std::vector<Slot> m_queries;
+    int m_current; // slot of the running query, -1 if none
+    int m_next;    // next slot to use
+    int m_oldest;  // next slot to read back
+};
+
+#endif // GPUFRAMETIMER_H
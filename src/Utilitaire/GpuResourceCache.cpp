@@ -0,0 +1,42 @@
+#include "GpuResourceCache.h"
+#include <QOpenGLContext>
+
+std::map<QOpenGLContextGroup *, GpuResourceCache> &GpuResourceCache::caches()
+{
+  static std::map<QOpenGLContextGroup *, GpuResourceCache> caches;
+  return caches;
+}
+
+GpuResourceCache &GpuResourceCache::current()
+{
+  QOpenGLContextGroup *group = QOpenGLContextGroup::currentContextGroup();
+  auto it = caches().find(group);
+  if(it == caches().end())
+  {
+    it = caches().emplace(group, GpuResourceCache()).first;
+    if(group)
+    {
+      // The objects of the group are gone with it
+      QObject::connect(group, &QObject::destroyed, [group]() { caches().erase(group); });
+    }
+  }
+  return it->second;
+}
+
+int GpuResourceCache::resourceCount() const
+{
+  int count = 0;
+  for(const auto &resource : m_resources)
+  {
+    count += !resource.second.expired();
+  }
+  return count;
+}
+
+void GpuResourceCache::prune()
+{
+  for(auto it = m_resources.begin(); it != m_resources.end();)
+  {
+    it = it->second.expired() ? m_resources.erase(it) : std::next(it);
+  }
+}
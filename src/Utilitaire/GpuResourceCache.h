@@ -0,0 +1,50 @@
+#ifndef GPURESOURCECACHE_H
+#define GPURESOURCECACHE_H
+
+#include <QByteArray>
+#include <map>
+#include <memory>
+
+class QOpenGLContextGroup;
+
+// GL objects shared by the contexts of a share group (Qt::AA_ShareOpenGLContexts): the widgets that need the
+// same resource get the same object instead of uploading their own copy.
+// A resource is found by a key describing its content, and deleted with its last user, who must then have a
+// context of the group current since the destructor of the resource releases its GL objects.
+// Only used from the GUI thread, like the contexts.
+class GpuResourceCache
+{
+  public:
+    // The cache of the share group of the current context
+    static GpuResourceCache &current();
+
+    // The resource of the key, create() returns a new T when the group does not have it anymore
+    template<typename T, typename Create>
+    std::shared_ptr<T> acquire(const QByteArray &key, Create create)
+    {
+      std::weak_ptr<void> &entry = m_resources[key];
+      if(std::shared_ptr<void> resource = entry.lock())
+      {
+        ++m_hits;
+        return std::static_pointer_cast<T>(resource);
+      }
+      prune();
+      std::shared_ptr<T> resource(create());
+      m_resources[key] = resource;
+      return resource;
+    }
+
+    int resourceCount() const; // alive
+    int hits() const { return m_hits; }
+
+  private:
+    GpuResourceCache() : m_hits(0) {}
+    void prune(); // forget the released resources
+
+    std::map<QByteArray, std::weak_ptr<void>> m_resources;
+    int m_hits;
+
+    static std::map<QOpenGLContextGroup *, GpuResourceCache> &caches();
+};
+
+#endif // GPURESOURCECACHE_H
@@ -0,0 +1,309 @@
+#include "MaterialLibrary.h"
+#include "GpuResourceCache.h"
+#include <QOpenGLContext>
+#include <QDebug>
+#include <algorithm>
+
+MaterialLibrary::MaterialLibrary()
+    : m_colormapCount(0)
+    , m_uploadedBytes(0)
+{
+}
+
+MaterialLibrary::~MaterialLibrary()
+{
+  // The owner destroys it while its context is current
+}
+
+MaterialLibrary::GpuMaterials::~GpuMaterials()
+{
+  for(QOpenGLTexture *array : arrays)
+  {
+    array->destroy();
+    delete array;
+  }
+  if(colormapAtlas)
+  {
+    colormapAtlas->destroy();
+    delete colormapAtlas;
+  }
+  QOpenGLContext::currentContext()->functions()->glDeleteBuffers(1, &uniformBuffer);
+}
+
+bool MaterialLibrary::build(const GLTFLoader &loader)
+{
+  destroy();
+  initializeOpenGLFunctions();
+
+  addMaterial({VertexColor, 0, 0, 0}); // material 0, also used when a material does not fit
+
+  const SceneData *scene = loader.scene();
+  if(!scene)
+  {
+    return false;
+  }
+
+  std::vector<int> colormaps; // images of the scene, one per row of the atlas
+  for(const auto& mesh : loader.m_meshes)
+  {
+    Material material = {VertexColor, 0, 0, 0};
+
+    // The last texture of the mesh is the one its draw used to leave bound
+    for(const auto& textureInfo : mesh.textureInfos)
+    {
+      const int image = textureInfo.image;
+      if(textureInfo.type == GLTFLoader::TextureType::Texture1D)
+      {
+        auto it = std::find(colormaps.begin(), colormaps.end(), image);
+        if(it == colormaps.end())
+        {
+          it = colormaps.insert(colormaps.end(), image);
+        }
+        material = {Colormap, static_cast<GLint>(it - colormaps.begin()), 0, 0};
+        continue;
+      }
+
+      // Textures of the same size share an array
+      const QSize size(scene->images[image].width, scene->images[image].height);
+      auto group = std::find_if(m_arrays.begin(), m_arrays.end(), [&size](const ArrayGroup &g) { return g.size == size; });
+      if(group == m_arrays.end())
+      {
+        if(static_cast<int>(m_arrays.size()) == MaxArrays)
+        {
+          qWarning() << "More than" << MaxArrays << "texture sizes, the textures of" << size << "are ignored";
+          continue;
+        }
+        ArrayGroup newGroup;
+        newGroup.size = size;
+        group = m_arrays.insert(m_arrays.end(), newGroup);
+      }
+
+      auto layer = std::find(group->sources.begin(), group->sources.end(), image);
+      if(layer == group->sources.end())
+      {
+        layer = group->sources.insert(group->sources.end(), image);
+      }
+      material = {ArrayTexture, static_cast<GLint>(group - m_arrays.begin()), static_cast<GLint>(layer - group->sources.begin()), 0};
+    }
+
+    m_meshMaterials.push_back(addMaterial(material));
+  }
+
+  m_colormapCount = static_cast<int>(colormaps.size());
+
+  // The textures are processed once for all the views of the model
+  const std::shared_ptr<const GLTFLoader::GpuModel> model = loader.gpuModel();
+  const QByteArray key = "materials:" + QByteArray::number(reinterpret_cast<quintptr>(model.get())) + ":" +
+                         QByteArray::number(m_textureOptions.compress) + ":" +
+                         QByteArray::number(static_cast<int>(m_textureOptions.filter));
+  bool created = false;
+  m_gpu = GpuResourceCache::current().acquire<GpuMaterials>(key, [&]()
+  {
+    created = true;
+    GpuMaterials *gpu = new GpuMaterials;
+    gpu->model = model;
+    gpu->colormapAtlas = createColormapAtlas(*scene, colormaps);
+    if(gpu->colormapAtlas)
+    {
+      gpu->bytes += 4 * gpu->colormapAtlas->width() * gpu->colormapAtlas->height();
+    }
+    gpu->arrays = createArrays(*scene, gpu->bytes);
+
+    std::vector<Material> block(MaxMaterials, Material{VertexColor, 0, 0, 0});
+    std::copy(m_materials.begin(), m_materials.end(), block.begin());
+    glGenBuffers(1, &gpu->uniformBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, gpu->uniformBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, block.size() * sizeof(Material), block.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    gpu->bytes += static_cast<qint64>(block.size() * sizeof(Material));
+    return gpu;
+  });
+  m_uploadedBytes = created ? m_gpu->bytes : 0;
+
+  return true;
+}
+
+int MaterialLibrary::addMaterial(const Material &material)
+{
+  for(size_t i = 0; i < m_materials.size(); ++i)
+  {
+    const Material &other = m_materials[i];
+    if(other.kind == material.kind && other.index == material.index && other.layer == material.layer)
+    {
+      return static_cast<int>(i);
+    }
+  }
+
+  if(static_cast<int>(m_materials.size()) == MaxMaterials)
+  {
+    qWarning() << "More than" << MaxMaterials << "materials, the vertex colors are used instead";
+    return 0;
+  }
+  m_materials.push_back(material);
+  return static_cast<int>(m_materials.size()) - 1;
+}
+
+// Each colormap is resampled to the width of the widest one
+QOpenGLTexture *MaterialLibrary::createColormapAtlas(const SceneData &scene, const std::vector<int> &colormaps)
+{
+  if(colormaps.empty())
+  {
+    return nullptr;
+  }
+
+  int width = 1;
+  for(int colormap : colormaps)
+  {
+    width = std::max(width, scene.images[colormap].width);
+  }
+
+  std::vector<unsigned char> pixels(4 * width * m_colormapCount);
+  for(int row = 0; row < m_colormapCount; ++row)
+  {
+    const int sourceWidth = scene.images[colormaps[row]].width;
+    const std::vector<unsigned char> &source = scene.images[colormaps[row]].pixels;
+    for(int x = 0; x < width; ++x)
+    {
+      const float position = std::max(0.0f, std::min((x + 0.5f) * sourceWidth / width - 0.5f, sourceWidth - 1.0f));
+      const int left = static_cast<int>(position);
+      const int right = std::min(left + 1, sourceWidth - 1);
+      const float t = position - left;
+      for(int c = 0; c < 4; ++c)
+      {
+        pixels[4 * (row * width + x) + c] = static_cast<unsigned char>(source[4 * left + c] * (1.0f - t) + source[4 * right + c] * t + 0.5f);
+      }
+    }
+  }
+
+  QOpenGLTexture *atlas = new QOpenGLTexture(QOpenGLTexture::Target2D);
+  atlas->setSize(width, m_colormapCount);
+  atlas->setFormat(QOpenGLTexture::RGBA8_UNorm);
+  atlas->allocateStorage();
+  atlas->setData(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8, pixels.data());
+  atlas->setMinificationFilter(QOpenGLTexture::Linear);
+  atlas->setMagnificationFilter(QOpenGLTexture::Linear);
+  // Like the 1D textures along a colormap, the rows are sampled at their center and never mixed
+  atlas->setWrapMode(QOpenGLTexture::DirectionS, QOpenGLTexture::Repeat);
+  atlas->setWrapMode(QOpenGLTexture::DirectionT, QOpenGLTexture::ClampToEdge);
+  return atlas;
+}
+
+// The mipmaps of every layer of every array are prepared in parallel, then uploaded in immutable storage
+std::vector<QOpenGLTexture *> MaterialLibrary::createArrays(const SceneData &scene, qint64 &bytes)
+{
+  TextureProcessor::Options options = m_textureOptions;
+  if(options.compress && !QOpenGLContext::currentContext()->hasExtension("GL_EXT_texture_compression_s3tc"))
+  {
+    qWarning() << "S3TC is not supported, the textures are not compressed";
+    options.compress = false;
+  }
+  const TextureProcessor processor(options);
+
+  std::vector<TextureProcessor::Job> jobs;
+  for(const auto &group : m_arrays)
+  {
+    const size_t first = jobs.size();
+    bool alpha = false;
+    for(int source : group.sources)
+    {
+      TextureProcessor::Job job;
+      job.pixels = scene.images[source].pixels;
+      job.width = group.size.width();
+      job.height = group.size.height();
+      alpha = alpha || TextureProcessor::hasAlpha(job.pixels);
+      jobs.push_back(std::move(job));
+    }
+    // The layers of an array share its format
+    for(size_t i = first; i < jobs.size(); ++i)
+    {
+      jobs[i].format = alpha ? TextureProcessor::Format::BC3 : TextureProcessor::Format::BC1;
+    }
+  }
+  processor.process(jobs);
+
+  std::vector<QOpenGLTexture *> arrays;
+  size_t job = 0;
+  for(auto &group : m_arrays)
+  {
+    const TextureProcessor::MipChain &first = jobs[job].result;
+    const bool compressed = first.format != TextureProcessor::Format::RGBA8;
+
+    QOpenGLTexture *array = new QOpenGLTexture(QOpenGLTexture::Target2DArray);
+    array->setSize(group.size.width(), group.size.height());
+    array->setLayers(static_cast<int>(group.sources.size()));
+    array->setMipLevels(static_cast<int>(first.levels.size()));
+    array->setFormat(first.format == TextureProcessor::Format::BC1 ? QOpenGLTexture::RGB_DXT1 :
+                           first.format == TextureProcessor::Format::BC3 ? QOpenGLTexture::RGBA_DXT5 :
+                                                                           QOpenGLTexture::RGBA8_UNorm);
+    array->allocateStorage(); // glTexStorage3D when the driver has it
+    for(size_t layer = 0; layer < group.sources.size(); ++layer, ++job)
+    {
+      const TextureProcessor::MipChain &chain = jobs[job].result;
+      for(size_t level = 0; level < chain.levels.size(); ++level)
+      {
+        const std::vector<unsigned char> &data = chain.levels[level];
+        bytes += static_cast<qint64>(data.size());
+        if(compressed)
+        {
+          array->setCompressedData(static_cast<int>(level), static_cast<int>(layer), static_cast<int>(data.size()), data.data());
+        }
+        else
+        {
+          array->setData(static_cast<int>(level), static_cast<int>(layer), QOpenGLTexture::RGBA, QOpenGLTexture::UInt8, data.data());
+        }
+      }
+    }
+    array->setMinificationFilter(QOpenGLTexture::LinearMipMapLinear);
+    array->setMagnificationFilter(QOpenGLTexture::Linear);
+    array->setWrapMode(QOpenGLTexture::Repeat);
+    array->setMaximumAnisotropy(8.0f);
+    arrays.push_back(array);
+  }
+  return arrays;
+}
+
+void MaterialLibrary::destroy()
+{
+  m_gpu.reset(); // deleted with the last library using it
+  m_arrays.clear();
+  m_colormapCount = 0;
+  m_uploadedBytes = 0;
+  m_materials.clear();
+  m_meshMaterials.clear();
+}
+
+void MaterialLibrary::setUpProgram(QOpenGLShaderProgram &program)
+{
+  if(!program.isLinked())
+  {
+    return;
+  }
+
+  const GLuint blockIndex = glGetUniformBlockIndex(program.programId(), "MaterialBlock");
+  if(blockIndex != GL_INVALID_INDEX)
+  {
+    glUniformBlockBinding(program.programId(), blockIndex, BlockBinding);
+  }
+
+  program.bind();
+  program.setUniformValue("u_colormapAtlas", ColormapUnit);
+  program.setUniformValue("u_colormapCount", std::max(1, m_colormapCount));
+  for(int i = 0; i < MaxArrays; ++i)
+  {
+    program.setUniformValue(QString("u_textureArrays[%1]").arg(i).toStdString().c_str(), FirstArrayUnit + i);
+  }
+  program.release();
+}
+
+void MaterialLibrary::bind(GLStateCache &cache)
+{
+  if(m_gpu->colormapAtlas)
+  {
+    cache.bindTexture(ColormapUnit, GL_TEXTURE_2D, m_gpu->colormapAtlas->textureId());
+  }
+  for(size_t i = 0; i < m_gpu->arrays.size(); ++i)
+  {
+    cache.bindTexture(FirstArrayUnit + static_cast<int>(i), GL_TEXTURE_2D_ARRAY, m_gpu->arrays[i]->textureId());
+  }
+  glBindBufferBase(GL_UNIFORM_BUFFER, BlockBinding, m_gpu->uniformBuffer);
+}
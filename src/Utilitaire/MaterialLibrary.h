@@ -0,0 +1,100 @@
+#ifndef MATERIALLIBRARY_H
+#define MATERIALLIBRARY_H
+
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLTexture>
+#include <QSize>
+#include <memory>
+#include <vector>
+#include "gltfLoader.h"
+#include "GLStateCache.h"
+#include "TextureProcessor.h"
+
+// Materials of the meshes of a GLTFLoader, shared by every draw of a frame.
+// The 2D textures of the same size are packed in texture arrays, and the 1D colormaps are resampled
+// to the rows of a single 2D atlas. A material is then only a kind and indices in these textures,
+// stored in a uniform buffer, and a mesh selects its material with an index (u_material).
+// The textures are bound once per pass, see shaders/Mix/material.glsl. They are built from the images of the
+// scene on the CPU, the loader does not create a texture per image for them.
+// The texture arrays get a full mipmap chain, compressed when the driver supports S3TC, see TextureProcessor.
+// The libraries of the same model in a share group use the same textures and buffer (GpuResourceCache).
+class MaterialLibrary : protected QOpenGLExtraFunctions
+{
+  public:
+    enum Kind
+    {
+      VertexColor = 0,
+      Colormap = 1,
+      ArrayTexture = 2
+    };
+
+    static const int MaxMaterials = 256; // size of u_materials in shaders/Mix/material.glsl
+    static const int MaxArrays = 4;      // size of u_textureArrays
+    static const int ColormapUnit = 0;
+    static const int FirstArrayUnit = 4;
+    static const int BlockBinding = 1;
+
+    MaterialLibrary();
+    ~MaterialLibrary();
+
+    // Used by the next build()
+    void setTextureOptions(const TextureProcessor::Options &options) { m_textureOptions = options; }
+
+    // Must be called with a current context
+    bool build(const GLTFLoader &loader);
+    void destroy();
+    bool isBuilt() const { return m_gpu != nullptr; }
+    qint64 uploadedBytes() const { return m_uploadedBytes; } // sent to the GPU by build(), 0 if the textures were shared
+    QOpenGLTexture *colormapAtlas() const { return m_gpu ? m_gpu->colormapAtlas : nullptr; }
+
+    int materialOf(int mesh) const { return mesh < static_cast<int>(m_meshMaterials.size()) ? m_meshMaterials[mesh] : 0; }
+    Kind kindOf(int material) const { return static_cast<Kind>(m_materials[material].kind); }
+    int materialCount() const { return static_cast<int>(m_materials.size()); }
+
+    // Bind the uniform block and set the samplers of a program, once after it is linked
+    void setUpProgram(QOpenGLShaderProgram &program);
+    // Bind the textures and the uniform buffer
+    void bind(GLStateCache &cache);
+
+  private:
+    // std140 layout of Material in shaders/Mix/material.glsl
+    struct Material
+    {
+      GLint kind;
+      GLint index; // colormap row or texture array
+      GLint layer; // layer in the texture array
+      GLint unused;
+    };
+
+    struct ArrayGroup
+    {
+      QSize size;
+      std::vector<int> sources; // images of the scene, one per layer
+    };
+
+    // GL objects built from the materials
+    struct GpuMaterials
+    {
+      QOpenGLTexture *colormapAtlas = nullptr;
+      std::vector<QOpenGLTexture *> arrays; // one per ArrayGroup
+      GLuint uniformBuffer = 0;
+      qint64 bytes = 0; // of the textures and the buffer
+      std::shared_ptr<const GLTFLoader::GpuModel> model; // the key is its address, it must stay in use
+      ~GpuMaterials(); // with a context of the share group current
+    };
+
+    int addMaterial(const Material &material);
+    QOpenGLTexture *createColormapAtlas(const SceneData &scene, const std::vector<int> &colormaps);
+    std::vector<QOpenGLTexture *> createArrays(const SceneData &scene, qint64 &bytes);
+
+    std::vector<Material> m_materials;
+    std::vector<int> m_meshMaterials; // material of each mesh
+    std::vector<ArrayGroup> m_arrays;
+    TextureProcessor::Options m_textureOptions;
+    int m_colormapCount;
+    qint64 m_uploadedBytes;
+    std::shared_ptr<const GpuMaterials> m_gpu;
+};
+
+#endif // MATERIALLIBRARY_H
@@ -0,0 +1,137 @@
+#include "MultiDrawBatch.h"
+#include "GpuResourceCache.h"
+#include <QOpenGLContext>
+#include <algorithm>
+#include <cstring>
+
+MultiDrawBatch::MultiDrawBatch()
+    : m_gl(nullptr)
+    , m_bufferBytes(0)
+{
+}
+
+MultiDrawBatch::~MultiDrawBatch()
+{
+  // The owner destroys it while its context is current
+}
+
+MultiDrawBatch::Buffers::~Buffers()
+{
+  const GLuint buffers[] = {vertex, index, command, drawData};
+  QOpenGLContext::currentContext()->functions()->glDeleteBuffers(4, buffers);
+}
+
+bool MultiDrawBatch::isSupported()
+{
+  QOpenGLContext *context = QOpenGLContext::currentContext();
+  return context->format().version() >= qMakePair(4, 3) &&
+         context->format().profile() != QSurfaceFormat::CoreProfile &&
+         context->hasExtension("GL_ARB_shader_draw_parameters");
+}
+
+bool MultiDrawBatch::build(GLTFLoader &loader, const MaterialLibrary &materials)
+{
+  destroy();
+  if(!isSupported() || loader.m_meshes.empty() || !loader.scene())
+  {
+    return false;
+  }
+  m_gl = QOpenGLContext::currentContext()->versionFunctions<QOpenGLFunctions_4_3_Compatibility>();
+  if(!m_gl || !m_gl->initializeOpenGLFunctions())
+  {
+    return false;
+  }
+
+  // The batches of the other views of the model have the same buffers
+  const std::shared_ptr<const GLTFLoader::GpuModel> model = loader.gpuModel();
+  const QByteArray key = "multidraw:" + QByteArray::number(reinterpret_cast<quintptr>(model.get()));
+  bool created = false;
+  m_buffers = GpuResourceCache::current().acquire<Buffers>(key, [&]()
+  {
+    created = true;
+    Buffers *buffers = createBuffers(loader, materials);
+    buffers->model = model;
+    return buffers;
+  });
+  m_bufferBytes = created ? m_buffers->bytes : 0;
+  return true;
+}
+
+MultiDrawBatch::Buffers *MultiDrawBatch::createBuffers(const GLTFLoader &loader, const MaterialLibrary &materials)
+{
+  // The scene already has the vertices and the 32-bit indices of all the meshes in two flat arrays
+  const SceneData &scene = *loader.scene();
+  const std::vector<SceneData::Vertex> &vertices = scene.vertices;
+  const std::vector<uint32_t> &indices = scene.indices;
+  std::vector<DrawCommand> commands;
+  std::vector<DrawData> drawData;
+
+  for(size_t m = 0; m < loader.m_meshes.size(); ++m)
+  {
+    const GLTFLoader::Mesh &mesh = loader.m_meshes[m];
+    const SceneData::Mesh &sceneMesh = scene.meshes[m];
+    DrawCommand command;
+    command.count = mesh.indexCount;
+    command.instanceCount = 1;
+    command.firstIndex = static_cast<GLuint>(sceneMesh.firstIndex);
+    command.baseVertex = static_cast<GLint>(sceneMesh.firstVertex);
+    command.baseInstance = 0;
+    commands.push_back(command);
+
+    DrawData data;
+    std::memcpy(data.model, mesh.modelMatrix.constData(), sizeof(data.model));
+    data.material[0] = materials.materialOf(static_cast<int>(m));
+    data.material[1] = 0;
+    data.material[2] = 0;
+    data.material[3] = 0;
+    drawData.push_back(data);
+  }
+
+  Buffers *buffers = new Buffers;
+  m_gl->glGenBuffers(1, &buffers->vertex);
+  m_gl->glBindBuffer(GL_ARRAY_BUFFER, buffers->vertex);
+  m_gl->glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(SceneData::Vertex), vertices.data(), GL_STATIC_DRAW);
+  m_gl->glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  m_gl->glGenBuffers(1, &buffers->index);
+  m_gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers->index);
+  m_gl->glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+  m_gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+  m_gl->glGenBuffers(1, &buffers->command);
+  m_gl->glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffers->command);
+  m_gl->glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawCommand), commands.data(), GL_STATIC_DRAW);
+  m_gl->glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+  m_gl->glGenBuffers(1, &buffers->drawData);
+  m_gl->glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers->drawData);
+  m_gl->glBufferData(GL_SHADER_STORAGE_BUFFER, drawData.size() * sizeof(DrawData), drawData.data(), GL_STATIC_DRAW);
+  m_gl->glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  buffers->drawCount = static_cast<int>(commands.size());
+  buffers->bytes = static_cast<qint64>(vertices.size() * sizeof(SceneData::Vertex) + indices.size() * sizeof(GLuint) +
+                                       commands.size() * sizeof(DrawCommand) + drawData.size() * sizeof(DrawData));
+  return buffers;
+}
+
+void MultiDrawBatch::destroy()
+{
+  m_buffers.reset(); // deleted with the last batch using them
+  m_bufferBytes = 0;
+}
+
+void MultiDrawBatch::draw(GLTFLoader &loader)
+{
+  m_gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DrawDataBinding, m_buffers->drawData);
+  m_gl->glBindBuffer(GL_ARRAY_BUFFER, m_buffers->vertex);
+  loader.enableVertexArrays();
+  m_gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_buffers->index);
+  m_gl->glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_buffers->command);
+
+  m_gl->glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, m_buffers->drawCount, 0);
+
+  m_gl->glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+  m_gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  loader.disableVertexArrays();
+  m_gl->glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
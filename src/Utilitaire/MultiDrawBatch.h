@@ -0,0 +1,75 @@
+#ifndef MULTIDRAWBATCH_H
+#define MULTIDRAWBATCH_H
+
+#include <QOpenGLFunctions_4_3_Compatibility>
+#include <QOpenGLShaderProgram>
+#include <memory>
+#include <vector>
+#include "gltfLoader.h"
+#include "MaterialLibrary.h"
+
+// Draws every mesh of a GLTFLoader with a single glMultiDrawElementsIndirect.
+// The vertices and indices of the meshes are packed in two shared buffers, and the draw commands
+// are written once in an indirect buffer that stays on the GPU. The per mesh data (model matrix,
+// material) is stored in a shader storage buffer read with gl_DrawIDARB, see shaders/Mix/drawdata.glsl.
+// The textures are bound by the MaterialLibrary once for all the draws.
+// The batches of the same model in a share group use the same buffers (GpuResourceCache).
+class MultiDrawBatch
+{
+  public:
+    static const int DrawDataBinding = 0;
+
+    MultiDrawBatch();
+    ~MultiDrawBatch();
+
+    // OpenGL 4.3 and ARB_shader_draw_parameters are needed, must be called with a current context
+    static bool isSupported();
+
+    // Pack the meshes of the loader, returns false if they can not be drawn in one call
+    bool build(GLTFLoader &loader, const MaterialLibrary &materials);
+    void destroy();
+    bool isBuilt() const { return m_buffers != nullptr; }
+    int drawCount() const { return m_buffers ? m_buffers->drawCount : 0; }
+    qint64 bufferBytes() const { return m_bufferBytes; } // sent to the GPU by build(), 0 if the buffers were shared
+
+    // Issue every draw with the bound program, the materials must be bound
+    void draw(GLTFLoader &loader);
+
+  private:
+    // Layout imposed by glMultiDrawElementsIndirect
+    struct DrawCommand
+    {
+      GLuint count;
+      GLuint instanceCount;
+      GLuint firstIndex;
+      GLint baseVertex;
+      GLuint baseInstance;
+    };
+
+    // std430 layout of DrawData in shaders/Mix/drawdata.glsl
+    struct DrawData
+    {
+      float model[16];
+      GLint material[4]; // index in the MaterialLibrary, unused
+    };
+
+    struct Buffers
+    {
+      GLuint vertex = 0;
+      GLuint index = 0;
+      GLuint command = 0;
+      GLuint drawData = 0;
+      int drawCount = 0;
+      qint64 bytes = 0;
+      std::shared_ptr<const GLTFLoader::GpuModel> model; // the key is its address, it must stay in use
+      ~Buffers(); // with a context of the share group current
+    };
+
+    Buffers *createBuffers(const GLTFLoader &loader, const MaterialLibrary &materials);
+
+    QOpenGLFunctions_4_3_Compatibility *m_gl;
+    std::shared_ptr<const Buffers> m_buffers;
+    qint64 m_bufferBytes;
+};
+
+#endif // MULTIDRAWBATCH_H
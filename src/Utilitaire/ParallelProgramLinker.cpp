@@ -0,0 +1,163 @@
+#include "ParallelProgramLinker.h"
+#include <QOpenGLContext>
+#include <QDebug>
+
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+namespace
+{
+  typedef void (QOPENGLF_APIENTRYP MaxShaderCompilerThreads)(GLuint count);
+}
+
+ParallelProgramLinker::ParallelProgramLinker()
+    : m_supported(false)
+{
+}
+
+bool ParallelProgramLinker::initialize()
+{
+  initializeOpenGLFunctions();
+
+  QOpenGLContext *context = QOpenGLContext::currentContext();
+  const char *function = nullptr;
+  if(context->hasExtension("GL_KHR_parallel_shader_compile"))
+  {
+    function = "glMaxShaderCompilerThreadsKHR";
+  }
+  else if(context->hasExtension("GL_ARB_parallel_shader_compile"))
+  {
+    function = "glMaxShaderCompilerThreadsARB";
+  }
+  if(!function)
+  {
+    m_supported = false;
+    return false;
+  }
+
+  // 0xFFFFFFFF lets the driver choose the number of threads
+  MaxShaderCompilerThreads maxShaderCompilerThreads = reinterpret_cast<MaxShaderCompilerThreads>(context->getProcAddress(function));
+  if(maxShaderCompilerThreads)
+  {
+    maxShaderCompilerThreads(0xFFFFFFFF);
+  }
+  m_supported = true;
+  return true;
+}
+
+GLuint ParallelProgramLinker::compileShader(GLenum type, const QString &source)
+{
+  const QByteArray code = source.toUtf8();
+  const char *text = code.constData();
+  const GLuint shader = glCreateShader(type);
+  glShaderSource(shader, 1, &text, nullptr);
+  glCompileShader(shader); // the status is not read, it would wait for the compilation
+  return shader;
+}
+
+void ParallelProgramLinker::submit(int id, QOpenGLShaderProgram &program, const QString &vertexSource, const QString &fragmentSource)
+{
+  program.create();
+  Job job = {id, &program, {compileShader(GL_VERTEX_SHADER, vertexSource), compileShader(GL_FRAGMENT_SHADER, fragmentSource)}};
+  for(GLuint shader : job.shaders)
+  {
+    glAttachShader(program.programId(), shader);
+  }
+  glLinkProgram(program.programId());
+  m_jobs.push_back(job);
+}
+
+std::vector<ParallelProgramLinker::Finished> ParallelProgramLinker::poll()
+{
+  std::vector<Finished> finished;
+  for(auto job = m_jobs.begin(); job != m_jobs.end();)
+  {
+    GLint complete = GL_FALSE;
+    glGetProgramiv(job->program->programId(), GL_COMPLETION_STATUS_KHR, &complete);
+    if(complete == GL_FALSE)
+    {
+      ++job;
+      continue;
+    }
+    finished.push_back(this->complete(*job));
+    job = m_jobs.erase(job);
+  }
+  return finished;
+}
+
+void ParallelProgramLinker::wait()
+{
+  for(const auto &job : m_jobs)
+  {
+    // Reading the link status waits for the link
+    GLint linked = GL_FALSE;
+    glGetProgramiv(job.program->programId(), GL_LINK_STATUS, &linked);
+  }
+}
+
+ParallelProgramLinker::Finished ParallelProgramLinker::complete(const Job &job)
+{
+  GLint linked = GL_FALSE;
+  glGetProgramiv(job.program->programId(), GL_LINK_STATUS, &linked);
+
+  Finished finished = {job.id, linked != GL_FALSE, QString()};
+  if(finished.linked)
+  {
+    // Without shaders of its own, QOpenGLShaderProgram::link() reads the link status of the program
+    finished.linked = job.program->link();
+  }
+  else
+  {
+    finished.log = shaderLog(job.shaders[0]) + shaderLog(job.shaders[1]) + programLog(job.program->programId());
+  }
+  release(job);
+  return finished;
+}
+
+void ParallelProgramLinker::release(const Job &job)
+{
+  for(GLuint shader : job.shaders)
+  {
+    glDetachShader(job.program->programId(), shader);
+    glDeleteShader(shader);
+  }
+}
+
+QString ParallelProgramLinker::shaderLog(GLuint shader)
+{
+  GLint length = 0;
+  glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+  if(length <= 1)
+  {
+    return QString();
+  }
+  QByteArray log(length, Qt::Uninitialized);
+  glGetShaderInfoLog(shader, length, nullptr, log.data());
+  return QString::fromUtf8(log.constData());
+}
+
+QString ParallelProgramLinker::programLog(GLuint program)
+{
+  GLint length = 0;
+  glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+  if(length <= 1)
+  {
+    return QString();
+  }
+  QByteArray log(length, Qt::Uninitialized);
+  glGetProgramInfoLog(program, length, nullptr, log.data());
+  return QString::fromUtf8(log.constData());
+}
+
+void ParallelProgramLinker::destroy()
+{
+  for(const auto &job : m_jobs)
+  {
+    release(job);
+  }
+  m_jobs.clear();
+}
@@ -0,0 +1,58 @@
+#ifndef PARALLELPROGRAMLINKER_H
+#define PARALLELPROGRAMLINKER_H
+
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLShaderProgram>
+#include <QString>
+#include <vector>
+
+// Compiles and links several programs at once with GL_KHR_parallel_shader_compile (or its ARB version).
+// Every compilation and link is submitted before any status is read, the driver runs them on its own threads,
+// and poll() hands back the finished programs by reading GL_COMPLETION_STATUS_KHR, which never blocks.
+// A program is linked by QOpenGLShaderProgram::link() once complete, it only reads the link status then.
+class ParallelProgramLinker : protected QOpenGLExtraFunctions
+{
+  public:
+    struct Finished
+    {
+      int id;
+      bool linked;
+      QString log; // compilation and link errors, empty if linked
+    };
+
+    ParallelProgramLinker();
+
+    // Must be called with a current context, returns false if the extension is not supported
+    bool initialize();
+    bool isSupported() const { return m_supported; }
+
+    // Start the compilation of the program, its id is returned by poll()
+    void submit(int id, QOpenGLShaderProgram &program, const QString &vertexSource, const QString &fragmentSource);
+    // The programs completed since the last call, without waiting for the others
+    std::vector<Finished> poll();
+    // Block until every submitted program is complete, poll() then returns them
+    void wait();
+    int pendingCount() const { return static_cast<int>(m_jobs.size()); }
+
+    // Abandon the pending programs
+    void destroy();
+
+  private:
+    struct Job
+    {
+      int id;
+      QOpenGLShaderProgram *program;
+      GLuint shaders[2];
+    };
+
+    GLuint compileShader(GLenum type, const QString &source);
+    Finished complete(const Job &job);
+    void release(const Job &job);
+    QString shaderLog(GLuint shader);
+    QString programLog(GLuint program);
+
+    std::vector<Job> m_jobs;
+    bool m_supported;
+};
+
+#endif // PARALLELPROGRAMLINKER_H
@@ -0,0 +1,885 @@
+#include "PeelingRenderer.h"
+#include "SceneImporter.h"
+#include <QOpenGLContext>
+#include <QThread>
+#include <algorithm>
+#include <iostream>
+
+PeelingRenderer::PeelingRenderer() :
+                    m_useDepthPeeling(true),
+                    m_gltfLoader(this),
+                    m_fullScreenQuadList(0),
+                    m_drawSubjects(false),
+                    m_drawScalars(false),
+                    m_useMultiDraw(false),
+                    m_automaticLayout(true),
+                    m_depthPrePass(false),
+                    m_pendingPrograms(0)
+{
+  // -- init light --
+    m_light.direction = QVector3D(0.0f, -1.0f, -2.0f);
+    m_light.ambient = QVector3D(1.0f, 1.0f, 1.0f);
+    m_light.diffuse = QVector3D(0.5f, 0.5f, 0.5f);
+    m_light.specular = QVector3D(1.0f, 1.0f, 1.0f);
+    m_light.intensity = 1.0f;
+
+  // -- init materials --
+    //m_material.ambient = QVector4D(1.0f, 1.0f, 0.0f, 0.5f); Using the shape's color
+    m_material.diffuse = QVector3D(0.f, 0.0f, 0.0f);
+    m_material.specular = QVector3D(1.0f, 1.0f, 1.0f);
+    m_material.shininess = 32.0f;
+}
+
+PeelingRenderer::~PeelingRenderer()
+{
+  // The owner calls destroy() while the context is current
+}
+
+// ------------------------------------------------------ Initialize functions ------------------------------------------------------
+
+bool PeelingRenderer::initialize(const QString &shaderDirectory)
+{
+  initializeOpenGLFunctions();
+  m_stateCache.initialize();
+  m_programCache.initialize();
+  createFullScreenQuad();
+
+  // The programs are all submitted before any is waited for: to the driver threads if it has them,
+  // else to a context shared with a worker thread
+  m_compileTimer.start();
+  if(!m_linker.initialize() && !m_reloader.start(QOpenGLContext::currentContext()))
+  {
+    std::cout << "The shaders are compiled one after the other" << std::endl;
+  }
+
+  m_shaderManagers.emplace_back(new ShaderManager(shaderDirectory));
+  ShaderManager &manager = *m_shaderManagers.back();
+
+  // -- Blinn-Phong + Depth Peeling shaders, one per material kind --
+  bool mainLinked = true;
+  for(int v = 0; v < VariantCount; ++v)
+  {
+    for(int kind = 0; kind < RenderQueue::KindCount; ++kind)
+    {
+      const QStringList defines = {QString("MATERIAL_KIND %1").arg(kind), QString("PEEL_LAYER %1").arg(v)};
+      mainLinked = buildProgram(m_mainPrograms[v][kind], manager, "main.vs.glsl", "main.fs.glsl", defines) && mainLinked;
+    }
+  }
+  // -- Blending shaders --
+  const bool blendLinked = buildProgram(m_blendProgram, manager, "blend.vs.glsl", "blend.fs.glsl");
+  // -- Instanced subjects shaders, only needed if subjects are loaded --
+  buildVariants(m_instancedPrograms, manager, "instanced.vs.glsl", "instanced.fs.glsl");
+  // -- Streamed scalars shaders, colored like the subjects --
+  buildVariants(m_scalarPrograms, manager, "scalar.vs.glsl", "instanced.fs.glsl");
+  // -- Depth pre-pass shaders, only needed if it is enabled --
+  buildVariants(m_depthPrograms, manager, "depth.vs.glsl", "depth.fs.glsl");
+  // -- Multi-draw shaders, need OpenGL 4.3 --
+  if(MultiDrawBatch::isSupported())
+  {
+    m_shaderManagers.emplace_back(new ShaderManager(shaderDirectory, "430 compatibility"));
+    ShaderManager &manager430 = *m_shaderManagers.back();
+    buildVariants(m_indirectPrograms, manager430, "indirect.vs.glsl", "indirect.fs.glsl");
+  }
+  for(auto &slot : m_programSlots)
+  {
+    setUpProgram(*slot.program);
+  }
+  std::cout << "Shader programs: " << m_programCache.hits() << " loaded from the cache, " << m_programCache.misses() << " to compile" << std::endl;
+  return mainLinked && blendLinked;
+}
+
+bool PeelingRenderer::loadModel(const QString &fileName)
+{
+  std::shared_ptr<const SceneData> scene = SceneImporter::load(fileName);
+  if(!scene)
+  {
+    return false;
+  }
+  if(m_automaticLayout)
+  {
+    m_gltfLoader.setVertexLayout(m_layoutBenchmark.choose(scene, m_depthPrePass));
+  }
+  m_stateCache.countUpload(m_gltfLoader.upload(scene));
+
+  if(!m_materials.build(m_gltfLoader))
+  {
+    std::cout << "Could not build the materials of " << fileName.toStdString() << std::endl;
+    return false;
+  }
+  m_stateCache.countUpload(m_materials.uploadedBytes());
+  for(auto &slot : m_programSlots)
+  {
+    setUpProgram(*slot.program);
+  }
+  m_renderQueue.build(m_gltfLoader, m_materials);
+  return true;
+}
+
+bool PeelingRenderer::buildProgram(ProgramPointer &pointer, ShaderManager &manager, const QString &vertex, const QString &fragment,
+                                   const QStringList &defines)
+{
+  manager.loadModule(vertex);
+  manager.loadModule(fragment);
+
+  const QString vertexSource = manager.buildVariant(vertex, defines);
+  const QString fragmentSource = manager.buildVariant(fragment, defines);
+
+  // Registered even if it does not compile, the reload may fix it
+  ProgramSlot slot;
+  slot.program = &pointer;
+  slot.source = {manager.baseDir(), manager.version(), vertex, fragment, defines};
+  slot.files = manager.dependencyClosure(vertex);
+  for(const auto &file : manager.dependencyClosure(fragment))
+  {
+    if(!slot.files.contains(file))
+    {
+      slot.files << file;
+    }
+  }
+  slot.manager = &manager;
+  // The expanded sources are the key, an edited include invalidates the binary too
+  slot.key = m_programCache.key({vertexSource, fragmentSource});
+  slot.pending = false;
+  const int id = static_cast<int>(m_programSlots.size());
+
+  pointer.reset(new QOpenGLShaderProgram());
+  QOpenGLShaderProgram &program = *pointer;
+  if(m_programCache.load(program, slot.key))
+  {
+    m_programSlots.push_back(slot);
+    return true;
+  }
+
+  // Compiled in the background, completed by updatePrograms()
+  if(m_linker.isSupported() || m_reloader.isRunning())
+  {
+    if(m_linker.isSupported())
+    {
+      m_programCache.prepare(program);
+      m_linker.submit(id, program, vertexSource, fragmentSource);
+    }
+    else
+    {
+      m_reloader.compile(id, slot.source);
+    }
+    slot.pending = true;
+    m_pendingPrograms++;
+    m_programSlots.push_back(slot);
+    return true;
+  }
+  m_programSlots.push_back(slot);
+
+  if(!program.addShaderFromSourceCode(QOpenGLShader::Vertex, vertexSource))
+  {
+    std::cout << vertex.toStdString() << " shader error : " << manager.annotateLog(program.log()).toStdString() << std::endl;
+    return false;
+  }
+
+  if(!program.addShaderFromSourceCode(QOpenGLShader::Fragment, fragmentSource))
+  {
+    std::cout << fragment.toStdString() << " shader error : " << manager.annotateLog(program.log()).toStdString() << std::endl;
+    return false;
+  }
+
+  m_programCache.prepare(program);
+  if(!program.link())
+  {
+    std::cout << vertex.toStdString() << " link shader error : " << manager.annotateLog(program.log()).toStdString() << std::endl;
+    return false;
+  }
+  m_programCache.save(program, slot.key);
+  return true;
+}
+
+bool PeelingRenderer::buildVariants(ProgramPointer *programs, ShaderManager &manager, const QString &vertex, const QString &fragment,
+                                    const QStringList &defines)
+{
+  bool linked = true;
+  for(int v = 0; v < VariantCount; ++v)
+  {
+    linked = buildProgram(programs[v], manager, vertex, fragment, defines + QStringList(QString("PEEL_LAYER %1").arg(v))) && linked;
+  }
+  return linked;
+}
+
+bool PeelingRenderer::isLinked(const ProgramPointer *programs, int count)
+{
+  for(int i = 0; i < count; ++i)
+  {
+    if(!programs[i] || !programs[i]->isLinked())
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool PeelingRenderer::isAvailable(const ProgramPointer *programs, int count) const
+{
+  for(int i = 0; i < count; ++i)
+  {
+    const auto slot = std::find_if(m_programSlots.begin(), m_programSlots.end(),
+                                   [&](const ProgramSlot &candidate) { return candidate.program == &programs[i]; });
+    const bool pending = slot != m_programSlots.end() && slot->pending;
+    if(!pending && (!programs[i] || !programs[i]->isLinked()))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+void PeelingRenderer::setUpProgram(ProgramPointer &program)
+{
+  if(!program || !program->isLinked() || &program == &m_blendProgram)
+  {
+    return;
+  }
+  m_materials.setUpProgram(*program);
+  for(auto &instanced : m_instancedPrograms)
+  {
+    if(&program == &instanced)
+    {
+      m_subjects.setUpProgram(*program);
+    }
+  }
+}
+
+// ------------------------------------------------------ Shader hot reload ------------------------------------------------------
+
+bool PeelingRenderer::enableShaderReload(QOpenGLContext *context)
+{
+  if(!m_reloader.start(context))
+  {
+    return false;
+  }
+  for(size_t i = 0; i < m_programSlots.size(); ++i)
+  {
+    m_reloader.watch(static_cast<int>(i), m_programSlots[i].source, m_programSlots[i].files);
+  }
+  return true;
+}
+
+// ------------------------------------------------------ Background compilation ------------------------------------------------------
+
+bool PeelingRenderer::updatePrograms()
+{
+  const std::vector<ParallelProgramLinker::Finished> linked = m_linker.poll();
+  for(const auto &finished : linked)
+  {
+    ProgramSlot &slot = m_programSlots[finished.id];
+    if(!finished.linked)
+    {
+      std::cout << slot.source.vertex.toStdString() << " / " << slot.source.fragment.toStdString() << " shader error : "
+                << slot.manager->annotateLog(finished.log).toStdString() << std::endl;
+    }
+    completeProgram(slot);
+  }
+
+  const std::vector<ShaderReloader::Result> results = m_reloader.takeResults();
+  for(const auto &result : results)
+  {
+    ProgramSlot &slot = m_programSlots[result.id];
+    if(result.program)
+    {
+      slot.program->reset(result.program); // the previous program is deleted, the context is current
+    }
+    completeProgram(slot);
+  }
+  if(linked.empty() && results.empty())
+  {
+    return false;
+  }
+
+  programsChanged();
+  return true;
+}
+
+void PeelingRenderer::programsChanged()
+{
+  // The state and the locations cached for the previous programs are stale, their ids may be reused
+  m_stateCache.invalidateBindings();
+  m_stateCache.invalidateUniforms();
+  m_renderQueue.invalidateLocations();
+
+  // The paths enabled while their programs were compiling are dropped if they did not link
+  if(isReady() && m_drawSubjects && !isLinked(m_instancedPrograms, VariantCount))
+  {
+    std::cout << "The instanced shaders did not link, the subjects are not drawn" << std::endl;
+    m_drawSubjects = false;
+  }
+  if(isReady() && m_drawScalars && !isLinked(m_scalarPrograms, VariantCount))
+  {
+    std::cout << "The scalar shaders did not link, the scalars are not drawn" << std::endl;
+    m_drawScalars = false;
+  }
+  if(isReady() && m_depthPrePass && !isLinked(m_depthPrograms, VariantCount))
+  {
+    std::cout << "The depth shaders did not link, the layers are drawn without depth pre-pass" << std::endl;
+    m_depthPrePass = false;
+  }
+  if(isReady() && m_useMultiDraw && !isLinked(m_indirectPrograms, VariantCount))
+  {
+    std::cout << "The multi-draw shaders did not link, the meshes are drawn one by one" << std::endl;
+    m_useMultiDraw = false;
+  }
+}
+
+void PeelingRenderer::completeProgram(ProgramSlot &slot)
+{
+  if(slot.pending)
+  {
+    slot.pending = false;
+    m_programCache.save(**slot.program, slot.key);
+    if(--m_pendingPrograms == 0)
+    {
+      std::cout << "Shader programs ready in " << m_compileTimer.elapsed() << " ms" << std::endl;
+    }
+  }
+  setUpProgram(*slot.program);
+}
+
+void PeelingRenderer::compileNow(ProgramSlot &slot)
+{
+  const ShaderReloader::Source &source = slot.source;
+  ShaderManager manager(source.directory, source.version);
+  manager.loadModule(source.vertex);
+  manager.loadModule(source.fragment);
+
+  QOpenGLShaderProgram *program = new QOpenGLShaderProgram();
+  m_programCache.prepare(*program);
+  if(!program->addShaderFromSourceCode(QOpenGLShader::Vertex, manager.buildVariant(source.vertex, source.defines)) ||
+     !program->addShaderFromSourceCode(QOpenGLShader::Fragment, manager.buildVariant(source.fragment, source.defines)) ||
+     !program->link())
+  {
+    std::cout << source.vertex.toStdString() << " / " << source.fragment.toStdString() << " shader error : "
+              << manager.annotateLog(program->log()).toStdString() << std::endl;
+    delete program;
+  }
+  else
+  {
+    slot.program->reset(program);
+  }
+  completeProgram(slot);
+}
+
+bool PeelingRenderer::waitForPrograms()
+{
+  m_linker.wait();
+  updatePrograms();
+  QElapsedTimer deadline;
+  deadline.start();
+  while(!isReady() && deadline.elapsed() < CompileTimeout)
+  {
+    QThread::msleep(1); // the shared context compiles the others
+    updatePrograms();
+  }
+
+  // The worker is stuck or its context is unusable, the rest is compiled here
+  if(!isReady())
+  {
+    std::cout << "The background compilation did not finish in " << CompileTimeout << " ms, compiling "
+              << m_pendingPrograms << " programs now" << std::endl;
+    for(auto &slot : m_programSlots)
+    {
+      if(slot.pending)
+      {
+        compileNow(slot);
+      }
+    }
+    programsChanged();
+  }
+
+  bool linked = isLinked(&m_blendProgram, 1);
+  for(const auto &programs : m_mainPrograms)
+  {
+    linked = isLinked(programs, RenderQueue::KindCount) && linked;
+  }
+  return linked;
+}
+
+void PeelingRenderer::createFullScreenQuad()
+{
+  GLuint displayListId = glGenLists(1);
+
+  glNewList(displayListId, GL_COMPILE);
+  {
+    glBegin(GL_TRIANGLES);
+
+    // front face
+    glTexCoord2f(0.0f, 0.0f);
+    glVertex2f(-1.0f, -1.0f);
+    glTexCoord2f(1.0f, 0.0f);
+    glVertex2f(1.0f, -1.0f);
+    glTexCoord2f(1.0f, 1.0f);
+    glVertex2f(1.0f, 1.0f);
+
+    glTexCoord2f(0.0f, 0.0f);
+    glVertex2f(-1.0f, -1.0f);
+    glTexCoord2f(1.0f, 1.0f);
+    glVertex2f(1.0f, 1.0f);
+    glTexCoord2f(0.0f, 1.0f);
+    glVertex2f(-1.0f, 1.0f);
+
+    glEnd();
+  }
+  glEndList();
+
+  m_fullScreenQuadList = displayListId;
+}
+
+int PeelingRenderer::templateVertexCount() const
+{
+  int vertices = 0;
+  for(const auto& mesh : m_gltfLoader.m_meshes)
+  {
+    vertices += mesh.vertexCount;
+  }
+  return vertices;
+}
+
+float PeelingRenderer::templateRadius() const
+{
+  float radius = 0.0f;
+  for(const auto& mesh : m_gltfLoader.m_meshes)
+  {
+    radius = std::max(radius, mesh.boundingRadius);
+  }
+  return radius;
+}
+
+bool PeelingRenderer::uploadSubjects()
+{
+  m_drawSubjects = isAvailable(m_instancedPrograms, VariantCount) && m_subjects.upload();
+  if(m_drawSubjects)
+  {
+    m_stateCache.countUpload(m_subjects.uploadedBytes());
+  }
+  return m_drawSubjects;
+}
+
+bool PeelingRenderer::startScalars(const QString &fileName, double framesPerSecond, const std::function<void()> &onFrame)
+{
+  stopScalars();
+  m_drawScalars = isAvailable(m_scalarPrograms, VariantCount) &&
+                  m_scalars.start(fileName, templateVertexCount(), framesPerSecond, onFrame);
+  if(m_drawScalars && !m_scalars.isPersistent())
+  {
+    std::cout << "The scalars are streamed without persistent mapping" << std::endl;
+  }
+  return m_drawScalars;
+}
+
+void PeelingRenderer::stopScalars()
+{
+  m_scalars.stop();
+  m_drawScalars = false;
+}
+
+bool PeelingRenderer::updateScalars()
+{
+  if(!m_drawScalars)
+  {
+    return false;
+  }
+  const qint64 bytes = m_scalars.update();
+  m_stateCache.countUpload(bytes);
+  return bytes > 0;
+}
+
+bool PeelingRenderer::setMultiDrawIndirect(bool enabled)
+{
+  if(enabled && !m_multiDraw.isBuilt())
+  {
+    if(!isAvailable(m_indirectPrograms, VariantCount) || !m_multiDraw.build(m_gltfLoader, m_materials))
+    {
+      std::cout << "Multi-draw indirect is not supported, the meshes are drawn one by one" << std::endl;
+      enabled = false;
+    }
+    else
+    {
+      m_stateCache.countUpload(m_multiDraw.bufferBytes());
+    }
+  }
+  m_useMultiDraw = enabled;
+  return m_useMultiDraw;
+}
+
+bool PeelingRenderer::setVertexLayout(const QString &name)
+{
+  if(name == "auto")
+  {
+    m_automaticLayout = true;
+  }
+  else if(name == "interleaved" || name == "split")
+  {
+    m_automaticLayout = false;
+    m_gltfLoader.setVertexLayout(name == "split" ? GLTFLoader::VertexLayout::Split : GLTFLoader::VertexLayout::Interleaved);
+  }
+  else
+  {
+    std::cout << "Unknown vertex layout " << name.toStdString() << ", expected auto, interleaved or split" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool PeelingRenderer::setDepthPrePass(bool enabled)
+{
+  m_depthPrePass = enabled && (m_programSlots.empty() || isAvailable(m_depthPrograms, VariantCount));
+  return m_depthPrePass == enabled;
+}
+
+void PeelingRenderer::setCamera(const QMatrix4x4 &view, const QMatrix4x4 &projection, const QVector3D &position)
+{
+  m_viewMatrix = view;
+  m_projectionMatrix = projection;
+  m_viewPosition = position;
+}
+
+// ------------------------------------------------------ Drawing functions ------------------------------------------------------
+
+// Unlit vertex colors, the client arrays of the meshes feed the fixed function pipeline
+void PeelingRenderer::renderFallback()
+{
+  m_stateCache.invalidateBindings();
+  m_stateCache.releaseProgram();
+  glEnable(GL_DEPTH_TEST);
+
+  glMatrixMode(GL_PROJECTION);
+  glLoadMatrixf(m_projectionMatrix.constData());
+  glMatrixMode(GL_MODELVIEW);
+  for(const auto &mesh : m_gltfLoader.m_meshes)
+  {
+    glLoadMatrixf((m_viewMatrix * mesh.modelMatrix).constData());
+    m_gltfLoader.draw(mesh);
+    m_stateCache.countDraw();
+  }
+  glLoadIdentity();
+  glMatrixMode(GL_PROJECTION);
+  glLoadIdentity();
+  glMatrixMode(GL_MODELVIEW);
+
+  glDisable(GL_DEPTH_TEST);
+}
+
+void PeelingRenderer::renderScene()
+{
+  m_stateCache.invalidateBindings();
+  glEnable(GL_DEPTH_TEST);
+  renderGLTF(FirstLayer);
+  m_stateCache.releaseProgram();
+}
+
+// Binds the program of the variant for the enabled path, the per-mesh path binds one program per material kind
+void PeelingRenderer::renderGLTF(Variant variant)
+{
+  if(m_gltfLoader.m_meshes.empty())
+  {
+    return;
+  }
+
+  // Every material is bound once, the draws only select one of them
+  m_materials.bind(m_stateCache);
+
+  if(m_drawSubjects)
+  {
+    QOpenGLShaderProgram &program = *m_instancedPrograms[variant];
+    m_stateCache.bindProgram(program);
+    setDepthPeelingUniforms(program);
+    renderSubjects(program);
+    m_stateCache.invalidateTextures();
+    return;
+  }
+
+  if(m_drawScalars && m_scalars.hasFrame())
+  {
+    QOpenGLShaderProgram &program = *m_scalarPrograms[variant];
+    m_stateCache.bindProgram(program);
+    setDepthPeelingUniforms(program);
+    renderScalars(program);
+    return;
+  }
+
+  if(m_useMultiDraw)
+  {
+    QOpenGLShaderProgram &program = *m_indirectPrograms[variant];
+    m_stateCache.bindProgram(program);
+    setDepthPeelingUniforms(program);
+    m_stateCache.setUniform(program, "u_projection", m_projectionMatrix);
+    m_stateCache.setUniform(program, "u_view", m_viewMatrix);
+    m_multiDraw.draw(m_gltfLoader);
+    m_stateCache.countDraw();
+    return;
+  }
+
+  if(m_depthPrePass)
+  {
+    // The shaded pass only keeps the fragments at the depth of the pre-pass
+    renderDepth(variant);
+    glDepthFunc(GL_LEQUAL);
+    glDepthMask(GL_FALSE);
+  }
+
+  QOpenGLShaderProgram *programs[RenderQueue::KindCount];
+  for(int kind = 0; kind < RenderQueue::KindCount; ++kind)
+  {
+    programs[kind] = m_mainPrograms[variant][kind].get();
+  }
+  m_renderQueue.submit(m_stateCache, m_gltfLoader, programs, m_projectionMatrix, m_viewMatrix,
+                       [this](QOpenGLShaderProgram &program) { setDepthPeelingUniforms(program); });
+
+  if(m_depthPrePass)
+  {
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+  }
+}
+
+// Only the positions are read, a fraction of the vertex with the Split layout.
+// The fragments in front of the previous layer are discarded here too, so the depth is the one of the peeled layer.
+void PeelingRenderer::renderDepth(Variant variant)
+{
+  QOpenGLShaderProgram &program = *m_depthPrograms[variant];
+  m_stateCache.bindProgram(program);
+  setDepthPeelingUniforms(program);
+  m_stateCache.setUniform(program, "u_projection", m_projectionMatrix);
+  m_stateCache.setUniform(program, "u_view", m_viewMatrix);
+
+  glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+  for(const auto &mesh : m_gltfLoader.m_meshes)
+  {
+    m_stateCache.setUniform(program, "u_model", mesh.modelMatrix);
+    m_gltfLoader.draw(mesh, true);
+    m_stateCache.countDraw();
+  }
+  glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+// The draw count only depends on the number of meshes, not on the number of subjects (up to SubjectInstances::MaxPerDraw)
+void PeelingRenderer::renderSubjects(QOpenGLShaderProgram &shaderProgram)
+{
+  m_stateCache.setUniform(shaderProgram, "u_projection", m_projectionMatrix);
+  m_stateCache.setUniform(shaderProgram, "u_view", m_viewMatrix);
+  m_stateCache.setUniform(shaderProgram, "u_verticesPerSubject", m_subjects.verticesPerSubject());
+  m_stateCache.setUniform(shaderProgram, "u_scalarRange", m_subjects.scalarRange());
+  m_stateCache.setUniform(shaderProgram, "u_subjectScalars", 2);
+
+  for(int chunk = 0; chunk < m_subjects.chunkCount(); ++chunk)
+  {
+    m_subjects.bind(chunk, 2);
+    m_stateCache.setUniform(shaderProgram, "u_instanceBase", chunk * SubjectInstances::MaxPerDraw);
+
+    int vertexOffset = 0;
+    for(size_t i = 0; i < m_gltfLoader.m_meshes.size(); ++i)
+    {
+      // The colormap of the material of the template colors the scalars
+      const GLTFLoader::Mesh &mesh = m_gltfLoader.m_meshes[i];
+      m_stateCache.setUniform(shaderProgram, "u_material", m_materials.materialOf(static_cast<int>(i)));
+      m_stateCache.setUniform(shaderProgram, "u_model", mesh.modelMatrix);
+      m_stateCache.setUniform(shaderProgram, "u_vertexOffset", vertexOffset);
+      m_gltfLoader.drawInstanced(mesh, m_subjects.chunkSize(chunk));
+      m_stateCache.countDraw();
+      vertexOffset += mesh.vertexCount;
+    }
+  }
+
+  glActiveTexture(GL_TEXTURE2);
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+  m_stateCache.invalidateTextures(); // the active unit changed behind the cache
+}
+
+// The scalars are an extra attribute next to the buffers of the meshes
+void PeelingRenderer::renderScalars(QOpenGLShaderProgram &shaderProgram)
+{
+  const int location = shaderProgram.attributeLocation("a_scalar");
+  if(location < 0)
+  {
+    return;
+  }
+  m_stateCache.setUniform(shaderProgram, "u_projection", m_projectionMatrix);
+  m_stateCache.setUniform(shaderProgram, "u_view", m_viewMatrix);
+  m_stateCache.setUniform(shaderProgram, "u_scalarRange", m_scalars.range());
+
+  int vertexOffset = 0;
+  for(size_t i = 0; i < m_gltfLoader.m_meshes.size(); ++i)
+  {
+    // The colormap of the material of the mesh colors the scalars
+    const GLTFLoader::Mesh &mesh = m_gltfLoader.m_meshes[i];
+    m_stateCache.setUniform(shaderProgram, "u_material", m_materials.materialOf(static_cast<int>(i)));
+    m_stateCache.setUniform(shaderProgram, "u_model", mesh.modelMatrix);
+    m_scalars.bind(location, vertexOffset);
+    m_gltfLoader.draw(mesh);
+    m_stateCache.countDraw();
+    vertexOffset += mesh.vertexCount;
+  }
+  m_scalars.release(location);
+}
+
+// ------------------------------------------------------ Uniforms functions ------------------------------------------------------
+
+// set the specific uniforms in shaders/Mix/peeling.frag
+// the layer and the use of depth peeling select the variant of the program
+void PeelingRenderer::setDepthPeelingUniforms(QOpenGLShaderProgram &program)
+{
+  m_stateCache.setUniform(program, "u_previousDepthTexture", 3);
+}
+
+// set the specific uniforms in shaders/Mix/BlinnPhong.frag
+void PeelingRenderer::setBlinnPhongUniforms(QOpenGLShaderProgram &program)
+{
+  program.setUniformValue("u_lightDirection", m_light.direction);
+  program.setUniformValue("u_lightAmbient", m_light.ambient);
+  program.setUniformValue("u_lightDiffuse", m_light.diffuse);
+  program.setUniformValue("u_lightSpecular", m_light.specular);
+  program.setUniformValue("u_lightIntensity", m_light.intensity);
+
+  //program.setUniformValue("u_materialAmbient", m_material.ambient); // unused because we use the color of the object
+  program.setUniformValue("u_materialDiffuse", m_material.diffuse);
+  program.setUniformValue("u_materialSpecular", m_material.specular);
+  program.setUniformValue("u_materialShininess", m_material.shininess);
+
+  // Position de la caméra pour le calcul spéculaire
+  program.setUniformValue("u_viewPosition", m_viewPosition);
+}
+
+// ------------------------------------------------------ Depth peeling functions ------------------------------------------------------
+
+// Apply the depth peeling algorithm with the Blinn-Phong shading
+// Only the layers [firstLayer, lastLayer[ are peeled, the others are still valid in the textures
+bool PeelingRenderer::peel(const QSize &size, int firstLayer, int lastLayer)
+{
+  // The allocation of the targets may have failed, there is then no layer to render into
+  lastLayer = std::min(lastLayer, m_renderTargets.layerCount());
+  if(!m_renderTargets.isAllocated())
+  {
+    return false;
+  }
+
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  m_stateCache.invalidateBindings();
+
+  glEnable(GL_DEPTH_TEST);
+  glViewport(0, 0, size.width(), size.height());
+  if(firstLayer == 0 && lastLayer > 0)
+  {
+    initDepthPeeling();
+  }
+  depthPeelingPass(std::max(firstLayer, 1), lastLayer);
+  m_stateCache.releaseProgram();
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+  glDisable(GL_DEPTH_TEST);
+  return true;
+}
+
+// Initialize the first depth peeling pass to render the scene in the first framebuffer
+void PeelingRenderer::initDepthPeeling()
+{
+  m_renderTargets.framebuffer(0)->bind();
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  //setBlinnPhongUniforms(program);
+
+  renderGLTF(FirstLayer);
+
+  m_renderTargets.framebuffer(0)->release();
+}
+
+// Render the scene in the i-th framebuffer and perform the depth peeling pass
+void PeelingRenderer::depthPeelingPass(int firstLayer, int lastLayer)
+{
+  for(int i = firstLayer; i<lastLayer; ++i)
+  {
+    m_renderTargets.framebuffer(i)->bind();
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    m_stateCache.bindTexture(3, GL_TEXTURE_2D, m_renderTargets.depthTexture(i-1)->textureId());
+
+    //setBlinnPhongUniforms(program);
+
+    renderGLTF(variant(i));
+
+    m_renderTargets.framebuffer(i)->release();
+  }
+
+  // The depth textures are shared between layers, do not leave one bound while it may be rendered into
+  m_stateCache.bindTexture(3, GL_TEXTURE_2D, 0);
+}
+
+// Blend the color textures of the layers into the framebuffer
+void PeelingRenderer::blend(GLuint framebuffer, const QSize &size, int layerCount)
+{
+  if(!m_renderTargets.isAllocated())
+  {
+    return;
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+  m_stateCache.invalidateBindings();
+  m_stateCache.bindProgram(*m_blendProgram);
+
+  const int layers = std::min(m_renderTargets.layerCount(), static_cast<int>(MaxLayers));
+  for(int i=0; i<layers; ++i)
+  {
+    m_stateCache.bindTexture(4+i, GL_TEXTURE_2D, m_renderTargets.colorTexture(i)->textureId());
+    m_stateCache.setUniform(*m_blendProgram, QString("u_layerTexture[%1]").arg(i).toStdString().c_str(), 4+i);
+  }
+
+  // The layers may only cover a part of the textures, the quad samples this part and upscales it
+  const QSize allocated = m_renderTargets.allocatedSize();
+  const QVector2D uvScale(static_cast<float>(size.width()) / allocated.width(),
+                          static_cast<float>(size.height()) / allocated.height());
+  m_blendProgram->setUniformValue("u_uvScale", uvScale);
+  m_stateCache.setUniform(*m_blendProgram, "u_numLayers", std::min(layerCount, layers));
+  m_stateCache.setUniform(*m_blendProgram, "u_useDepthPeeling", m_useDepthPeeling ? 1 : 0);
+
+  glCallList(m_fullScreenQuadList);
+  m_stateCache.countDraw();
+
+  m_stateCache.releaseProgram();
+
+  glDisable(GL_BLEND);
+}
+
+// ------------------------------------------------------ Clean up functions ------------------------------------------------------
+
+void PeelingRenderer::destroy()
+{
+  if(m_fullScreenQuadList != 0)
+  {
+    glDeleteLists(m_fullScreenQuadList, 1);
+    m_fullScreenQuadList = 0;
+  }
+
+  // The reloaded programs use the functions of the reload context, they are deleted before it
+  m_linker.destroy();
+  for(auto &slot : m_programSlots)
+  {
+    ProgramPointer &program = *slot.program;
+    if(program && program->isLinked())
+    {
+      program->removeAllShaders();
+      program->release();
+    }
+    program.reset();
+  }
+  m_programSlots.clear();
+  m_shaderManagers.clear();
+  m_pendingPrograms = 0;
+  m_reloader.stop();
+
+  m_subjects.destroy();
+  m_drawSubjects = false;
+  stopScalars();
+  m_multiDraw.destroy();
+  m_useMultiDraw = false;
+  m_renderQueue.clear();
+  m_materials.destroy();
+  m_stateCache.invalidateUniforms();
+
+  m_renderTargets.release();
+  m_gltfLoader.cleanUp();
+}
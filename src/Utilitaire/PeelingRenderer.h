@@ -0,0 +1,228 @@
+#ifndef PEELINGRENDERER_H
+#define PEELINGRENDERER_H
+
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QMatrix4x4>
+#include <QVector2D>
+#include <QVector3D>
+#include <QVector4D>
+#include <QSize>
+#include <QElapsedTimer>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "gltfLoader.h"
+#include "RenderTargetPool.h"
+#include "SubjectInstances.h"
+#include "ScalarStream.h"
+#include "MultiDrawBatch.h"
+#include "GLStateCache.h"
+#include "RenderQueue.h"
+#include "MaterialLibrary.h"
+#include "ProgramBinaryCache.h"
+#include "ParallelProgramLinker.h"
+#include "ShaderManager.h"
+#include "ShaderReloader.h"
+#include "VertexLayoutBenchmark.h"
+
+// Depth peeling of a glTF model, shared by the interactive widget and the offline batch renderer.
+// It owns the shaders, the model and the peeling layers, the caller decides what is rendered each frame:
+// which layers are peeled, at which size, and in which framebuffer the layers are blended.
+// Every function must be called with the context of initialize() current.
+// The programs missing from the binary cache are compiled in the background by initialize(), until isReady()
+// the caller either draws renderFallback() or waits with waitForPrograms().
+class PeelingRenderer : protected QOpenGLFunctions
+{
+  public:
+    static const int MaxLayers = 16; // size of u_layerTexture in shaders/Mix/blend.fs.glsl
+    static const int CompileTimeout = 10000; // milliseconds, see waitForPrograms()
+
+    PeelingRenderer();
+    ~PeelingRenderer();
+
+    // Returns false if a program compiled in the foreground failed, see waitForPrograms() for the others
+    bool initialize(const QString &shaderDirectory);
+    bool loadModel(const QString &fileName);
+    // Mipmaps, compression and cache of the textures of the next loaded model
+    void setTextureOptions(const TextureProcessor::Options &options) { m_materials.setTextureOptions(options); }
+    void destroy();
+
+    void setCamera(const QMatrix4x4 &view, const QMatrix4x4 &projection, const QVector3D &position);
+    void setDepthPeelingEnabled(bool enabled) { m_useDepthPeeling = enabled; }
+    bool isDepthPeelingEnabled() const { return m_useDepthPeeling; }
+
+    // -- Vertex layout and depth pre-pass --
+    // Layout of the vertex buffers of the next loaded model: "interleaved", "split", or "auto" (the default) for the
+    // faster one on this driver (VertexLayoutBenchmark). Returns false for an unknown name.
+    bool setVertexLayout(const QString &name);
+    // Fill the depth of a layer with the positions only before shading it, so each pixel is shaded once.
+    // Only the per-mesh path has it. After initialize(), returns false if the depth programs failed.
+    bool setDepthPrePass(bool enabled);
+    bool isDepthPrePass() const { return m_depthPrePass; }
+
+    // -- Programs --
+    bool isReady() const { return m_pendingPrograms == 0; } // every program is compiled
+    // Swap in the programs compiled or reloaded since the last call, before a frame is rendered.
+    // Returns true if one changed.
+    bool updatePrograms();
+    // Block until every program is compiled, returns false if the main or blend programs did not link.
+    // The programs the worker did not deliver after CompileTimeout are compiled on the current context.
+    bool waitForPrograms();
+
+    // Render the model in the bound framebuffer with the fixed function pipeline, until isReady()
+    void renderFallback();
+    // Render the model in the bound framebuffer without peeling
+    void renderScene();
+    // Peel the layers [firstLayer, lastLayer[ in the area size of the render targets, the others are kept.
+    // Returns false, without drawing, if the render targets are not allocated.
+    bool peel(const QSize &size, int firstLayer, int lastLayer);
+    // Blend the first layerCount layers, rendered in the area size, into the framebuffer
+    void blend(GLuint framebuffer, const QSize &size, int layerCount);
+
+    RenderTargetPool &renderTargets() { return m_renderTargets; }
+    GLStateCache &stateCache() { return m_stateCache; } // counts the state changes of the passes
+    const GLTFLoader &model() const { return m_gltfLoader; }
+    const MaterialLibrary &materials() const { return m_materials; }
+
+    // -- Multi-subject instanced rendering --
+    int templateVertexCount() const; // Scalars per subject: the vertices of every mesh of the model
+    float templateRadius() const;
+    SubjectInstances &subjects() { return m_subjects; }
+    // Upload the subjects, the scene is then made of one instance of the model per subject
+    bool uploadSubjects();
+    bool isDrawingSubjects() const { return m_drawSubjects; }
+
+    // -- Streamed scalars --
+    // Color the model with a time series of per-vertex scalars (see ScalarSeries) played at framesPerSecond (the rate of
+    // the file if 0), through the colormap of each mesh. onFrame is called from another thread when a new frame is ready.
+    bool startScalars(const QString &fileName, double framesPerSecond, const std::function<void()> &onFrame);
+    void stopScalars();
+    // Upload the newest frame of scalars before a frame is rendered, returns true if it changed
+    bool updateScalars();
+    bool isDrawingScalars() const { return m_drawScalars; }
+    ScalarStream &scalarStream() { return m_scalars; } // to seek and pause
+
+    // -- Multi-draw indirect --
+    // Draw every mesh with one call per layer instead of one glDrawElements per mesh.
+    // Returns false if the path is not supported, the meshes are then drawn one by one.
+    bool setMultiDrawIndirect(bool enabled);
+    bool isMultiDrawIndirect() const { return m_useMultiDraw; }
+
+    // -- Shader hot reload --
+    // Watch the files of every program and recompile the programs using a changed file in the background,
+    // on a context sharing its objects with context, the current context
+    bool enableShaderReload(QOpenGLContext *context);
+    ShaderReloader &shaderReloader() { return m_reloader; } // the reloaded programs are swapped in by updatePrograms()
+
+  private:
+    // -- Shader variants --
+    // The scene programs are specialized at compile time instead of branching on uniforms for every fragment:
+    // for the pass (PEEL_LAYER, see shaders/Mix/peeling.frag) and for the material kind of the per-mesh
+    // path (MATERIAL_KIND, see shaders/Mix/material.glsl).
+    enum Variant
+    {
+      FirstLayer = 0, // every fragment is kept, also used without depth peeling
+      PeelLayer = 1,  // the fragments in front of the previous layer are discarded
+      VariantCount = 2
+    };
+
+    typedef std::unique_ptr<QOpenGLShaderProgram> ProgramPointer; // replaced when the program is reloaded
+
+    // A program and what it is built from, its index is its id for the ShaderReloader and the ParallelProgramLinker
+    struct ProgramSlot
+    {
+      ProgramPointer *program;
+      ShaderReloader::Source source;
+      QStringList files;
+      const ShaderManager *manager; // annotates the log of a program compiled in the background
+      QByteArray key; // in the program binary cache
+      bool pending; // compiled in the background
+    };
+
+    void createFullScreenQuad();
+    bool buildProgram(ProgramPointer &program, ShaderManager &manager, const QString &vertex, const QString &fragment,
+                      const QStringList &defines = QStringList());
+    // One program per variant, the defines are completed with PEEL_LAYER
+    bool buildVariants(ProgramPointer *programs, ShaderManager &manager, const QString &vertex, const QString &fragment,
+                       const QStringList &defines = QStringList());
+    static bool isLinked(const ProgramPointer *programs, int count);
+    void setUpProgram(ProgramPointer &program); // uniform blocks and samplers, after a (re)link
+    void completeProgram(ProgramSlot &slot);
+    void compileNow(ProgramSlot &slot); // a pending program, compiled on the current context
+    void programsChanged(); // drop the cached state and the paths whose programs did not link
+    bool isAvailable(const ProgramPointer *programs, int count) const; // linked or still compiling
+
+    Variant variant(int layer) const { return layer > 0 && m_useDepthPeeling ? PeelLayer : FirstLayer; }
+    void renderGLTF(Variant variant);
+    void renderSubjects(QOpenGLShaderProgram &shaderProgram); // every subject with one instanced draw per mesh
+    void renderScalars(QOpenGLShaderProgram &shaderProgram); // the meshes with the streamed scalars, one draw each
+    void renderDepth(Variant variant); // the depth pre-pass of the per-mesh path
+    void initDepthPeeling(); // Fill the first layer with the scene
+    void depthPeelingPass(int firstLayer, int lastLayer); // Peel the layers [firstLayer, lastLayer[
+
+    // -- Uniforms functions --
+    void setBlinnPhongUniforms(QOpenGLShaderProgram &program);  // Set the specific uniforms in shaders/Mix/blinnPhong.frag
+    void setDepthPeelingUniforms(QOpenGLShaderProgram &program); // Set the specific uniforms in shaders/Mix/peeling.frag
+
+    // -- Blinn-Phong parameters --
+    struct Material {
+        QVector4D ambient;
+        QVector3D diffuse;
+        QVector3D specular;
+        float shininess;
+    };
+
+    struct Light {
+        QVector3D direction;
+        QVector3D ambient;
+        QVector3D diffuse;
+        QVector3D specular;
+        float intensity;
+    };
+
+    Material m_material;
+    Light m_light;
+    bool m_useDepthPeeling;
+
+    // -- Shaders --
+    ProgramPointer m_mainPrograms[VariantCount][RenderQueue::KindCount]; // perform color computation and depth peeling
+    ProgramPointer m_blendProgram; // blend the layers
+    ProgramPointer m_instancedPrograms[VariantCount]; // main programs for the instanced subjects
+    ProgramPointer m_indirectPrograms[VariantCount]; // main programs for the multi-draw path
+    ProgramPointer m_scalarPrograms[VariantCount]; // main programs for the streamed scalars
+    ProgramPointer m_depthPrograms[VariantCount]; // positions only, for the depth pre-pass
+    std::vector<ProgramSlot> m_programSlots; // every program built
+    std::vector<std::unique_ptr<ShaderManager>> m_shaderManagers; // of the programs of m_programSlots
+    ShaderReloader m_reloader; // also compiles in the background without m_linker
+    ProgramBinaryCache m_programCache; // linked programs of the previous launches
+    ParallelProgramLinker m_linker; // compiles in the background with the driver threads
+    int m_pendingPrograms;
+    QElapsedTimer m_compileTimer;
+
+    // -- Objects --
+    GLTFLoader m_gltfLoader;
+    MaterialLibrary m_materials; // textures of the model, shared by every path
+    GLuint m_fullScreenQuadList;
+    RenderTargetPool m_renderTargets;
+    SubjectInstances m_subjects;
+    bool m_drawSubjects;
+    ScalarStream m_scalars;
+    bool m_drawScalars;
+    MultiDrawBatch m_multiDraw;
+    bool m_useMultiDraw;
+    bool m_automaticLayout; // the layout of the loaded models is chosen by m_layoutBenchmark
+    VertexLayoutBenchmark m_layoutBenchmark;
+    bool m_depthPrePass;
+
+    // -- State changes --
+    GLStateCache m_stateCache;
+    RenderQueue m_renderQueue; // meshes of the per-mesh path sorted by state
+
+    // -- Camera --
+    QMatrix4x4 m_viewMatrix;
+    QMatrix4x4 m_projectionMatrix;
+    QVector3D m_viewPosition;
+};
+
+#endif // PEELINGRENDERER_H
@@ -0,0 +1,152 @@
+#include "ProgramBinaryCache.h"
+#include <QOpenGLContext>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QDebug>
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+
+namespace
+{
+  const quint32 CacheMagic = 0x50524231; // "PRB1"
+}
+
+ProgramBinaryCache::ProgramBinaryCache(const QString &directory)
+    : m_directory(directory)
+    , m_supported(false)
+    , m_hits(0)
+    , m_misses(0)
+{
+}
+
+void ProgramBinaryCache::initialize()
+{
+  initializeOpenGLFunctions();
+
+  QOpenGLContext *context = QOpenGLContext::currentContext();
+  const QSurfaceFormat format = context->format();
+  const bool hasProgramBinary = format.version() >= qMakePair(4, 1) || context->hasExtension("GL_ARB_get_program_binary");
+  GLint formatCount = 0;
+  if(hasProgramBinary)
+  {
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+  }
+  m_supported = formatCount > 0;
+  if(!m_supported)
+  {
+    qDebug() << "Program binaries are not supported, the shaders are compiled at every launch";
+    return;
+  }
+
+  m_driver = QByteArray(reinterpret_cast<const char *>(glGetString(GL_VENDOR))) + '\n' +
+             QByteArray(reinterpret_cast<const char *>(glGetString(GL_RENDERER))) + '\n' +
+             QByteArray(reinterpret_cast<const char *>(glGetString(GL_VERSION)));
+}
+
+QByteArray ProgramBinaryCache::key(const QStringList &sources) const
+{
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(m_driver);
+  for(const auto &source : sources)
+  {
+    hash.addData(source.toUtf8());
+    hash.addData("\0", 1); // the boundary between two stages is part of the key
+  }
+  return hash.result().toHex();
+}
+
+QString ProgramBinaryCache::fileName(const QByteArray &key) const
+{
+  return QDir(m_directory).filePath(QString::fromLatin1(key) + ".bin");
+}
+
+bool ProgramBinaryCache::load(QOpenGLShaderProgram &program, const QByteArray &key)
+{
+  if(!m_supported)
+  {
+    return false;
+  }
+
+  QFile file(fileName(key));
+  if(!file.open(QIODevice::ReadOnly))
+  {
+    m_misses++;
+    return false;
+  }
+
+  QDataStream stream(&file);
+  quint32 magic;
+  quint32 binaryFormat;
+  QByteArray binary;
+  stream >> magic >> binaryFormat >> binary;
+  if(stream.status() != QDataStream::Ok || magic != CacheMagic || binary.isEmpty())
+  {
+    m_misses++;
+    return false;
+  }
+
+  // The link status tells whether the driver accepted the binary, QOpenGLShaderProgram::link() can not tell:
+  // without shaders it links the empty program when the status is false, which succeeds on a compatibility profile.
+  program.create();
+  glProgramBinary(program.programId(), binaryFormat, binary.constData(), binary.size());
+  GLint linked = GL_FALSE;
+  glGetProgramiv(program.programId(), GL_LINK_STATUS, &linked);
+  if(linked != GL_TRUE)
+  {
+    qDebug() << "The driver refused the program binary" << file.fileName() << ", compiling the shaders";
+    file.close();
+    file.remove();
+    m_misses++;
+    return false;
+  }
+  program.link(); // the status is true, only records it in the program
+  m_hits++;
+  return true;
+}
+
+void ProgramBinaryCache::prepare(QOpenGLShaderProgram &program)
+{
+  if(m_supported)
+  {
+    program.create();
+    glProgramParameteri(program.programId(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+}
+
+void ProgramBinaryCache::save(QOpenGLShaderProgram &program, const QByteArray &key)
+{
+  if(!m_supported || !program.isLinked())
+  {
+    return;
+  }
+
+  GLint length = 0;
+  glGetProgramiv(program.programId(), GL_PROGRAM_BINARY_LENGTH, &length);
+  if(length <= 0)
+  {
+    return;
+  }
+  QByteArray binary(length, Qt::Uninitialized);
+  GLenum binaryFormat = 0;
+  glGetProgramBinary(program.programId(), length, nullptr, &binaryFormat, binary.data());
+
+  QDir().mkpath(m_directory);
+  const QString name = fileName(key);
+  QFile file(name + ".tmp");
+  if(!file.open(QIODevice::WriteOnly))
+  {
+    qWarning() << "Unable to write the program binary" << name;
+    return;
+  }
+  QDataStream stream(&file);
+  stream << CacheMagic << quint32(binaryFormat) << binary;
+  file.close();
+
+  // Renamed once complete, a crash never leaves a truncated binary behind
+  QFile::remove(name);
+  QFile::rename(file.fileName(), name);
+}
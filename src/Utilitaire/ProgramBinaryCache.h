@@ -0,0 +1,45 @@
+#ifndef PROGRAMBINARYCACHE_H
+#define PROGRAMBINARYCACHE_H
+
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLShaderProgram>
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+// Stores the linked shader programs on disk with glGetProgramBinary, and restores them with glProgramBinary
+// on the next launch instead of compiling and linking them again.
+// A program is keyed by its fully expanded sources and the vendor, renderer and version strings of the driver,
+// so an edited shader or an updated driver gets a new entry. A binary refused by the driver is ignored and
+// the program is compiled as usual.
+class ProgramBinaryCache : protected QOpenGLExtraFunctions
+{
+  public:
+    explicit ProgramBinaryCache(const QString &directory = "../ShaderCache");
+
+    void initialize(); // Must be called with a current context
+    bool isSupported() const { return m_supported; }
+
+    QByteArray key(const QStringList &sources) const;
+
+    // Link the program from the binary stored for key, returns false if there is none or the driver refuses it
+    bool load(QOpenGLShaderProgram &program, const QByteArray &key);
+    // Must be called before the shaders are linked, so the driver keeps the binary
+    void prepare(QOpenGLShaderProgram &program);
+    // Store the binary of a linked program
+    void save(QOpenGLShaderProgram &program, const QByteArray &key);
+
+    int hits() const { return m_hits; }
+    int misses() const { return m_misses; }
+
+  private:
+    QString fileName(const QByteArray &key) const;
+
+    QString m_directory;
+    QByteArray m_driver; // vendor, renderer and version strings
+    bool m_supported;
+    int m_hits;
+    int m_misses;
+};
+
+#endif // PROGRAMBINARYCACHE_H
@@ -0,0 +1,56 @@
+#include "ProgressiveRefiner.h"
+#include <algorithm>
+
+ProgressiveRefiner::ProgressiveRefiner(int interactiveLayers, float interactiveScale, double frameBudgetMs)
+    : m_interactiveLayers(interactiveLayers)
+    , m_interactiveScale(interactiveScale)
+    , m_frameBudgetMs(frameBudgetMs)
+    , m_interacting(false)
+    , m_cachedLayers(0)
+    , m_cachedScale(1.0f)
+    , m_msPerLayer(2.0)
+{
+}
+
+void ProgressiveRefiner::invalidate()
+{
+    m_cachedLayers = 0;
+}
+
+void ProgressiveRefiner::setInteracting(bool interacting)
+{
+    m_interacting = interacting;
+}
+
+void ProgressiveRefiner::reportFrameTime(double elapsedMs, int layers)
+{
+    if (layers <= 0 || elapsedMs <= 0.0) {
+        return;
+    }
+    const double sample = elapsedMs / layers;
+    m_msPerLayer = 0.7 * m_msPerLayer + 0.3 * sample;
+}
+
+ProgressiveRefiner::Step ProgressiveRefiner::nextStep(int maxLayers)
+{
+    if (m_interacting) {
+        return {0, std::min(m_interactiveLayers, maxLayers), m_interactiveScale, true};
+    }
+
+    // Coarse layers can not be refined, start again at full resolution
+    const int first = m_cachedScale < 1.0f ? 0 : m_cachedLayers;
+    const int affordable = static_cast<int>(m_frameBudgetMs / std::max(m_msPerLayer, 0.01));
+    const int count = std::max(1, std::min(affordable, maxLayers - first));
+    return {first, std::min(first + count, maxLayers), 1.0f, false};
+}
+
+void ProgressiveRefiner::frameDone(const Step &step)
+{
+    m_cachedLayers = step.lastLayer;
+    m_cachedScale = step.renderScale;
+}
+
+bool ProgressiveRefiner::isComplete(int maxLayers) const
+{
+    return !m_interacting && m_cachedScale >= 1.0f && m_cachedLayers >= maxLayers;
+}
@@ -0,0 +1,50 @@
+#ifndef PROGRESSIVEREFINER_H
+#define PROGRESSIVEREFINER_H
+
+// Decides which depth peeling layers are rendered in the current frame.
+// While the user interacts, only a few layers are peeled in a reduced resolution target.
+// Once the interaction stops, the remaining layers are spread over the next frames within a time budget,
+// the layers already peeled stay valid in the textures as long as the camera does not move.
+class ProgressiveRefiner
+{
+  public:
+    // Layers [firstLayer, lastLayer[ are peeled at renderScale * viewport size
+    struct Step
+    {
+      int firstLayer;
+      int lastLayer;
+      float renderScale;
+      bool interactive;
+    };
+
+    ProgressiveRefiner(int interactiveLayers = 4, float interactiveScale = 0.5f, double frameBudgetMs = 12.0);
+
+    void invalidate(); // The camera or the scene changed, the cached layers are stale
+    void setInteracting(bool interacting);
+    bool isInteracting() const { return m_interacting; }
+    void setInteractiveScale(float scale) { m_interactiveScale = scale; }
+
+    // Render time of a refinement frame which peeled layers layers, used to estimate the cost of one layer
+    void reportFrameTime(double elapsedMs, int layers);
+
+    Step nextStep(int maxLayers);
+    void frameDone(const Step &step);
+
+    int cachedLayers() const { return m_cachedLayers; } // number of valid layers to blend
+    float cachedScale() const { return m_cachedScale; }
+    bool isComplete(int maxLayers) const;
+
+  private:
+    int m_interactiveLayers;
+    float m_interactiveScale;
+    double m_frameBudgetMs;
+
+    bool m_interacting;
+    int m_cachedLayers;
+    float m_cachedScale;
+
+    // -- Cost estimation --
+    double m_msPerLayer;
+};
+
+#endif // PROGRESSIVEREFINER_H
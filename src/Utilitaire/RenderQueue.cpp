@@ -0,0 +1,70 @@
+#include "RenderQueue.h"
+#include <algorithm>
+
+RenderQueue::RenderQueue()
+{
+}
+
+void RenderQueue::build(const GLTFLoader &loader, const MaterialLibrary &materials)
+{
+  clear();
+  for(size_t i = 0; i < loader.m_meshes.size(); ++i)
+  {
+    DrawItem item;
+    item.mesh = &loader.m_meshes[i];
+    item.material = materials.materialOf(static_cast<int>(i));
+    item.kind = materials.kindOf(item.material);
+    item.key = (static_cast<quint64>(item.kind) << 32) | static_cast<quint64>(item.material & 0xffffffff);
+    m_items.push_back(item);
+  }
+
+  std::stable_sort(m_items.begin(), m_items.end(), [](const DrawItem &a, const DrawItem &b) { return a.key < b.key; });
+}
+
+void RenderQueue::clear()
+{
+  m_items.clear();
+  m_locations.clear();
+}
+
+const RenderQueue::Locations &RenderQueue::locations(QOpenGLShaderProgram &program)
+{
+  auto it = m_locations.find(program.programId());
+  if(it == m_locations.end())
+  {
+    Locations locations;
+    locations.projection = program.uniformLocation("u_projection");
+    locations.view = program.uniformLocation("u_view");
+    locations.model = program.uniformLocation("u_model");
+    locations.material = program.uniformLocation("u_material");
+    it = m_locations.emplace(program.programId(), locations).first;
+  }
+  return it->second;
+}
+
+void RenderQueue::submit(GLStateCache &cache, GLTFLoader &loader, QOpenGLShaderProgram *const programs[KindCount],
+                         const QMatrix4x4 &projection, const QMatrix4x4 &view, const ProgramSetUp &setUp)
+{
+  QOpenGLShaderProgram *current = nullptr;
+  const Locations *location = nullptr;
+
+  for(const auto& item : m_items)
+  {
+    QOpenGLShaderProgram *program = programs[item.kind];
+    if(program != current)
+    {
+      current = program;
+      location = &locations(*program);
+      cache.bindProgram(*program);
+      cache.setUniform(*program, location->projection, projection);
+      cache.setUniform(*program, location->view, view);
+      setUp(*program);
+    }
+
+    cache.setUniform(*program, location->material, item.material);
+    cache.setUniform(*program, location->model, item.mesh->modelMatrix);
+
+    loader.draw(*item.mesh);
+    cache.countDraw();
+  }
+}
@@ -0,0 +1,61 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <QOpenGLShaderProgram>
+#include <QMatrix4x4>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include "gltfLoader.h"
+#include "GLStateCache.h"
+#include "MaterialLibrary.h"
+
+// Draws the meshes of a GLTFLoader sorted by material kind and material, so that consecutive
+// draws share as much state as possible, and sends the state changes through a GLStateCache.
+// Each kind of material is drawn with its own program, specialized for it, so the program only
+// changes between two kinds. The textures of every material are bound once by the MaterialLibrary,
+// a draw only changes u_material.
+// The queue is sorted once by build(), the meshes are static.
+class RenderQueue
+{
+  public:
+    static const int KindCount = 3; // MaterialLibrary::Kind
+    // Called when the queue switches to a program, to set the uniforms of the pass
+    typedef std::function<void(QOpenGLShaderProgram &)> ProgramSetUp;
+
+    RenderQueue();
+
+    void build(const GLTFLoader &loader, const MaterialLibrary &materials);
+    void clear();
+    void invalidateLocations() { m_locations.clear(); } // after the programs are rebuilt
+    int size() const { return static_cast<int>(m_items.size()); }
+
+    // programs[kind] draws the meshes of that kind of material, they must be linked. loader is the one of build().
+    void submit(GLStateCache &cache, GLTFLoader &loader, QOpenGLShaderProgram *const programs[KindCount],
+                const QMatrix4x4 &projection, const QMatrix4x4 &view, const ProgramSetUp &setUp);
+
+  private:
+    struct DrawItem
+    {
+      quint64 key; // kind | material, most significant first
+      int kind;
+      int material; // index in the MaterialLibrary
+      const GLTFLoader::Mesh *mesh;
+    };
+
+    // Uniform locations of a program, resolved once
+    struct Locations
+    {
+      int projection;
+      int view;
+      int model;
+      int material;
+    };
+
+    const Locations &locations(QOpenGLShaderProgram &program);
+
+    std::vector<DrawItem> m_items;
+    std::unordered_map<GLuint, Locations> m_locations; // by program id
+};
+
+#endif // RENDERQUEUE_H
@@ -0,0 +1,53 @@
+#include "RenderScheduler.h"
+
+RenderScheduler::RenderScheduler(QWidget *target, QObject *parent)
+    : QObject(parent)
+    , m_target(target)
+    , m_mode(Mode::OnDemand)
+    , m_dirtyFlags(Clean)
+    , m_framePending(false)
+{
+}
+
+void RenderScheduler::setMode(Mode mode)
+{
+    m_mode = mode;
+    requestFrame();
+}
+
+void RenderScheduler::toggleMode()
+{
+    setMode(m_mode == Mode::OnDemand ? Mode::Continuous : Mode::OnDemand);
+}
+
+void RenderScheduler::markDirty(int flags)
+{
+    m_dirtyFlags |= flags;
+    requestFrame();
+}
+
+int RenderScheduler::beginFrame()
+{
+    const int flags = m_dirtyFlags;
+    m_dirtyFlags = Clean;
+    m_framePending = false;
+    return flags;
+}
+
+void RenderScheduler::endFrame()
+{
+    // Something may have been marked dirty while rendering, ask for another frame
+    if (m_mode == Mode::Continuous || isDirty()) {
+        requestFrame();
+    }
+}
+
+void RenderScheduler::requestFrame()
+{
+    // Coalesce every request made before the next paintGL into a single update()
+    if (m_framePending) {
+        return;
+    }
+    m_framePending = true;
+    m_target->update();
+}
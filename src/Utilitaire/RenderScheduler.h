@@ -0,0 +1,58 @@
+#ifndef RENDERSCHEDULER_H
+#define RENDERSCHEDULER_H
+
+#include <QObject>
+#include <QWidget>
+
+// Decides when a widget has to be repainted.
+// In OnDemand mode a frame is only requested when something marked it dirty (camera, resize, data),
+// several marks between two frames are merged into a single repaint.
+// In Continuous mode a new frame is requested at the end of every frame, this is the benchmark mode.
+class RenderScheduler : public QObject
+{
+  Q_OBJECT
+
+  public:
+    enum class Mode
+    {
+      OnDemand,
+      Continuous
+    };
+
+    enum DirtyFlag
+    {
+      Clean  = 0,
+      Camera = 1 << 0,
+      Resize = 1 << 1,
+      Data   = 1 << 2,
+      Refine = 1 << 3  // more work is pending on an unchanged frame
+    };
+
+    static const int Invalidating = Camera | Resize | Data; // flags that make the previous frame stale
+
+    explicit RenderScheduler(QWidget *target, QObject *parent = nullptr);
+
+    void setMode(Mode mode);
+    Mode mode() const { return m_mode; }
+    void toggleMode();
+
+    // Mark the frame dirty and request a repaint if none is pending
+    void markDirty(int flags);
+
+    // Called at the beginning of paintGL, returns the accumulated dirty flags and clears them
+    int beginFrame();
+    // Called at the end of paintGL, keeps the loop running in Continuous mode
+    void endFrame();
+
+    bool isDirty() const { return m_dirtyFlags != Clean; }
+
+  private:
+    void requestFrame();
+
+    QWidget *m_target;
+    Mode m_mode;
+    int m_dirtyFlags;
+    bool m_framePending; // an update() has been posted and paintGL has not run yet
+};
+
+#endif // RENDERSCHEDULER_H
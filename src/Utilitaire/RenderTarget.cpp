@@ -0,0 +1,68 @@
+#include "RenderTarget.h"
+#include <QOpenGLContext>
+
+int RenderTargetDesc::bytesPerPixel(QOpenGLTexture::TextureFormat format)
+{
+  switch(format)
+  {
+    case QOpenGLTexture::RGBA32F:
+      return 16;
+    case QOpenGLTexture::RGBA16F:
+    case QOpenGLTexture::D32FS8X24:
+      return 8;
+    case QOpenGLTexture::RGB8_UNorm:
+      return 3;
+    case QOpenGLTexture::R16F:
+    case QOpenGLTexture::D16:
+      return 2;
+    case QOpenGLTexture::R8_UNorm:
+      return 1;
+    default: // RGBA8, D32F, D24S8, R32F...
+      return 4;
+  }
+}
+
+Framebuffer::Framebuffer() : m_handle(0)
+{
+}
+
+Framebuffer::~Framebuffer()
+{
+  // The owner destroys it while its context is current
+}
+
+bool Framebuffer::create()
+{
+  initializeOpenGLFunctions();
+  glGenFramebuffers(1, &m_handle);
+  return m_handle != 0;
+}
+
+void Framebuffer::destroy()
+{
+  if(m_handle != 0)
+  {
+    glDeleteFramebuffers(1, &m_handle);
+    m_handle = 0;
+  }
+}
+
+bool Framebuffer::attach(GLuint colorTexture, GLuint depthTexture)
+{
+  bind();
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+  const bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+  release();
+  return complete;
+}
+
+void Framebuffer::bind()
+{
+  glBindFramebuffer(GL_FRAMEBUFFER, m_handle);
+}
+
+void Framebuffer::release()
+{
+  glBindFramebuffer(GL_FRAMEBUFFER, QOpenGLContext::currentContext()->defaultFramebufferObject());
+}
@@ -0,0 +1,53 @@
+#ifndef RENDERTARGET_H
+#define RENDERTARGET_H
+
+#include <QOpenGLFunctions>
+#include <QOpenGLTexture>
+#include <QSize>
+#include <QString>
+
+// Describes a set of textures rendered into.
+// count textures are allocated, layer i uses the texture i % count, so a count smaller than the
+// number of layers shares the textures between layers (e.g. ping-pong depth buffers).
+// Two descriptions are equal if their textures are interchangeable: same format, count and size.
+struct RenderTargetDesc
+{
+  QString name;
+  QOpenGLTexture::TextureFormat format;
+  int count;
+  QSize size; // of every texture, empty until allocated
+
+  bool operator==(const RenderTargetDesc &other) const
+  {
+    return format == other.format && count == other.count && size == other.size;
+  }
+  bool operator!=(const RenderTargetDesc &other) const { return !(*this == other); }
+
+  static int bytesPerPixel(QOpenGLTexture::TextureFormat format);
+};
+
+// Minimal framebuffer object, unlike QOpenGLFramebufferObject it does not allocate any attachment
+// by itself, only the textures given to attach() are used.
+class Framebuffer : protected QOpenGLFunctions
+{
+  public:
+    Framebuffer();
+    ~Framebuffer();
+
+    bool create(); // Must be called with a current context
+    void destroy();
+
+    // Attach the textures (0 to leave an attachment empty), returns true if the framebuffer is complete
+    bool attach(GLuint colorTexture, GLuint depthTexture);
+
+    void bind();
+    void release(); // Bind back the default framebuffer of the current context
+
+    GLuint handle() const { return m_handle; }
+    bool isCreated() const { return m_handle != 0; }
+
+  private:
+    GLuint m_handle;
+};
+
+#endif // RENDERTARGET_H
@@ -0,0 +1,207 @@
+#include "RenderTargetPool.h"
+#include <QStringList>
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+  const int BucketGranularity = 128; // pixels
+  const float GrowthFactor = 1.5f;
+  const int OversizeRatio = 4;       // allocated area / needed area that triggers a shrink
+}
+
+RenderTargetPool::RenderTargetPool()
+{
+  // count <= 0 means one texture per layer
+  m_descs.push_back({"layer color", QOpenGLTexture::RGBA32F, 0, QSize()});
+  m_descs.push_back({"layer depth", QOpenGLTexture::D32F, 2, QSize()});
+  m_textures.resize(m_descs.size());
+}
+
+RenderTargetPool::~RenderTargetPool()
+{
+}
+
+int RenderTargetPool::bucket(int size)
+{
+  return std::max(1, (size + BucketGranularity - 1) / BucketGranularity) * BucketGranularity;
+}
+
+int RenderTargetPool::textureCount(const RenderTargetDesc &desc, int layers) const
+{
+  return desc.count > 0 ? std::min(desc.count, layers) : layers;
+}
+
+bool RenderTargetPool::covers(int width, int height) const
+{
+  return isAllocated() && width <= m_size.width() && height <= m_size.height();
+}
+
+bool RenderTargetPool::isOversized(int width, int height) const
+{
+  const qint64 needed = static_cast<qint64>(bucket(width)) * bucket(height);
+  const qint64 allocated = static_cast<qint64>(m_size.width()) * m_size.height();
+  return isAllocated() && allocated > OversizeRatio * needed;
+}
+
+bool RenderTargetPool::reserve(int width, int height, int layers)
+{
+  if(covers(width, height) && layerCount() == layers)
+  {
+    return false;
+  }
+
+  // Grow geometrically so that a window being enlarged does not reallocate at each step
+  QSize size(bucket(width), bucket(height));
+  if(isAllocated())
+  {
+    size = size.expandedTo(QSize(bucket(static_cast<int>(m_size.width() * GrowthFactor)),
+                                 bucket(static_cast<int>(m_size.height() * GrowthFactor))));
+    size = size.boundedTo(QSize(std::max(bucket(width), m_size.width() * 2),
+                                std::max(bucket(height), m_size.height() * 2)));
+  }
+  return allocate(size, layers);
+}
+
+bool RenderTargetPool::fit(int width, int height, int layers)
+{
+  const QSize size(bucket(width), bucket(height));
+  if(size == m_size && layerCount() == layers)
+  {
+    return false;
+  }
+  return allocate(size, layers);
+}
+
+QOpenGLTexture *RenderTargetPool::texture(Attachment attachment, int layer) const
+{
+  const std::vector<QOpenGLTexture *> &textures = m_textures[attachment];
+  return textures[layer % textures.size()];
+}
+
+// The textures of a description are kept if it did not change, e.g. when only the number of layers does
+bool RenderTargetPool::allocate(const QSize &size, int layers)
+{
+  releaseFramebuffers();
+  m_size = size;
+
+  for(size_t d = 0; d < m_descs.size(); ++d)
+  {
+    RenderTargetDesc desc = m_descs[d];
+    desc.size = size;
+    std::vector<QOpenGLTexture *> &textures = m_textures[d];
+    if(desc != m_descs[d])
+    {
+      releaseTextures(textures, 0);
+      m_descs[d] = desc;
+    }
+    const int count = textureCount(desc, layers);
+    releaseTextures(textures, count);
+
+    const bool isDepth = d == Depth;
+    for(int i = static_cast<int>(textures.size()); i < count; ++i)
+    {
+      QOpenGLTexture *texture = new QOpenGLTexture(QOpenGLTexture::Target2D);
+      texture->create();
+      texture->setSize(desc.size.width(), desc.size.height());
+      texture->setFormat(desc.format);
+      texture->allocateStorage();
+      // Linear on the colors to upscale the reduced resolution frames
+      texture->setMinificationFilter(isDepth ? QOpenGLTexture::Nearest : QOpenGLTexture::Linear);
+      texture->setMagnificationFilter(isDepth ? QOpenGLTexture::Nearest : QOpenGLTexture::Linear);
+      texture->setWrapMode(QOpenGLTexture::ClampToEdge);
+      textures.push_back(texture);
+    }
+  }
+
+  for(int i = 0; i<layers; ++i)
+  {
+    Framebuffer *fbo = new Framebuffer();
+    if(!fbo->create())
+    {
+      std::cout << "Error: Framebuffer is not valid" << std::endl;
+      delete fbo;
+      release();
+      return false;
+    }
+
+    if(!fbo->attach(colorTexture(i)->textureId(), depthTexture(i)->textureId()))
+    {
+      std::cout << "Error: Framebuffer is not complete" << std::endl;
+      fbo->destroy();
+      delete fbo;
+      release();
+      return false;
+    }
+    m_framebuffers.push_back(fbo);
+  }
+
+  std::cout << memoryReport().toStdString() << std::endl;
+  return true;
+}
+
+void RenderTargetPool::release()
+{
+  releaseFramebuffers();
+  for(size_t d = 0; d < m_descs.size(); ++d)
+  {
+    releaseTextures(m_textures[d], 0);
+    m_descs[d].size = QSize();
+  }
+  m_size = QSize();
+}
+
+void RenderTargetPool::releaseFramebuffers()
+{
+  for(auto fbo : m_framebuffers)
+  {
+    fbo->destroy();
+    delete fbo;
+  }
+  m_framebuffers.clear();
+}
+
+void RenderTargetPool::releaseTextures(std::vector<QOpenGLTexture *> &textures, int kept)
+{
+  while(static_cast<int>(textures.size()) > kept)
+  {
+    textures.back()->destroy();
+    delete textures.back();
+    textures.pop_back();
+  }
+}
+
+qint64 RenderTargetPool::allocatedBytes() const
+{
+  qint64 bytes = 0;
+  for(size_t d = 0; d < m_descs.size(); ++d)
+  {
+    bytes += static_cast<qint64>(m_textures[d].size()) * m_size.width() * m_size.height() *
+             RenderTargetDesc::bytesPerPixel(m_descs[d].format);
+  }
+  return bytes;
+}
+
+QString RenderTargetPool::memoryReport() const
+{
+  if(!isAllocated())
+  {
+    return "Render targets: none";
+  }
+
+  const double mega = 1024.0 * 1024.0;
+  QStringList lines;
+  lines << QString("Render targets %1x%2, %3 layers:").arg(m_size.width()).arg(m_size.height()).arg(layerCount());
+  for(size_t d = 0; d < m_descs.size(); ++d)
+  {
+    const qint64 bytes = static_cast<qint64>(m_textures[d].size()) * m_size.width() * m_size.height() *
+                         RenderTargetDesc::bytesPerPixel(m_descs[d].format);
+    lines << QString("  %1: %2 x %3 bytes/pixel = %4 MB")
+               .arg(m_descs[d].name)
+               .arg(m_textures[d].size())
+               .arg(RenderTargetDesc::bytesPerPixel(m_descs[d].format))
+               .arg(bytes / mega, 0, 'f', 1);
+  }
+  lines << QString("  total: %1 MB").arg(allocatedBytes() / mega, 0, 'f', 1);
+  return lines.join('\n');
+}
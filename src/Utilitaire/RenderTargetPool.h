@@ -0,0 +1,67 @@
+#ifndef RENDERTARGETPOOL_H
+#define RENDERTARGETPOOL_H
+
+#include <QOpenGLTexture>
+#include <QSize>
+#include <vector>
+#include "RenderTarget.h"
+
+// Owns the color textures, depth textures and FBOs of the depth peeling layers.
+// The allocation is only replaced when it does not cover the requested size anymore, it then grows
+// geometrically and is rounded to a bucket so that small resizes reuse the same textures.
+// Rendering into a smaller size is done with a viewport inside the allocated textures.
+// The textures are described by RenderTargetDesc: one color texture per layer, and two depth textures
+// shared by all layers since a layer only reads the depth of the previous one. A reallocation keeps the textures
+// of a description whose format, count and size are unchanged.
+class RenderTargetPool
+{
+  public:
+    enum Attachment
+    {
+      Color = 0,
+      Depth = 1
+    };
+
+    RenderTargetPool();
+    ~RenderTargetPool();
+
+    // Must be called with a current context.
+    // Make sure the targets cover width x height for the given number of layers.
+    // Returns true if the targets were reallocated, their content is then lost.
+    // If the allocation fails the pool is left empty, see isAllocated().
+    bool reserve(int width, int height, int layers);
+    // Reallocate the targets to the bucket of width x height, even if it is smaller
+    bool fit(int width, int height, int layers);
+
+    bool covers(int width, int height) const;
+    bool isOversized(int width, int height) const; // the allocation is much bigger than needed
+    bool isAllocated() const { return !m_framebuffers.empty(); }
+
+    QSize allocatedSize() const { return m_size; }
+    int layerCount() const { return static_cast<int>(m_framebuffers.size()); }
+
+    QOpenGLTexture *texture(Attachment attachment, int layer) const;
+    QOpenGLTexture *colorTexture(int layer) const { return texture(Color, layer); }
+    QOpenGLTexture *depthTexture(int layer) const { return texture(Depth, layer); }
+    Framebuffer *framebuffer(int layer) const { return m_framebuffers[layer]; }
+
+    void release(); // Destroy every texture and FBO
+
+    // Video memory used by the targets, per description
+    qint64 allocatedBytes() const;
+    QString memoryReport() const;
+
+  private:
+    static int bucket(int size); // round a dimension up to the allocation granularity
+    bool allocate(const QSize &size, int layers); // false and empty if a framebuffer is not complete
+    int textureCount(const RenderTargetDesc &desc, int layers) const;
+    void releaseFramebuffers();
+    static void releaseTextures(std::vector<QOpenGLTexture *> &textures, int kept); // destroy the ones after kept
+
+    std::vector<RenderTargetDesc> m_descs; // indexed by Attachment, with the size of their textures
+    std::vector<std::vector<QOpenGLTexture *>> m_textures; // textures of each description
+    std::vector<Framebuffer *> m_framebuffers; // one per layer
+    QSize m_size;
+};
+
+#endif // RENDERTARGETPOOL_H
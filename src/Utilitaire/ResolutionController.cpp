@@ -0,0 +1,36 @@
+#include "ResolutionController.h"
+#include <algorithm>
+#include <cmath>
+
+ResolutionController::ResolutionController(double targetMs, float minScale, float maxScale)
+    : m_targetMs(targetMs)
+    , m_minScale(minScale)
+    , m_maxScale(maxScale)
+    , m_scale(maxScale)
+    , m_lastMs(0.0)
+{
+}
+
+void ResolutionController::reportFrameTime(double milliseconds, float scale)
+{
+    m_lastMs = milliseconds;
+    if (milliseconds <= 0.0 || scale != m_scale) {
+        return;
+    }
+
+    // Dead zone around the target so the resolution does not oscillate
+    const double ratio = m_targetMs / milliseconds;
+    if (ratio > 0.9 && ratio < 1.1) {
+        return;
+    }
+
+    // Damped step towards the ideal scale, quantized to avoid changing the resolution every frame
+    const float ideal = scale * static_cast<float>(std::sqrt(ratio));
+    const float damped = m_scale + 0.5f * (ideal - m_scale);
+    const float step = 0.05f;
+    float quantized = std::round(damped / step) * step;
+    if (quantized == m_scale) {
+        quantized += ideal > m_scale ? step : -step;
+    }
+    m_scale = std::max(m_minScale, std::min(quantized, m_maxScale));
+}
@@ -0,0 +1,31 @@
+#ifndef RESOLUTIONCONTROLLER_H
+#define RESOLUTIONCONTROLLER_H
+
+// Adapts the resolution of the depth peeling targets to keep the frame time close to a target.
+// The cost of a frame is roughly proportional to the number of pixels, so the scale applied to
+// each dimension follows the square root of the ratio between the target and the measured time.
+class ResolutionController
+{
+  public:
+    ResolutionController(double targetMs = 16.6, float minScale = 0.25f, float maxScale = 1.0f);
+
+    void setTargetFrameTime(double milliseconds) { m_targetMs = milliseconds; }
+    double targetFrameTime() const { return m_targetMs; }
+
+    // Frame time of a frame rendered with the given scale. The GPU times arrive a few frames late, a frame
+    // rendered with a scale that has since been replaced is ignored, its reduction is not applied twice.
+    void reportFrameTime(double milliseconds, float scale);
+
+    float scale() const { return m_scale; }
+    double lastFrameTime() const { return m_lastMs; }
+    void reset() { m_scale = m_maxScale; }
+
+  private:
+    double m_targetMs;
+    float m_minScale;
+    float m_maxScale;
+    float m_scale;
+    double m_lastMs;
+};
+
+#endif // RESOLUTIONCONTROLLER_H
@@ -0,0 +1,579 @@
+#include "ScalarSeries.h"
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+static_assert(sizeof(float) == 4, "The series store IEEE 754 single precision floats");
+
+namespace
+{
+  const char Magic[4] = {'S', 'C', 'T', 'S'};
+  const uint16_t Version = 1;
+
+  // IEEE 754 half precision, rounded to the nearest even
+  uint16_t toHalf(float value)
+  {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const uint32_t floatExponent = (bits >> 23) & 0xFF;
+    const int exponent = static_cast<int>(floatExponent) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    if(floatExponent == 0xFF)
+    {
+      return static_cast<uint16_t>(sign | 0x7C00 | (mantissa ? 0x200 : 0)); // infinity or NaN
+    }
+    if(exponent >= 31)
+    {
+      return static_cast<uint16_t>(sign | 0x7C00);
+    }
+    if(exponent <= 0)
+    {
+      // Subnormal half, or zero
+      if(exponent < -10)
+      {
+        return static_cast<uint16_t>(sign);
+      }
+      mantissa |= 0x800000;
+      const int shift = 14 - exponent;
+      uint32_t half = mantissa >> shift;
+      const uint32_t remainder = mantissa & ((1u << shift) - 1);
+      const uint32_t halfway = 1u << (shift - 1);
+      if(remainder > halfway || (remainder == halfway && (half & 1)))
+      {
+        ++half;
+      }
+      return static_cast<uint16_t>(sign | half);
+    }
+
+    uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    const uint32_t remainder = mantissa & 0x1FFF;
+    if(remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+    {
+      ++half; // a carry into the exponent rounds to the next power of two, or to infinity
+    }
+    return static_cast<uint16_t>(sign | half);
+  }
+
+  float fromHalf(uint16_t half)
+  {
+    const uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+    int exponent = (half >> 10) & 0x1F;
+    uint32_t mantissa = half & 0x3FF;
+    uint32_t bits;
+    if(exponent == 0x1F)
+    {
+      bits = sign | 0x7F800000 | (mantissa << 13);
+    }
+    else if(exponent == 0 && mantissa == 0)
+    {
+      bits = sign;
+    }
+    else
+    {
+      if(exponent == 0)
+      {
+        // Subnormal half, normalized for the float
+        exponent = 1;
+        while(!(mantissa & 0x400))
+        {
+          mantissa <<= 1;
+          --exponent;
+        }
+        mantissa &= 0x3FF;
+      }
+      bits = sign | (static_cast<uint32_t>(exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  uint32_t scalarBits(float value, ScalarSeries::Encoding encoding)
+  {
+    if(encoding == ScalarSeries::Float16)
+    {
+      return toHalf(value);
+    }
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+  }
+
+  float scalarValue(uint32_t bits, ScalarSeries::Encoding encoding)
+  {
+    if(encoding == ScalarSeries::Float16)
+    {
+      return fromHalf(static_cast<uint16_t>(bits));
+    }
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  // -- Delta: the difference of the bits with the previous frame, zigzag then varint encoded --
+  void putVarint(std::vector<uchar> &bytes, uint32_t value)
+  {
+    while(value >= 0x80)
+    {
+      bytes.push_back(static_cast<uchar>(value | 0x80));
+      value >>= 7;
+    }
+    bytes.push_back(static_cast<uchar>(value));
+  }
+
+  bool getVarint(const uchar *&bytes, const uchar *end, uint32_t &value)
+  {
+    value = 0;
+    for(int shift = 0; shift < 35 && bytes < end; shift += 7)
+    {
+      const uchar byte = *bytes++;
+      value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+      if(!(byte & 0x80))
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // The differences wrap around on the width of the encoding, so they are exact
+  uint32_t zigzag(uint32_t difference, int bits)
+  {
+    if(bits == 16)
+    {
+      const int16_t signedDifference = static_cast<int16_t>(difference);
+      return static_cast<uint16_t>((signedDifference << 1) ^ (signedDifference >> 15));
+    }
+    const int32_t signedDifference = static_cast<int32_t>(difference);
+    return (static_cast<uint32_t>(signedDifference) << 1) ^ static_cast<uint32_t>(signedDifference >> 31);
+  }
+
+  uint32_t unzigzag(uint32_t value)
+  {
+    return (value >> 1) ^ (0u - (value & 1));
+  }
+}
+
+ScalarSeries::ScalarSeries()
+    : m_data(nullptr)
+    , m_vertexCount(0)
+    , m_frameCount(0)
+    , m_framesPerChunk(1)
+    , m_encoding(Float32)
+    , m_compression(None)
+    , m_hasRange(false)
+    , m_framesPerSecond(0.0f)
+{
+}
+
+ScalarSeries::~ScalarSeries()
+{
+  close();
+}
+
+bool ScalarSeries::open(const QString &fileName, int vertexCount)
+{
+  close();
+  m_file.setFileName(fileName);
+  if(!m_file.open(QIODevice::ReadOnly) || m_file.size() == 0)
+  {
+    qWarning() << "Unable to read" << fileName;
+    return false;
+  }
+  m_data = m_file.map(0, m_file.size());
+  if(!m_data)
+  {
+    qWarning() << "Unable to map" << fileName;
+    m_file.close();
+    return false;
+  }
+
+  const bool isSeries = m_file.size() >= static_cast<qint64>(sizeof(Header)) && std::memcmp(m_data, Magic, sizeof(Magic)) == 0;
+  if(!(isSeries ? openSeries(vertexCount) : openRaw(vertexCount)))
+  {
+    qWarning() << "Unable to open" << fileName;
+    close();
+    return false;
+  }
+  return true;
+}
+
+bool ScalarSeries::openRaw(int vertexCount)
+{
+  const qint64 frameBytes = static_cast<qint64>(vertexCount) * sizeof(float);
+  if(vertexCount <= 0 || m_file.size() % frameBytes != 0)
+  {
+    qWarning() << m_file.fileName() << "is not made of frames of" << vertexCount << "scalars";
+    return false;
+  }
+  m_vertexCount = vertexCount;
+  m_frameCount = static_cast<int>(m_file.size() / frameBytes);
+  m_framesPerChunk = 1;
+  m_encoding = Float32;
+  m_compression = None;
+  m_framesPerSecond = 0.0f;
+  for(int frame = 0; frame < m_frameCount; ++frame)
+  {
+    m_chunks.push_back({static_cast<uint64_t>(frame * frameBytes), static_cast<uint32_t>(frameBytes), static_cast<uint32_t>(frameBytes)});
+  }
+
+  // Without a header the whole file must be read for the range, see scanRange()
+  m_range = QVector2D(0.0f, 1.0f);
+  m_hasRange = false;
+  return true;
+}
+
+QVector2D ScalarSeries::scanRange()
+{
+  if(!m_hasRange && m_data)
+  {
+    m_range = readRange();
+    m_hasRange = true;
+  }
+  return m_range;
+}
+
+// Only the raw layout has no range, it is made of float32 frames
+QVector2D ScalarSeries::readRange() const
+{
+  float minimum = std::numeric_limits<float>::max();
+  float maximum = std::numeric_limits<float>::lowest();
+  const float *scalars = reinterpret_cast<const float *>(m_data);
+  const qint64 count = static_cast<qint64>(m_frameCount) * m_vertexCount;
+  for(qint64 i = 0; i < count; ++i)
+  {
+    minimum = std::min(minimum, scalars[i]);
+    maximum = std::max(maximum, scalars[i]);
+  }
+  return QVector2D(minimum, maximum);
+}
+
+bool ScalarSeries::openSeries(int vertexCount)
+{
+  Header header;
+  std::memcpy(&header, m_data, sizeof(header));
+  if(header.version != Version || header.encoding > Float16 || header.frameCount == 0 || header.vertexCount == 0 ||
+     header.framesPerChunk == 0 || header.frameCount > static_cast<uint32_t>(std::numeric_limits<int>::max()) ||
+     header.vertexCount > static_cast<uint32_t>(std::numeric_limits<int>::max()) ||
+     header.chunkCount != (static_cast<uint64_t>(header.frameCount) + header.framesPerChunk - 1) / header.framesPerChunk)
+  {
+    qWarning() << m_file.fileName() << "has an unknown version or an invalid header";
+    return false;
+  }
+  if(vertexCount > 0 && header.vertexCount != static_cast<uint32_t>(vertexCount))
+  {
+    qWarning() << m_file.fileName() << "has" << header.vertexCount << "scalars per frame, the model has" << vertexCount << "vertices";
+    return false;
+  }
+#ifndef HAVE_ZSTD
+  if(header.compression & Zstd)
+  {
+    qWarning() << m_file.fileName() << "is compressed with zstd, which this build does not support";
+    return false;
+  }
+#endif
+
+  const qint64 indexEnd = sizeof(Header) + static_cast<qint64>(header.chunkCount) * sizeof(ChunkEntry);
+  if(indexEnd > m_file.size())
+  {
+    qWarning() << m_file.fileName() << "is truncated";
+    return false;
+  }
+  m_chunks.resize(header.chunkCount);
+  std::memcpy(m_chunks.data(), m_data + sizeof(Header), m_chunks.size() * sizeof(ChunkEntry));
+
+  // A corrupted index must not make a decode read outside of the file or allocate more than a chunk can hold
+  const uint64_t fileSize = static_cast<uint64_t>(m_file.size());
+  const uint64_t bytesPerScalar = header.encoding == Float16 ? 2 : 4;
+  for(size_t c = 0; c < m_chunks.size(); ++c)
+  {
+    const ChunkEntry &chunk = m_chunks[c];
+    const uint64_t frames = std::min<uint64_t>(header.framesPerChunk, header.frameCount - c * header.framesPerChunk);
+    const uint64_t scalars = frames * header.vertexCount;
+    // Without Delta the scalars are stored as they are, with it each one takes one to five varint bytes
+    const bool rawSizeValid = (header.compression & Delta) ? chunk.rawSize >= scalars && chunk.rawSize <= scalars * 5
+                                                           : chunk.rawSize == scalars * bytesPerScalar;
+    if(chunk.offset < static_cast<uint64_t>(indexEnd) || chunk.offset > fileSize || chunk.size > fileSize - chunk.offset)
+    {
+      qWarning() << m_file.fileName() << "is truncated";
+      return false;
+    }
+    if(!rawSizeValid || (!(header.compression & Zstd) && chunk.size != chunk.rawSize))
+    {
+      qWarning() << "The chunk" << c << "of" << m_file.fileName() << "has an invalid size";
+      return false;
+    }
+  }
+
+  m_vertexCount = static_cast<int>(header.vertexCount);
+  m_frameCount = static_cast<int>(header.frameCount);
+  m_framesPerChunk = static_cast<int>(header.framesPerChunk);
+  m_encoding = static_cast<Encoding>(header.encoding);
+  m_compression = header.compression;
+  m_range = QVector2D(header.rangeMin, header.rangeMax);
+  m_hasRange = true;
+  m_framesPerSecond = header.framesPerSecond;
+  return true;
+}
+
+void ScalarSeries::close()
+{
+  if(m_data)
+  {
+    m_file.unmap(const_cast<uchar *>(m_data));
+    m_data = nullptr;
+  }
+  m_file.close();
+  m_chunks.clear();
+  m_vertexCount = 0;
+  m_frameCount = 0;
+  m_hasRange = false;
+}
+
+int ScalarSeries::framesIn(int chunk) const
+{
+  return std::min(m_framesPerChunk, m_frameCount - chunk * m_framesPerChunk);
+}
+
+bool ScalarSeries::decodeChunk(int chunk, std::vector<float> &scalars) const
+{
+  if(!m_data || chunk < 0 || chunk >= chunkCount())
+  {
+    return false;
+  }
+  const ChunkEntry &entry = m_chunks[chunk];
+  const size_t count = static_cast<size_t>(framesIn(chunk)) * m_vertexCount;
+  scalars.resize(count);
+
+  const uchar *bytes = m_data + entry.offset;
+  size_t size = entry.size;
+#ifdef HAVE_ZSTD
+  std::vector<uchar> inflated;
+  if(m_compression & Zstd)
+  {
+    inflated.resize(entry.rawSize);
+    const size_t inflatedSize = ZSTD_decompress(inflated.data(), inflated.size(), bytes, size);
+    if(ZSTD_isError(inflatedSize) || inflatedSize != entry.rawSize)
+    {
+      qWarning() << "The chunk" << chunk << "of" << m_file.fileName() << "is corrupted";
+      return false;
+    }
+    bytes = inflated.data();
+    size = inflatedSize;
+  }
+#endif
+
+  if(!(m_compression & Delta))
+  {
+    if(size < count * scalarBytes())
+    {
+      return false;
+    }
+    if(m_encoding == Float32)
+    {
+      std::memcpy(scalars.data(), bytes, count * sizeof(float));
+    }
+    else
+    {
+      for(size_t i = 0; i < count; ++i)
+      {
+        uint16_t half;
+        std::memcpy(&half, bytes + i * 2, sizeof(half));
+        scalars[i] = fromHalf(half);
+      }
+    }
+    return true;
+  }
+
+  // Each frame adds its differences to the bits of the previous one
+  const uchar *end = bytes + size;
+  const uint32_t mask = m_encoding == Float16 ? 0xFFFF : 0xFFFFFFFF;
+  std::vector<uint32_t> previous(m_vertexCount, 0);
+  for(size_t i = 0; i < count; ++i)
+  {
+    uint32_t value;
+    if(!getVarint(bytes, end, value))
+    {
+      qWarning() << "The chunk" << chunk << "of" << m_file.fileName() << "is corrupted";
+      return false;
+    }
+    uint32_t &bits = previous[i % m_vertexCount];
+    bits = (bits + unzigzag(value)) & mask;
+    scalars[i] = scalarValue(bits, m_encoding);
+  }
+  return true;
+}
+
+bool ScalarSeries::readFrame(int frame, float *scalars) const
+{
+  if(!m_data || frame < 0 || frame >= m_frameCount)
+  {
+    return false;
+  }
+  const int chunk = chunkOf(frame);
+  const size_t firstScalar = static_cast<size_t>(frame - chunk * m_framesPerChunk) * m_vertexCount;
+
+  if(isRandomAccess())
+  {
+    const uchar *bytes = m_data + m_chunks[chunk].offset + firstScalar * scalarBytes();
+    if(m_encoding == Float32)
+    {
+      std::memcpy(scalars, bytes, m_vertexCount * sizeof(float));
+    }
+    else
+    {
+      for(int i = 0; i < m_vertexCount; ++i)
+      {
+        uint16_t half;
+        std::memcpy(&half, bytes + i * 2, sizeof(half));
+        scalars[i] = fromHalf(half);
+      }
+    }
+    return true;
+  }
+
+  std::vector<float> decoded;
+  if(!decodeChunk(chunk, decoded))
+  {
+    return false;
+  }
+  std::copy(decoded.begin() + firstScalar, decoded.begin() + firstScalar + m_vertexCount, scalars);
+  return true;
+}
+
+void ScalarSeries::prefetch(int chunk) const
+{
+#ifdef Q_OS_UNIX
+  if(!m_data || chunk < 0 || chunk >= chunkCount())
+  {
+    return;
+  }
+  // madvise wants a page aligned address
+  const uintptr_t pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+  const uintptr_t begin = reinterpret_cast<uintptr_t>(m_data + m_chunks[chunk].offset) & ~(pageSize - 1);
+  const uintptr_t end = reinterpret_cast<uintptr_t>(m_data + m_chunks[chunk].offset + m_chunks[chunk].size);
+  posix_madvise(reinterpret_cast<void *>(begin), end - begin, POSIX_MADV_WILLNEED);
+#else
+  Q_UNUSED(chunk);
+#endif
+}
+
+bool ScalarSeries::write(const QString &fileName, const ScalarSeries &source, const Options &options)
+{
+  if(!source.isOpen())
+  {
+    return false;
+  }
+  int compression = options.compression;
+#ifndef HAVE_ZSTD
+  if(compression & Zstd)
+  {
+    qWarning() << "This build does not support zstd, the chunks are not compressed with it";
+    compression &= ~Zstd;
+  }
+#endif
+
+  QFile file(fileName);
+  if(!file.open(QIODevice::WriteOnly))
+  {
+    qWarning() << "Unable to write" << fileName;
+    return false;
+  }
+
+  const int vertexCount = source.vertexCount();
+  const int framesPerChunk = std::max(1, options.framesPerChunk);
+  const int chunkCount = (source.frameCount() + framesPerChunk - 1) / framesPerChunk;
+
+  Header header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, Magic, sizeof(Magic));
+  header.version = Version;
+  header.encoding = static_cast<uint8_t>(options.encoding);
+  header.compression = static_cast<uint8_t>(compression);
+  header.vertexCount = static_cast<uint32_t>(vertexCount);
+  header.frameCount = static_cast<uint32_t>(source.frameCount());
+  header.framesPerChunk = static_cast<uint32_t>(framesPerChunk);
+  header.chunkCount = static_cast<uint32_t>(chunkCount);
+  const QVector2D range = source.hasRange() ? source.range() : source.readRange();
+  header.rangeMin = range.x();
+  header.rangeMax = range.y();
+  header.framesPerSecond = options.framesPerSecond;
+
+  // The index is written once the sizes of the chunks are known
+  std::vector<ChunkEntry> index(chunkCount);
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(index.data()), index.size() * sizeof(ChunkEntry));
+
+  std::vector<float> frame(vertexCount);
+  std::vector<uint32_t> previous(vertexCount);
+  std::vector<uchar> bytes;
+  for(int chunk = 0; chunk < chunkCount; ++chunk)
+  {
+    const int firstFrame = chunk * framesPerChunk;
+    const int frames = std::min(framesPerChunk, source.frameCount() - firstFrame);
+    bytes.clear();
+    std::fill(previous.begin(), previous.end(), 0);
+    for(int f = firstFrame; f < firstFrame + frames; ++f)
+    {
+      if(!source.readFrame(f, frame.data()))
+      {
+        return false;
+      }
+      for(int v = 0; v < vertexCount; ++v)
+      {
+        const uint32_t bits = scalarBits(frame[v], options.encoding);
+        if(compression & Delta)
+        {
+          putVarint(bytes, zigzag(bits - previous[v], options.encoding == Float16 ? 16 : 32));
+          previous[v] = bits;
+        }
+        else if(options.encoding == Float16)
+        {
+          const uint16_t half = static_cast<uint16_t>(bits);
+          bytes.insert(bytes.end(), reinterpret_cast<const uchar *>(&half), reinterpret_cast<const uchar *>(&half) + 2);
+        }
+        else
+        {
+          bytes.insert(bytes.end(), reinterpret_cast<const uchar *>(&bits), reinterpret_cast<const uchar *>(&bits) + 4);
+        }
+      }
+    }
+
+    index[chunk].offset = static_cast<uint64_t>(file.pos());
+    index[chunk].rawSize = static_cast<uint32_t>(bytes.size());
+#ifdef HAVE_ZSTD
+    if(compression & Zstd)
+    {
+      std::vector<uchar> compressed(ZSTD_compressBound(bytes.size()));
+      const size_t compressedSize = ZSTD_compress(compressed.data(), compressed.size(), bytes.data(), bytes.size(), 3);
+      if(ZSTD_isError(compressedSize))
+      {
+        qWarning() << "zstd failed:" << ZSTD_getErrorName(compressedSize);
+        return false;
+      }
+      compressed.resize(compressedSize);
+      bytes.swap(compressed);
+    }
+#endif
+    index[chunk].size = static_cast<uint32_t>(bytes.size());
+    if(file.write(reinterpret_cast<const char *>(bytes.data()), bytes.size()) != static_cast<qint64>(bytes.size()))
+    {
+      qWarning() << "Unable to write" << fileName;
+      return false;
+    }
+  }
+
+  file.seek(sizeof(Header));
+  file.write(reinterpret_cast<const char *>(index.data()), index.size() * sizeof(ChunkEntry));
+  return true;
+}
@@ -0,0 +1,127 @@
+#ifndef SCALARSERIES_H
+#define SCALARSERIES_H
+
+#include <QFile>
+#include <QString>
+#include <QVector2D>
+#include <cstdint>
+#include <vector>
+
+// A time series of per-vertex scalars (e.g. fMRI activation), memory-mapped: the pages of a frame are only read from
+// the disk when the frame is decoded, so a series does not have to fit in memory.
+//
+// Two layouts are read:
+// - raw: frames of vertexCount 32 bits floats one after the other, like the subject files of SubjectInstances
+// - the series format written by write(), little-endian:
+//     Header (64 bytes)
+//     ChunkEntry[chunkCount]: where each chunk is and its size before zstd
+//     chunks of framesPerChunk frames (fewer for the last one)
+//   The scalars of a chunk are float32 or float16, frame after frame. With Delta, each scalar is stored as the
+//   difference of its bits with the same vertex in the previous frame of the chunk (0 for the first one), zigzag
+//   and varint encoded: slowly varying values take one or two bytes. With Zstd (needs HAVE_ZSTD), the chunk is
+//   then compressed with zstd.
+//   A frame is found in O(1) through the chunk index, and decoded with at most the frames before it in its chunk.
+class ScalarSeries
+{
+  public:
+    enum Encoding
+    {
+      Float32 = 0,
+      Float16 = 1
+    };
+
+    enum Compression
+    {
+      None  = 0,
+      Delta = 1 << 0,
+      Zstd  = 1 << 1
+    };
+
+    struct Options
+    {
+      Encoding encoding = Float16;
+      int compression = Delta; // Compression flags
+      int framesPerChunk = 16;
+      float framesPerSecond = 30.0f;
+    };
+
+    ScalarSeries();
+    ~ScalarSeries();
+
+    // vertexCount is required by the raw layout, it is checked against the header of the series format (0 to skip)
+    bool open(const QString &fileName, int vertexCount = 0);
+    void close();
+    bool isOpen() const { return m_data != nullptr; }
+
+    int frameCount() const { return m_frameCount; }
+    int vertexCount() const { return m_vertexCount; }
+    // Of every frame, stored in the header of the series format. A raw file does not store it, hasRange() is false
+    // until scanRange() has read the whole file.
+    QVector2D range() const { return m_range; }
+    bool hasRange() const { return m_hasRange; }
+    QVector2D scanRange(); // not from the GUI thread, the pages of every frame are read
+    float framesPerSecond() const { return m_framesPerSecond; } // 0 if the file does not tell
+
+    // -- Any thread may call these while the series is open --
+    int chunkCount() const { return static_cast<int>(m_chunks.size()); }
+    int framesPerChunk() const { return m_framesPerChunk; }
+    int chunkOf(int frame) const { return frame / m_framesPerChunk; }
+    int framesIn(int chunk) const;
+    // The frames of a chunk are decoded together, unless the series is not compressed
+    bool isRandomAccess() const { return m_compression == None; }
+
+    // Decode the framesIn(chunk) frames of a chunk, frame after frame
+    bool decodeChunk(int chunk, std::vector<float> &scalars) const;
+    // Decode a frame, a compressed series decodes its chunk
+    bool readFrame(int frame, float *scalars) const;
+    // Ask the system to read the pages of a chunk ahead of time
+    void prefetch(int chunk) const;
+
+    // Write source, opened, in the series format
+    static bool write(const QString &fileName, const ScalarSeries &source, const Options &options);
+
+  private:
+#pragma pack(push, 1)
+    struct Header
+    {
+      char magic[4]; // "SCTS"
+      uint16_t version;
+      uint8_t encoding;
+      uint8_t compression;
+      uint32_t vertexCount;
+      uint32_t frameCount;
+      uint32_t framesPerChunk;
+      uint32_t chunkCount;
+      float rangeMin;
+      float rangeMax;
+      float framesPerSecond;
+      uint8_t reserved[28];
+    };
+
+    struct ChunkEntry
+    {
+      uint64_t offset; // from the start of the file
+      uint32_t size;   // stored bytes
+      uint32_t rawSize; // bytes before zstd
+    };
+#pragma pack(pop)
+
+    bool openRaw(int vertexCount);
+    bool openSeries(int vertexCount);
+    int scalarBytes() const { return m_encoding == Float16 ? 2 : 4; }
+    QVector2D readRange() const; // of a raw file
+
+    QFile m_file;
+    const uchar *m_data;
+    int m_vertexCount;
+    int m_frameCount;
+    int m_framesPerChunk;
+    Encoding m_encoding;
+    int m_compression;
+    QVector2D m_range;
+    bool m_hasRange;
+    float m_framesPerSecond;
+    std::vector<ChunkEntry> m_chunks;
+};
+
+#endif // SCALARSERIES_H
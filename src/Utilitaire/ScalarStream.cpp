@@ -0,0 +1,338 @@
+#include "ScalarStream.h"
+#include <QOpenGLContext>
+#include <QDebug>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+namespace
+{
+  typedef void (QOPENGLF_APIENTRYP BufferStorage)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+}
+
+ScalarStream::ScalarStream()
+    : m_stopping(false)
+    , m_paused(false)
+    , m_seek(-1)
+    , m_frame(0)
+    , m_back(0)
+    , m_front(1)
+    , m_middle(2)
+    , m_buffer(0)
+    , m_regionBytes(0)
+    , m_mapped(nullptr)
+    , m_fences{nullptr, nullptr, nullptr}
+    , m_region(-1)
+    , m_stalls(0)
+{
+}
+
+ScalarStream::~ScalarStream()
+{
+  // The owner calls stop() while its context is current
+}
+
+bool ScalarStream::start(const QString &fileName, int vertexCount, double framesPerSecond, const std::function<void()> &onFrame)
+{
+  stop();
+  if(!m_series.open(fileName, vertexCount))
+  {
+    return false;
+  }
+  for(auto &frame : m_frames)
+  {
+    frame.assign(vertexCount, 0.0f);
+  }
+  m_back = 0;
+  m_front = 1;
+  m_middle.store(2, std::memory_order_relaxed);
+  m_frame.store(0, std::memory_order_relaxed);
+  m_current.index = -1;
+  m_ahead.index = -1;
+  m_range = m_series.range(); // the producer is not running
+  if(framesPerSecond <= 0.0)
+  {
+    framesPerSecond = m_series.framesPerSecond() > 0.0f ? m_series.framesPerSecond() : 30.0;
+  }
+
+  initializeOpenGLFunctions();
+  QOpenGLContext *context = QOpenGLContext::currentContext();
+  m_regionBytes = static_cast<GLsizeiptr>(vertexCount) * sizeof(float);
+  glGenBuffers(1, &m_buffer);
+  glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+
+  BufferStorage bufferStorage = nullptr;
+  if(context->format().version() >= qMakePair(4, 4) || context->hasExtension("GL_ARB_buffer_storage"))
+  {
+    bufferStorage = reinterpret_cast<BufferStorage>(context->getProcAddress("glBufferStorage"));
+  }
+  if(bufferStorage)
+  {
+    // Coherent, the writes are seen by the draws issued after them without an explicit flush
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    bufferStorage(GL_ARRAY_BUFFER, RegionCount * m_regionBytes, nullptr, flags);
+    m_mapped = static_cast<char *>(glMapBufferRange(GL_ARRAY_BUFFER, 0, RegionCount * m_regionBytes, flags));
+  }
+  if(!m_mapped)
+  {
+    std::cout << "No persistent mapping, the scalars are uploaded with glBufferSubData" << std::endl;
+    glBufferData(GL_ARRAY_BUFFER, m_regionBytes, nullptr, GL_STREAM_DRAW);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = false;
+    m_paused = false;
+    m_seek = -1;
+  }
+  m_producer = std::thread(&ScalarStream::produce, this, framesPerSecond, onFrame);
+  return true;
+}
+
+void ScalarStream::stop()
+{
+  if(m_producer.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stopping = true;
+    }
+    m_wakeUp.notify_one();
+    m_producer.join();
+  }
+
+  if(m_buffer != 0)
+  {
+    for(GLsync &fence : m_fences)
+    {
+      if(fence)
+      {
+        glDeleteSync(fence);
+        fence = nullptr;
+      }
+    }
+    if(m_mapped)
+    {
+      glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+      glUnmapBuffer(GL_ARRAY_BUFFER);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+      m_mapped = nullptr;
+    }
+    glDeleteBuffers(1, &m_buffer);
+    m_buffer = 0;
+  }
+  m_series.close();
+  m_current = DecodedChunk();
+  m_ahead = DecodedChunk();
+  m_region = -1;
+  m_stalls = 0;
+}
+
+void ScalarStream::seek(int frame)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(!m_producer.joinable())
+    {
+      return;
+    }
+    const int frameCount = m_series.frameCount();
+    m_seek = ((frame % frameCount) + frameCount) % frameCount;
+  }
+  m_wakeUp.notify_one();
+}
+
+void ScalarStream::setPaused(bool paused)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_paused = paused;
+  }
+  m_wakeUp.notify_one();
+}
+
+bool ScalarStream::isPaused() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_paused;
+}
+
+QVector2D ScalarStream::range() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_range;
+}
+
+// Plays the series in a loop, a frame is read when it is due whether the previous one was taken or not
+void ScalarStream::produce(double framesPerSecond, std::function<void()> onFrame)
+{
+  typedef std::chrono::steady_clock Clock;
+  const auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / std::max(framesPerSecond, 0.1)));
+  int frame = 0;
+
+  // The colors of the frames use the same range, a raw series is read whole once for it
+  std::unique_lock<std::mutex> lock(m_mutex, std::defer_lock);
+  if(!m_series.hasRange())
+  {
+    const QVector2D range = m_series.scanRange();
+    lock.lock();
+    m_range = range;
+  }
+  else
+  {
+    lock.lock();
+  }
+  auto due = Clock::now();
+  bool show = true; // the first frame, even if paused
+  while(!m_stopping)
+  {
+    if(m_seek >= 0)
+    {
+      frame = m_seek;
+      m_seek = -1;
+      show = true;
+    }
+    if(show)
+    {
+      lock.unlock();
+      readFrame(frame);
+      m_back = m_middle.exchange(m_back | Fresh, std::memory_order_acq_rel) & ~Fresh;
+      if(onFrame)
+      {
+        onFrame();
+      }
+      readAhead(frame);
+      lock.lock();
+      frame = (frame + 1) % m_series.frameCount();
+      // A late frame moves the next ones rather than being caught up with
+      due = std::max(due + period, Clock::now());
+    }
+
+    if(m_paused)
+    {
+      m_wakeUp.wait(lock, [this]() { return m_stopping || m_seek >= 0 || !m_paused; });
+      due = Clock::now();
+      show = !m_paused;
+    }
+    else
+    {
+      m_wakeUp.wait_until(lock, due, [this]() { return m_stopping || m_seek >= 0 || m_paused; });
+      show = !m_paused;
+    }
+  }
+}
+
+void ScalarStream::readFrame(int frame)
+{
+  float *scalars = m_frames[m_back].data();
+  if(m_series.isRandomAccess())
+  {
+    m_series.readFrame(frame, scalars);
+  }
+  else
+  {
+    const int chunk = m_series.chunkOf(frame);
+    if(m_current.index != chunk)
+    {
+      if(m_ahead.index == chunk)
+      {
+        std::swap(m_current, m_ahead);
+      }
+      else
+      {
+        // A seek, or the playback outran the read-ahead
+        m_current.index = m_series.decodeChunk(chunk, m_current.scalars) ? chunk : -1;
+      }
+    }
+    if(m_current.index == chunk)
+    {
+      const size_t first = static_cast<size_t>(frame - chunk * m_series.framesPerChunk()) * m_series.vertexCount();
+      std::copy(m_current.scalars.begin() + first, m_current.scalars.begin() + first + m_series.vertexCount(), scalars);
+    }
+  }
+  m_frame.store(frame, std::memory_order_relaxed);
+}
+
+// The next chunk is decoded as soon as the playback enters a chunk, it has the frames of the whole chunk to be ready
+void ScalarStream::readAhead(int frame)
+{
+  const int next = (m_series.chunkOf(frame) + 1) % m_series.chunkCount();
+  if(m_series.isRandomAccess())
+  {
+    m_series.prefetch(next);
+  }
+  else if(next != m_current.index && next != m_ahead.index)
+  {
+    m_ahead.index = m_series.decodeChunk(next, m_ahead.scalars) ? next : -1;
+  }
+}
+
+qint64 ScalarStream::update()
+{
+  if(m_buffer == 0 || !(m_middle.load(std::memory_order_acquire) & Fresh))
+  {
+    return 0;
+  }
+  m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & ~Fresh;
+  const float *scalars = m_frames[m_front].data();
+
+  if(!m_mapped)
+  {
+    // Orphaning gives a new storage to the buffer, the draws still reading the previous one are not waited for
+    glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+    glBufferData(GL_ARRAY_BUFFER, m_regionBytes, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, m_regionBytes, scalars);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    m_region = 0;
+    return m_regionBytes;
+  }
+
+  // Every command issued since the previous update may read the current region
+  if(m_region >= 0)
+  {
+    m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  }
+  const int next = (m_region + 1) % RegionCount;
+  if(m_fences[next])
+  {
+    // Only waits if the GPU is more than RegionCount - 1 frames of scalars behind
+    GLenum status = glClientWaitSync(m_fences[next], 0, 0);
+    if(status == GL_TIMEOUT_EXPIRED)
+    {
+      ++m_stalls;
+      status = glClientWaitSync(m_fences[next], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000); // 1 s
+    }
+    if(status == GL_WAIT_FAILED)
+    {
+      qWarning() << "The fence of the scalar region" << next << "failed";
+    }
+    glDeleteSync(m_fences[next]);
+    m_fences[next] = nullptr;
+  }
+  std::memcpy(m_mapped + regionOffset(next), scalars, m_regionBytes);
+  m_region = next;
+  return m_regionBytes;
+}
+
+void ScalarStream::bind(GLuint location, int firstVertex)
+{
+  const GLintptr offset = regionOffset(m_mapped ? m_region : 0) + static_cast<GLintptr>(firstVertex) * sizeof(float);
+  glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+  glVertexAttribPointer(location, 1, GL_FLOAT, GL_FALSE, sizeof(float), reinterpret_cast<const void *>(offset));
+  glEnableVertexAttribArray(location);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ScalarStream::release(GLuint location)
+{
+  glDisableVertexAttribArray(location);
+}
@@ -0,0 +1,99 @@
+#ifndef SCALARSTREAM_H
+#define SCALARSTREAM_H
+
+#include <QOpenGLExtraFunctions>
+#include <QString>
+#include <QVector2D>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ScalarSeries.h"
+
+// Plays a ScalarSeries as a vertex attribute, one scalar per vertex of the model, without touching its vertex buffers.
+// A producer thread reads the frames at the rate of the series into a lock-free CPU triple buffer, where the newest
+// frame replaces the one the render thread has not taken yet. The render thread copies it into a buffer mapped once
+// with GL_MAP_PERSISTENT_BIT, split in RegionCount regions used in turn: a fence is inserted when the draws move to
+// the next region, so a region is only written once the GPU is done with it, and a frame only costs the copy of its
+// scalars. Without GL_ARB_buffer_storage the buffer is orphaned and refilled with glBufferSubData instead.
+// The producer decodes the chunks of a compressed series whole and keeps the current one, and decodes the next one
+// ahead of time so the frame at a chunk boundary is not late; an uncompressed series only has its next pages prefetched.
+class ScalarStream : protected QOpenGLExtraFunctions
+{
+  public:
+    static const int RegionCount = 3;
+
+    ScalarStream();
+    ~ScalarStream();
+
+    // Must be called with a current context. onFrame is called by the producer thread when a new frame is ready.
+    bool start(const QString &fileName, int vertexCount, double framesPerSecond, const std::function<void()> &onFrame);
+    void stop(); // with the context current
+    bool isPlaying() const { return m_producer.joinable(); }
+    bool isPersistent() const { return m_mapped != nullptr; }
+    // A raw series has its range once the producer read the whole file, before its first frame
+    QVector2D range() const;
+    int frameCount() const { return m_series.frameCount(); }
+
+    // -- Any thread --
+    // Jump to a frame, shown even while paused. Only its chunk is decoded.
+    void seek(int frame);
+    void setPaused(bool paused);
+    bool isPaused() const;
+    int frame() const { return m_frame.load(std::memory_order_relaxed); } // last frame read
+
+    // -- Render thread --
+    // Upload the newest frame if there is one, returns the uploaded bytes (0 if the frame did not change)
+    qint64 update();
+    bool hasFrame() const { return m_region >= 0; }
+    // Point the attribute at location to the scalars of the current frame, from the vertex firstVertex
+    void bind(GLuint location, int firstVertex);
+    void release(GLuint location);
+    int stallCount() const { return m_stalls; } // updates that waited for the GPU
+
+  private:
+    static const int Fresh = 4; // in m_middle, the frame has not been taken by the render thread
+
+    struct DecodedChunk
+    {
+      int index = -1;
+      std::vector<float> scalars;
+    };
+
+    void produce(double framesPerSecond, std::function<void()> onFrame);
+    void readFrame(int frame); // into m_frames[m_back]
+    void readAhead(int frame); // after the frame was handed over
+    GLintptr regionOffset(int region) const { return region * m_regionBytes; }
+
+    ScalarSeries m_series;
+
+    // -- Producer thread --
+    std::thread m_producer;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    bool m_stopping; // guarded by m_mutex
+    bool m_paused;   // guarded by m_mutex
+    int m_seek;      // guarded by m_mutex, -1 if none
+    QVector2D m_range; // guarded by m_mutex
+    std::atomic<int> m_frame;
+    DecodedChunk m_current; // compressed series only
+    DecodedChunk m_ahead;
+
+    // -- Triple buffer: the producer writes m_frames[m_back], the render thread reads m_frames[m_front] --
+    std::vector<float> m_frames[3];
+    int m_back;
+    int m_front;
+    std::atomic<int> m_middle; // index of the third frame, | Fresh when it is newer than m_front
+
+    // -- GL buffer --
+    GLuint m_buffer;
+    GLsizeiptr m_regionBytes;
+    char *m_mapped; // persistent mapping of the RegionCount regions, nullptr without buffer storage
+    GLsync m_fences[RegionCount];
+    int m_region; // read by the draws, -1 before the first frame
+    int m_stalls;
+};
+
+#endif // SCALARSTREAM_H
@@ -0,0 +1,68 @@
+#ifndef SCENEDATA_H
+#define SCENEDATA_H
+
+#include <QMatrix4x4>
+#include <QVector2D>
+#include <QVector3D>
+#include <cstdint>
+#include <vector>
+
+// CPU side of a loaded glTF scene, without any OpenGL object: it is filled by SceneImporter on any thread,
+// and GLTFLoader::upload creates the buffers and textures from it.
+// Everything lives in flat arrays, the meshes refer to ranges of them by index.
+struct SceneData
+{
+  // Interleaved layout of the vertex buffers
+  struct Vertex
+  {
+    QVector3D position;
+    QVector3D normal;
+    QVector3D color;
+    QVector2D texCoords;
+  };
+
+  // Decoded RGBA8 pixels, a height of 1 is a colormap
+  struct Image
+  {
+    int width;
+    int height;
+    std::vector<unsigned char> pixels;
+  };
+
+  struct Material
+  {
+    int baseColorImage; // index in images, -1 without texture
+  };
+
+  // One primitive of the glTF file
+  struct Mesh
+  {
+    int firstVertex;
+    int vertexCount;
+    int firstIndex;
+    int indexCount;
+    bool shortIndices;  // the file stores them on 16 bits, so does the index buffer
+    int material;       // index in materials, -1 when the colors come from the vertices
+    int transform;      // index in transforms
+    float boundingRadius; // of the centered vertices
+  };
+
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices; // relative to the first vertex of their mesh
+  std::vector<Mesh> meshes;
+  std::vector<Material> materials;
+  std::vector<Image> images;
+  std::vector<QMatrix4x4> transforms;
+
+  size_t byteSize() const
+  {
+    size_t bytes = vertices.size() * sizeof(Vertex) + indices.size() * sizeof(uint32_t);
+    for(const auto &image : images)
+    {
+      bytes += image.pixels.size();
+    }
+    return bytes;
+  }
+};
+
+#endif // SCENEDATA_H
@@ -0,0 +1,482 @@
+#include <cstddef>
+#include <sys/types.h>
+#define TINYGLTF_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "SceneImporter.h"
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <webp/decode.h>
+#include <QDateTime>
+#include <QDebug>
+#include <QFileInfo>
+#include <algorithm>
+
+bool LoadWebPOrDefaultImage(tinygltf::Image* image, int image_idx, std::string* err, std::string* warn,
+                    int req_width, int req_height, const unsigned char* data, int size, void* user_data) {
+        // Vérifier si c'est un WebP
+    if (WebPGetInfo(data, size, nullptr, nullptr)) {
+        WebPDecoderConfig config;
+        if (!WebPInitDecoderConfig(&config)) {
+            if (err) *err = "Failed to init WebP config";
+            return false;
+        }
+
+        // Vérifier les features de l'image
+        if (WebPGetFeatures(data, size, &config.input) != VP8_STATUS_OK) {
+            if (err) *err = "Failed to get WebP features";
+            return false;
+        }
+
+        // Configurer le décodeur
+        config.options.use_threads = 1;  // Utiliser le multi-threading
+        config.output.colorspace = MODE_RGBA;
+        
+        // Allouer le buffer
+        std::vector<uint8_t> output_buffer(
+            config.input.width * config.input.height * 4);
+        config.output.u.RGBA.rgba = output_buffer.data();
+        config.output.u.RGBA.stride = config.input.width * 4;
+        config.output.u.RGBA.size = output_buffer.size();
+
+        // Décoder
+        if (WebPDecode(data, size, &config) != VP8_STATUS_OK) {
+            if (err) *err = "Failed to decode WebP";
+            return false;
+        }
+
+        // Remplir l'image
+        image->width = config.input.width;
+        image->height = config.input.height;
+        image->component = 4;
+        image->image = std::move(output_buffer);
+
+        WebPFreeDecBuffer(&config.output);
+        return true;
+    }
+
+    // Sinon utiliser le chargeur par défaut
+    return tinygltf::LoadImageData(image, image_idx, err, warn, 
+                                 req_width, req_height, data, size, user_data);
+}
+
+bool SceneImporter::import(const QString &fileName, SceneData &scene)
+{
+    tinygltf::TinyGLTF loader;
+    tinygltf::Model model;
+    std::string err;
+    std::string warn;
+
+    loader.SetImageLoader(LoadWebPOrDefaultImage, nullptr);
+
+    // glTF files can be either binary (.glb) or ASCII (.gltf), so we need to check the file extension
+    bool ret = fileName.endsWith(".glb") ?
+      loader.LoadBinaryFromFile(&model, &err, &warn, fileName.toStdString()) :
+      loader.LoadASCIIFromFile(&model, &err, &warn, fileName.toStdString());
+
+    if (!warn.empty()) {
+        qDebug() << "GLTF Warning: " << QString::fromStdString(warn);
+    }
+
+    if (!err.empty()) {
+        qDebug() << "GLTF Error: " << QString::fromStdString(err);
+    }
+
+    if (!ret) {
+        qDebug() << "Failed to load glTF file";
+        return false;
+    }
+
+    return import(model, scene);
+}
+
+bool SceneImporter::import(const tinygltf::Model &model, SceneData &scene)
+{
+  scene = SceneData();
+
+  for(const auto &image : model.images)
+  {
+    scene.images.push_back({image.width, image.height, image.image});
+  }
+
+  for(const auto &material : model.materials)
+  {
+    int imageIndex = -1;
+    const int textureIndex = material.pbrMetallicRoughness.baseColorTexture.index;
+    if(textureIndex >= 0)
+    {
+      const tinygltf::Texture &tex = model.textures[textureIndex];
+
+      // Try to get image index, either from regular source or WebP extension
+      imageIndex = tex.source;
+
+      // If regular source is not valid, check WebP extension
+      if (imageIndex < 0 && tex.extensions.find("EXT_texture_webp") != tex.extensions.end()) {
+          auto& ext = tex.extensions.at("EXT_texture_webp");
+          if (ext.IsObject() && ext.Has("source")) {
+              imageIndex = ext.Get("source").Get<int>();
+          }
+      }
+
+      if(imageIndex < 0 || imageIndex >= static_cast<int>(scene.images.size()))
+      {
+        std::cout << "Invalid image dimensions" << std::endl;
+        imageIndex = -1;
+      }
+    }
+    scene.materials.push_back({imageIndex});
+  }
+
+  const int sceneIndex = model.defaultScene >= 0 ? model.defaultScene : 0;
+  if(sceneIndex >= static_cast<int>(model.scenes.size()))
+  {
+    qDebug() << "The glTF file has no scene";
+    return false;
+  }
+  const tinygltf::Scene &gltfScene = model.scenes[sceneIndex];
+  for(size_t i=0; i<gltfScene.nodes.size(); i++) {
+      processNode(model, model.nodes[gltfScene.nodes[i]], QMatrix4x4(), scene);
+  }
+
+  return true;
+}
+
+std::shared_ptr<const SceneData> SceneImporter::load(const QString &fileName)
+{
+  struct Entry
+  {
+    std::weak_ptr<const SceneData> scene;
+    QDateTime lastModified;
+  };
+  static std::mutex mutex;
+  static std::map<QString, Entry> scenes;
+
+  const QFileInfo info(fileName);
+  const QString key = info.absoluteFilePath();
+  const QDateTime lastModified = info.lastModified();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = scenes.find(key);
+    if(it != scenes.end() && it->second.lastModified == lastModified)
+    {
+      if(std::shared_ptr<const SceneData> scene = it->second.scene.lock())
+      {
+        return scene;
+      }
+    }
+  }
+
+  // The import runs unlocked, the other files can be loaded meanwhile
+  std::shared_ptr<SceneData> scene = std::make_shared<SceneData>();
+  if(!import(fileName, *scene))
+  {
+    return nullptr;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  Entry &entry = scenes[key];
+  std::shared_ptr<const SceneData> other = entry.scene.lock();
+  if(other && entry.lastModified == lastModified)
+  {
+    return other; // another thread imported the same file first
+  }
+  entry.scene = scene;
+  entry.lastModified = lastModified;
+  return scene;
+}
+
+void SceneImporter::processNode(const tinygltf::Model &model, const tinygltf::Node &node, const QMatrix4x4 &parentTransform, SceneData &scene)
+{
+  QMatrix4x4 nodeTransform = parentTransform;
+  QMatrix4x4 localTransform;
+  localTransform.setToIdentity();
+
+  // Apply node transformations
+  if (node.matrix.size() == 16)
+  {
+    for (int i = 0; i < 16; i++) {
+      localTransform(i / 4, i % 4) = node.matrix[i];
+    }
+  }
+  else
+  {
+    // Handle TRS (Translation, Rotation, Scale) properties
+    if (node.translation.size() == 3) {
+        localTransform.translate(node.translation[0], node.translation[1], node.translation[2]);
+    }
+    if (node.rotation.size() == 4) {
+        QQuaternion rotation(node.rotation[3], node.rotation[0], node.rotation[1], node.rotation[2]);
+        localTransform.rotate(rotation);
+    }
+    if (node.scale.size() == 3) {
+        localTransform.scale(node.scale[0], node.scale[1], node.scale[2]);
+    }
+  }
+
+  nodeTransform *= localTransform;
+
+  // Process mesh if present
+  if(node.mesh >= 0)
+  {
+    const int transform = static_cast<int>(scene.transforms.size());
+    scene.transforms.push_back(nodeTransform);
+
+    const tinygltf::Mesh &mesh = model.meshes[node.mesh];
+    for(const auto &primitive : mesh.primitives)
+    {
+      if(!addPrimitive(model, primitive, transform, scene))
+      {
+        qDebug() << "Failed to set up mesh";
+      }
+    }
+  }
+
+  // Process children
+  for(size_t i=0; i<node.children.size(); i++)
+  {
+    processNode(model, model.nodes[node.children[i]], nodeTransform, scene);
+  }
+}
+
+void SceneImporter::centerModel(std::vector<SceneData::Vertex>& vertices) {
+    // Calcul de la bounding box
+    float max = std::numeric_limits<float>::max();
+    float min = std::numeric_limits<float>::lowest();
+    QVector3D minBounds(max, max, max);
+    QVector3D maxBounds(min, min, min);
+
+    
+    // Trouver les points min et max
+    for (const auto& vertex : vertices) {
+        // minBounds = QVector3D::minimum(minBounds, vertex.position);
+        // maxBounds = QVector3D::maximum(maxBounds, vertex.position);
+        minBounds = QVector3D(
+        std::min(minBounds.x(), vertex.position.x()),
+        std::min(minBounds.y(), vertex.position.y()),
+        std::min(minBounds.z(), vertex.position.z())
+    );
+    maxBounds = QVector3D(
+        std::max(maxBounds.x(), vertex.position.x()),
+        std::max(maxBounds.y(), vertex.position.y()),
+        std::max(maxBounds.z(), vertex.position.z())
+    );
+    }
+    
+    // Calculer le centre
+    QVector3D center = (minBounds + maxBounds) * 0.5f;
+
+    QMatrix4x4 translation;
+    translation.setToIdentity();
+    //translation.translate(0.0f, 0.0f, 5.0f);
+
+    QMatrix4x4 scale;
+    scale.setToIdentity();
+    scale.scale(0.05f);
+    
+    // Translater tous les vertices
+    for (auto& vertex : vertices) {
+        vertex.position -= center;
+        vertex.position = scale * translation * vertex.position;
+    }
+}
+
+// Positions (centered and scaled), normals, texture coordinates and colors of a primitive, without any GL call
+bool SceneImporter::assembleVertices(const tinygltf::Model& model, const tinygltf::Primitive& primitive, std::vector<SceneData::Vertex>& vertices) {
+  if (primitive.indices < 0 || primitive.attributes.find("POSITION") == primitive.attributes.end())
+  {
+      qDebug() << "Primitive is missing indices or position attribute";
+      return false;
+  }
+
+  vertices.clear();
+
+  // Get accessor and fill vertex data
+
+  // POSITIONS
+  {
+  const tinygltf::Accessor& posAccessor = model.accessors[primitive.attributes.at("POSITION")];
+  const tinygltf::BufferView& posView = model.bufferViews[posAccessor.bufferView];
+  const float* positions = reinterpret_cast<const float*>(&model.buffers[posView.buffer].data[posView.byteOffset + posAccessor.byteOffset]);
+  for (size_t i = 0; i < posAccessor.count; i++) {
+      SceneData::Vertex vertex;
+      vertex.position = QVector3D(
+          positions[i * 3],
+          positions[i * 3 + 1],
+          positions[i * 3 + 2]
+      );
+      vertices.push_back(vertex);
+  }
+
+  centerModel(vertices);
+  }
+
+  // NORMALS
+  if (primitive.attributes.find("NORMAL") != primitive.attributes.end())
+  {
+    const tinygltf::Accessor& normalAccessor = model.accessors[primitive.attributes.at("NORMAL")];
+    const tinygltf::BufferView& normalView = model.bufferViews[normalAccessor.bufferView];
+    const float* normals = reinterpret_cast<const float*>(&model.buffers[normalView.buffer].data[normalView.byteOffset + normalAccessor.byteOffset]);
+    for (size_t i = 0; i < normalAccessor.count; i++) {
+        vertices[i].normal = QVector3D(
+            normals[i * 3],
+            normals[i * 3 + 1],
+            normals[i * 3 + 2]
+        );
+    }
+  }
+  else
+  {
+    std::cout << "No normal provided" << std::endl;
+    // Assign a default normal if none is provided
+    for(auto& vertex : vertices)
+    {
+      vertex.normal = QVector3D(0.0f, 0.0f, 1.0f);
+    }
+  }
+
+  // UV
+  if (primitive.attributes.find("TEXCOORD_0") != primitive.attributes.end())
+  {
+    const tinygltf::Accessor& uvAccessor = model.accessors[primitive.attributes.at("TEXCOORD_0")];
+    const tinygltf::BufferView& uvView = model.bufferViews[uvAccessor.bufferView];
+    const float* uvs = reinterpret_cast<const float*>(&model.buffers[uvView.buffer].data[uvView.byteOffset + uvAccessor.byteOffset]);
+
+    if(uvAccessor.type == TINYGLTF_TYPE_SCALAR)
+    {
+      for(size_t i = 0; i < uvAccessor.count; i++)
+      {
+        float u = uvs[i];
+        float v = u;
+        vertices[i].texCoords = QVector2D(u, v);
+      }
+    }
+    else if(uvAccessor.type == TINYGLTF_TYPE_VEC2)
+    {
+      for (size_t i = 0; i < uvAccessor.count; i++) {
+        vertices[i].texCoords = QVector2D(
+            uvs[i * 2],
+            uvs[i * 2 + 1]
+        );
+      }
+    }
+  }
+  else
+  {
+    std::cout << "No UV provided" << std::endl;
+  }
+
+  if (primitive.attributes.find("COLOR_0") != primitive.attributes.end()) 
+  {
+      const tinygltf::Accessor& colorAccessor = model.accessors[primitive.attributes.at("COLOR_0")];
+      const tinygltf::BufferView& colorView = model.bufferViews[colorAccessor.bufferView];
+      const float* colors = reinterpret_cast<const float*>(&model.buffers[colorView.buffer].data[colorView.byteOffset + colorAccessor.byteOffset]);
+
+      // fill vertex data with colors
+      for (size_t i = 0; i < colorAccessor.count; i++) {
+          vertices[i].color = QVector3D(
+              colors[i * 3],
+              colors[i * 3 + 1],
+              colors[i * 3 + 2]
+          );
+      }
+  }
+  // else check for material color   
+  else if (primitive.material >= 0)
+  {
+
+    const tinygltf::Material& material = model.materials[primitive.material];
+    
+    // Base color handling
+    if (material.pbrMetallicRoughness.baseColorFactor.size() == 4) {
+        QVector3D color(
+            material.pbrMetallicRoughness.baseColorFactor[0],
+            material.pbrMetallicRoughness.baseColorFactor[1],
+            material.pbrMetallicRoughness.baseColorFactor[2]
+        );
+        
+        for(auto& vertex : vertices)
+        {
+            vertex.color = color;
+        }
+    }
+    else
+    {
+        // Material color not provided so use a default color
+        for(auto& vertex : vertices)
+        {
+            vertex.color = QVector3D(0.8f, 0.8f, 0.8f);
+        }
+    }
+}
+else
+{
+    std::cout << "No color provided" << std::endl;
+    // default color
+    for(auto& vertex : vertices)
+    {
+        vertex.color = QVector3D(0.8f, 0.8f, 0.8f);
+    }
+}
+
+  return true;
+}
+
+bool SceneImporter::addPrimitive(const tinygltf::Model &model, const tinygltf::Primitive &primitive, int transform, SceneData &scene)
+{
+  std::vector<SceneData::Vertex> vertices;
+  if (!assembleVertices(model, primitive, vertices))
+  {
+      return false;
+  }
+
+  SceneData::Mesh mesh;
+  mesh.firstVertex = static_cast<int>(scene.vertices.size());
+  mesh.vertexCount = static_cast<int>(vertices.size());
+  mesh.firstIndex = static_cast<int>(scene.indices.size());
+  mesh.transform = transform;
+  mesh.boundingRadius = 0.0f;
+  for (const auto& vertex : vertices) {
+      mesh.boundingRadius = std::max(mesh.boundingRadius, vertex.position.length());
+  }
+
+  // Without vertex colors, the base color texture of the material colors the mesh
+  const bool vertexColors = primitive.attributes.find("COLOR_0") != primitive.attributes.end();
+  mesh.material = vertexColors ? -1 : primitive.material;
+
+  // Get indices, widened to 32 bits, the uploader narrows them back
+  const tinygltf::Accessor& indexAccessor = model.accessors[primitive.indices];
+  const tinygltf::BufferView& indexView = model.bufferViews[indexAccessor.bufferView];
+  const unsigned char* data = &model.buffers[indexView.buffer].data[indexView.byteOffset + indexAccessor.byteOffset];
+  std::vector<uint32_t> &indices = scene.indices;
+
+  switch (indexAccessor.componentType)
+  {
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+      indices.insert(indices.end(), data, data + indexAccessor.count);
+      mesh.shortIndices = true;
+      break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+    {
+      const uint16_t* indices_ptr = reinterpret_cast<const uint16_t*>(data);
+      indices.insert(indices.end(), indices_ptr, indices_ptr + indexAccessor.count);
+      mesh.shortIndices = true;
+      break;
+    }
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+    {
+      const uint32_t* indices_ptr = reinterpret_cast<const uint32_t*>(data);
+      indices.insert(indices.end(), indices_ptr, indices_ptr + indexAccessor.count);
+      mesh.shortIndices = false;
+      break;
+    }
+    default:
+      qDebug() << "Unsupported index component type";
+      return false;
+  }
+  mesh.indexCount = static_cast<int>(indexAccessor.count);
+
+  scene.vertices.insert(scene.vertices.end(), vertices.begin(), vertices.end());
+  scene.meshes.push_back(mesh);
+  return true;
+}
@@ -0,0 +1,35 @@
+#ifndef SCENEIMPORTER_H
+#define SCENEIMPORTER_H
+
+#include <QString>
+#include <memory>
+#include "SceneData.h"
+#include "tiny_gltf.h"
+
+// Image loader of tinygltf, decodes the WebP images and hands the others to stb_image
+bool LoadWebPOrDefaultImage(tinygltf::Image* image, int image_idx, std::string* err, std::string* warn,
+                            int req_width, int req_height, const unsigned char* data, int size, void* user_data);
+
+// CPU side of the loading: parses a glTF file into a SceneData, no OpenGL context needed, any thread can call it.
+class SceneImporter
+{
+  public:
+    // Parse a .glb or .gltf file
+    static bool import(const QString &fileName, SceneData &scene);
+    static bool import(const tinygltf::Model &model, SceneData &scene);
+
+    // Shared scenes: the widgets showing the same file get the same SceneData, it is imported again only when
+    // the file changed on disk. A scene is released with its last user. Returns nullptr on failure.
+    static std::shared_ptr<const SceneData> load(const QString &fileName);
+
+    // Fill vertices from the attributes of a primitive, the positions are centered and scaled
+    static bool assembleVertices(const tinygltf::Model &model, const tinygltf::Primitive &primitive, std::vector<SceneData::Vertex> &vertices);
+    static void centerModel(std::vector<SceneData::Vertex> &vertices);
+
+  private:
+    // Recursively add the meshes of a node and its children
+    static void processNode(const tinygltf::Model &model, const tinygltf::Node &node, const QMatrix4x4 &parentTransform, SceneData &scene);
+    static bool addPrimitive(const tinygltf::Model &model, const tinygltf::Primitive &primitive, int transform, SceneData &scene);
+};
+
+#endif // SCENEIMPORTER_H
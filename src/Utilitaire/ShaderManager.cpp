@@ -6,6 +6,85 @@
 #include <QDebug>
 #include <QFileInfo>
 
+namespace
+{
+    // Lignes du fichier sans les commentaires ni les lignes vides
+    QStringList codeLines(const QString& content)
+    {
+        QStringList lines;
+        QString line;
+        bool blockComment = false;
+        for (int i = 0; i < content.size(); ++i) {
+            const QChar c = content[i];
+            const QChar next = i + 1 < content.size() ? content[i + 1] : QChar();
+            if (blockComment) {
+                if (c == '*' && next == '/') {
+                    blockComment = false;
+                    ++i;
+                }
+                else if (c == '\n') {
+                    lines << line.trimmed();
+                    line.clear();
+                }
+            }
+            else if (c == '/' && next == '*') {
+                blockComment = true;
+                line += ' ';
+                ++i;
+            }
+            else if (c == '/' && next == '/') {
+                while (i + 1 < content.size() && content[i + 1] != '\n') {
+                    ++i;
+                }
+            }
+            else if (c == '\n') {
+                lines << line.trimmed();
+                line.clear();
+            }
+            else {
+                line += c;
+            }
+        }
+        lines << line.trimmed();
+        lines.removeAll(QString());
+        return lines;
+    }
+
+    // Garde d'inclusion : #ifndef X puis #define X en premier, le #endif qui ferme le #ifndef en dernier.
+    // Seuls des commentaires ou des espaces peuvent précéder ou suivre la garde.
+    bool hasIncludeGuard(const QString& content)
+    {
+        const QStringList lines = codeLines(content);
+        if (lines.size() < 3) {
+            return false;
+        }
+        auto directive = [](const QString& line) {
+            return line.startsWith('#') ? line.mid(1).simplified() : QString();
+        };
+        const QString first = directive(lines.first());
+        if (!first.startsWith("ifndef ") || directive(lines[1]) != "define " + first.mid(7)
+            || directive(lines.last()) != "endif") {
+            return false;
+        }
+
+        // Le #ifndef ne doit pas être fermé avant la dernière ligne
+        int depth = 0;
+        for (int i = 0; i < lines.size(); ++i) {
+            const QString current = directive(lines[i]);
+            if (current.startsWith("if")) {
+                ++depth;
+            }
+            else if (current == "endif" || current.startsWith("endif ")) {
+                --depth;
+                if (depth == 0 && i + 1 < lines.size()) {
+                    return false;
+                }
+            }
+        }
+        return depth == 0;
+    }
+}
+
 ShaderManager::ShaderManager(const QString& baseDir, const QString& version)
     : m_baseDir(baseDir)
     , m_shaderVersion(version) 
@@ -14,6 +93,11 @@ ShaderManager::ShaderManager(const QString& baseDir, const QString& version)
 
 bool ShaderManager::loadModule(const QString& filePath) 
 {
+    // Chaque fichier n'est lu et analysé qu'une fois
+    if (m_modules.contains(filePath)) {
+        return true;
+    }
+
     QString fullPath = m_baseDir + "/" + filePath;
     QFile file(fullPath);
     
@@ -22,72 +106,202 @@ bool ShaderManager::loadModule(const QString& filePath)
         return false;
     }
 
-    QString content = file.readAll();
-    
-    // Analyse des dépendances (#include)
-    QStringList dependencies;
-    QRegularExpression includeRegex("#include\\s+\"([^\"]+)\"");
-    auto matches = includeRegex.globalMatch(content);
-    
-    while (matches.hasNext()) {
-        auto match = matches.next();
-        QString dependency = match.captured(1);
-        dependencies << dependency;
-        
-        // Charger récursivement les dépendances
-        loadModule(dependency);
+    ShaderModule module;
+    module.filePath = filePath;
+    module.includeOnce = false;
+    module.sourceId = m_sourceNames.size();
+    m_sourceNames << filePath;
+    parseModule(QString::fromUtf8(file.readAll()), module);
+
+    // Stocké avant les dépendances, une inclusion cyclique ne relit pas le fichier
+    const QStringList dependencies = module.dependencies;
+    m_modules.insert(filePath, module);
+
+    // Charger récursivement les dépendances
+    bool loaded = true;
+    for (const QString& dependency : dependencies) {
+        loaded = loadModule(dependency) && loaded;
     }
+    return loaded;
+}
 
-    // Stocker le module
-    QFileInfo fileInfo(filePath);
-    m_modules[fileInfo.fileName()] = {content, dependencies, filePath};
-    return true;
+// Découpe le fichier en morceaux de texte séparés par les lignes #include
+void ShaderManager::parseModule(const QString& content, ShaderModule& module)
+{
+    const QStringList lines = content.split('\n');
+    QString text;
+    int textLine = 1;
+
+    for (int i = 0; i < lines.size(); ++i) {
+        const QString line = lines[i];
+        const QString trimmed = line.trimmed();
+        QString directive;
+        if (trimmed.startsWith('#')) {
+            directive = trimmed.mid(1).trimmed();
+        }
+
+        if (directive.startsWith("include")) {
+            const int open = directive.indexOf('"');
+            const int close = directive.indexOf('"', open + 1);
+            if (open >= 0 && close > open) {
+                if (!text.isEmpty()) {
+                    module.chunks.push_back({text, QString(), textLine});
+                    text.clear();
+                }
+                const QString include = directive.mid(open + 1, close - open - 1);
+                module.chunks.push_back({QString(), include, i + 1});
+                module.dependencies << include;
+                textLine = i + 2;
+                continue;
+            }
+        }
+        if (directive.simplified() == "pragma once") {
+            module.includeOnce = true;
+            text += "\n"; // la ligne est gardée vide, les numéros de ligne ne changent pas
+            continue;
+        }
+
+        text += line;
+        if (i + 1 < lines.size()) {
+            text += "\n";
+        }
+    }
+    if (!text.isEmpty()) {
+        module.chunks.push_back({text + "\n", QString(), textLine});
+    }
+
+    if (hasIncludeGuard(content)) {
+        module.includeOnce = true;
+    }
 }
 
 QString ShaderManager::buildShader(const QString& mainFile) 
 {
     m_processingStack.clear();
-    QString version = QString("#version %1\n\n").arg(m_shaderVersion);
     
     if (!m_modules.contains(mainFile)) {
         qWarning() << "Fichier principal non trouvé:" << mainFile;
         return QString();
     }
 
-    return version + processIncludes(m_modules[mainFile].content, mainFile);
+    QString output = QString("#version %1\n").arg(m_shaderVersion);
+    QSet<QString> included;
+    emitModule(mainFile, output, included);
+    return output;
 }
 
-QString ShaderManager::processIncludes(const QString& content, const QString& currentFile) 
+bool ShaderManager::emitModule(const QString& filePath, QString& output, QSet<QString>& included)
 {
-    if (m_processingStack.contains(currentFile)) {
-        qWarning() << "Inclusion cyclique détectée pour le fichier:" << currentFile;
-        return QString();
+    if (m_processingStack.contains(filePath)) {
+        qWarning() << "Inclusion cyclique détectée pour le fichier:" << filePath;
+        return false;
     }
 
-    m_processingStack.insert(currentFile);
-    
-    QString processedContent = content;
-    QRegularExpression includeRegex("#include\\s+\"([^\"]+)\"");
-    auto matches = includeRegex.globalMatch(content);
-    
+    auto module = m_modules.constFind(filePath);
+    if (module == m_modules.constEnd()) {
+        qWarning() << "Fichier include non trouvé:" << filePath;
+        return false;
+    }
+    if (module->includeOnce && included.contains(filePath)) {
+        return true;
+    }
+    included.insert(filePath);
+
+    m_processingStack.insert(filePath);
+    for (const Chunk& chunk : module->chunks) {
+        if (!chunk.include.isEmpty()) {
+            emitModule(chunk.include, output, included);
+        } else {
+            // Chaque morceau reprend la numérotation de son fichier après un include
+            output += lineDirective(chunk.firstLine, module->sourceId);
+            output += chunk.text;
+        }
+    }
+    m_processingStack.remove(filePath);
+    return true;
+}
+
+QString ShaderManager::lineDirective(int line, int sourceId) const
+{
+    // Avant GLSL 3.30, la ligne qui suit "#line n" porte le numéro n + 1
+    const int version = m_shaderVersion.section(' ', 0, 0).toInt();
+    const int number = version >= 330 ? line : line - 1;
+    return QString("#line %1 %2\n").arg(number).arg(sourceId);
+}
+
+QStringList ShaderManager::dependencyClosure(const QString& mainFile) const
+{
+    QStringList files;
+    QStringList pending(mainFile);
+    while (!pending.isEmpty()) {
+        const QString file = pending.takeLast();
+        if (files.contains(file)) {
+            continue;
+        }
+        files << file;
+        auto module = m_modules.constFind(file);
+        if (module != m_modules.constEnd()) {
+            pending << module->dependencies;
+        }
+    }
+    return files;
+}
+
+QString ShaderManager::annotateLog(const QString& log) const
+{
+    // Mesa écrit "0:12(3):", NVIDIA "0(12) :"
+    QRegularExpression locationRegex("^(\\d+)(?::(\\d+)\\(\\d+\\)|\\((\\d+)\\))", QRegularExpression::MultilineOption);
+    QString annotated;
+    int last = 0;
+    auto matches = locationRegex.globalMatch(log);
     while (matches.hasNext()) {
         auto match = matches.next();
-        QString includePath = match.captured(1);
-        QString includeContent;
-        
-        if (m_modules.contains(includePath)) {
-            includeContent = processIncludes(m_modules[includePath].content, includePath);
-        } else {
-            qWarning() << "Fichier include non trouvé:" << includePath;
+        const int sourceId = match.captured(1).toInt();
+        if (sourceId < 0 || sourceId >= m_sourceNames.size()) {
             continue;
         }
-        
-        // Remplacer la ligne #include par le contenu
-        processedContent.replace(match.captured(0), includeContent);
+        const QString line = match.captured(2).isEmpty() ? match.captured(3) : match.captured(2);
+        annotated += log.mid(last, match.capturedStart() - last);
+        annotated += m_sourceNames[sourceId] + ":" + line;
+        last = match.capturedEnd();
     }
+    return annotated + log.mid(last);
+}
 
-    m_processingStack.remove(currentFile);
-    return processedContent + "\n";
+QString ShaderManager::variantKey(const QStringList& defines)
+{
+    // L'ordre des defines ne change pas la variante
+    QStringList sorted = defines;
+    sorted.sort();
+    return sorted.join(";");
+}
+
+QString ShaderManager::buildVariant(const QString& mainFile, const QStringList& defines)
+{
+    const QString key = mainFile + "|" + variantKey(defines);
+    auto cached = m_variants.constFind(key);
+    if (cached != m_variants.constEnd()) {
+        return cached.value();
+    }
+
+    // Les includes ne sont développés qu'une fois par fichier, pour toutes ses variantes
+    const QString baseKey = mainFile + "|";
+    if (!m_variants.contains(baseKey)) {
+        m_variants.insert(baseKey, buildShader(mainFile));
+    }
+    QString source = m_variants.value(baseKey);
+    if (source.isEmpty() || defines.isEmpty()) {
+        return source;
+    }
+
+    QString defineLines;
+    for (const QString& define : defines) {
+        defineLines += "#define " + define + "\n";
+    }
+    // Les defines suivent la ligne #version, qui doit rester la première
+    source.insert(source.indexOf('\n') + 1, defineLines);
+    m_variants.insert(key, source);
+    return source;
 }
 
 QString ShaderManager::getFileContent(const QString& filePath)
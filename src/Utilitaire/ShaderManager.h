@@ -5,27 +5,57 @@
 #include <QMap>
 #include <QSet>
 #include <QStringList>
+#include <vector>
 
+// Chaque fichier est lu et découpé une seule fois en morceaux (texte ou #include), les includes
+// sont ensuite développés en un seul parcours. Des directives #line gardent la ligne et le fichier
+// d'origine (numéro de source) pour les messages d'erreur, voir annotateLog().
+// Les fichiers protégés par #pragma once ou par une garde #ifndef/#define/#endif ne sont inclus qu'une fois.
 class ShaderManager {
 public:
     explicit ShaderManager(const QString& baseDir, const QString& version = "140");
     bool loadModule(const QString& filePath);
     QString buildShader(const QString& mainFile);
 
+    // Variante d'un shader : chaque define ("NOM" ou "NOM VALEUR") devient un #define après #version.
+    // Les sources sont mises en cache par fichier et par clé de permutation.
+    QString buildVariant(const QString& mainFile, const QStringList& defines);
+    static QString variantKey(const QStringList& defines);
+
+    // Le fichier et tous ceux qu'il inclut, directement ou non, d'après ShaderModule::dependencies
+    QStringList dependencyClosure(const QString& mainFile) const;
+    QString baseDir() const { return m_baseDir; }
+    QString version() const { return m_shaderVersion; }
+
+    // Remplace les numéros de source d'un log de compilation ("0:12(3)" ou "0(12)") par les fichiers
+    QString annotateLog(const QString& log) const;
+
 private:
+    struct Chunk {
+        QString text;      // lignes de texte, vide pour un include
+        QString include;   // fichier inclus
+        int firstLine;     // ligne du morceau dans son fichier, à partir de 1
+    };
+
     struct ShaderModule {
-        QString content;
+        std::vector<Chunk> chunks;
         QStringList dependencies;
         QString filePath;
+        bool includeOnce;  // #pragma once ou garde d'inclusion
+        int sourceId;      // numéro de source des directives #line
     };
 
-    QString processIncludes(const QString& content, const QString& currentFile);
+    void parseModule(const QString& content, ShaderModule& module);
+    bool emitModule(const QString& filePath, QString& output, QSet<QString>& included);
+    QString lineDirective(int line, int sourceId) const;
     QString getFileContent(const QString& filePath);
-    
+
     QMap<QString, ShaderModule> m_modules;
+    QStringList m_sourceNames; // fichier de chaque numéro de source
     QString m_shaderVersion;
     QString m_baseDir;
     QSet<QString> m_processingStack;
+    QMap<QString, QString> m_variants; // "fichier|clé" -> source
 };
 
-#endif // SHADERMANAGER_H
\ No newline at end of file
+#endif // SHADERMANAGER_H
@@ -0,0 +1,229 @@
+#include "ShaderReloader.h"
+#include "ShaderManager.h"
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QOffscreenSurface>
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QDebug>
+#include <iostream>
+
+ShaderReloader::ShaderReloader(QObject *parent)
+    : QObject(parent)
+    , m_worker(nullptr)
+    , m_context(nullptr)
+    , m_surface(nullptr)
+{
+  m_debounce.setSingleShot(true);
+  m_debounce.setInterval(100);
+  connect(&m_debounce, &QTimer::timeout, this, &ShaderReloader::compilePending);
+  connect(&m_watcher, &QFileSystemWatcher::fileChanged, this, &ShaderReloader::fileChanged);
+}
+
+ShaderReloader::~ShaderReloader()
+{
+  // The owner calls stop() while the context is current
+}
+
+bool ShaderReloader::start(QOpenGLContext *shareContext)
+{
+  if(m_context)
+  {
+    return true;
+  }
+
+  m_surface = new QOffscreenSurface();
+  m_surface->setFormat(shareContext->format());
+  m_surface->create();
+
+  m_context = new QOpenGLContext();
+  m_context->setFormat(shareContext->format());
+  m_context->setShareContext(shareContext);
+  if(!m_surface->isValid() || !m_context->create())
+  {
+    qWarning() << "Unable to create the shader reload context, the shaders will not be reloaded";
+    delete m_context;
+    delete m_surface;
+    m_context = nullptr;
+    m_surface = nullptr;
+    return false;
+  }
+
+  m_worker = new QObject();
+  m_worker->moveToThread(&m_thread);
+  m_context->moveToThread(&m_thread);
+  m_thread.start();
+  return true;
+}
+
+void ShaderReloader::stop()
+{
+  if(!m_context)
+  {
+    return;
+  }
+  m_debounce.stop();
+
+  // The context comes back to this thread to be deleted, after the compilations already queued
+  QThread *thread = QThread::currentThread();
+  QMetaObject::invokeMethod(m_worker, [this, thread]() { m_context->moveToThread(thread); }, Qt::BlockingQueuedConnection);
+  m_thread.quit();
+  m_thread.wait();
+
+  delete m_worker;
+  delete m_context;
+  delete m_surface;
+  m_worker = nullptr;
+  m_context = nullptr;
+  m_surface = nullptr;
+
+  for(auto &result : takeResults())
+  {
+    delete result.program;
+  }
+}
+
+void ShaderReloader::watch(int id, const Source &source, const QStringList &files)
+{
+  m_sources[id] = source;
+  watchFiles(id, source.directory, files);
+}
+
+void ShaderReloader::watchFiles(int id, const QString &directory, const QStringList &files)
+{
+  QStringList &paths = m_files[id];
+  paths.clear();
+  for(const auto &file : files)
+  {
+    paths << QFileInfo(directory + "/" + file).absoluteFilePath();
+  }
+
+  for(const auto &path : paths)
+  {
+    if(!m_watcher.files().contains(path))
+    {
+      m_watcher.addPath(path);
+    }
+  }
+}
+
+void ShaderReloader::compile(int id, const Source &source)
+{
+  const std::vector<Job> jobs = {{id, source, false}};
+  QMetaObject::invokeMethod(m_worker, [this, jobs]() { compileJobs(jobs); }, Qt::QueuedConnection);
+}
+
+std::vector<ShaderReloader::Result> ShaderReloader::takeResults()
+{
+  QMutexLocker locker(&m_mutex);
+  std::vector<Result> results;
+  results.swap(m_results);
+  return results;
+}
+
+void ShaderReloader::fileChanged(const QString &path)
+{
+  // Editors that save by replacing the file remove it from the watcher
+  if(QFileInfo::exists(path) && !m_watcher.files().contains(path))
+  {
+    m_watcher.addPath(path);
+  }
+
+  for(const auto &files : m_files)
+  {
+    if(files.second.contains(path))
+    {
+      m_pending.insert(files.first);
+    }
+  }
+  if(!m_pending.isEmpty() && m_context)
+  {
+    m_debounce.start();
+  }
+}
+
+void ShaderReloader::compilePending()
+{
+  std::vector<Job> jobs;
+  for(int id : m_pending)
+  {
+    jobs.push_back({id, m_sources[id], true});
+  }
+  m_pending.clear();
+
+  std::cout << "Recompiling " << jobs.size() << " shader programs" << std::endl;
+  QMetaObject::invokeMethod(m_worker, [this, jobs]() { compileJobs(jobs); }, Qt::QueuedConnection);
+}
+
+void ShaderReloader::compileJobs(const std::vector<Job> &jobs)
+{
+  if(!m_context->makeCurrent(m_surface))
+  {
+    // Failed results, the renderer does not wait for programs that will never come
+    qWarning() << "Unable to make the shader reload context current";
+    std::vector<Result> failed;
+    for(const auto &job : jobs)
+    {
+      failed.push_back({job.id, nullptr});
+    }
+    {
+      QMutexLocker locker(&m_mutex);
+      m_results.insert(m_results.end(), failed.begin(), failed.end());
+    }
+    emit programsReady();
+    return;
+  }
+
+  std::vector<Result> results;
+  for(const auto &job : jobs)
+  {
+    const Source &source = job.source;
+    ShaderManager manager(source.directory, source.version);
+    manager.loadModule(source.vertex);
+    manager.loadModule(source.fragment);
+
+    // The includes may have changed, the watched files follow them
+    const int id = job.id;
+    if(job.watched)
+    {
+      QStringList files = manager.dependencyClosure(source.vertex);
+      for(const auto &file : manager.dependencyClosure(source.fragment))
+      {
+        if(!files.contains(file))
+        {
+          files << file;
+        }
+      }
+      QMetaObject::invokeMethod(this, [this, id, source, files]() { watchFiles(id, source.directory, files); }, Qt::QueuedConnection);
+    }
+
+    QOpenGLShaderProgram *program = new QOpenGLShaderProgram();
+    if(!program->addShaderFromSourceCode(QOpenGLShader::Vertex, manager.buildVariant(source.vertex, source.defines)) ||
+       !program->addShaderFromSourceCode(QOpenGLShader::Fragment, manager.buildVariant(source.fragment, source.defines)) ||
+       !program->link())
+    {
+      // A reloaded program keeps the previous one in use
+      std::cout << source.vertex.toStdString() << " / " << source.fragment.toStdString() << " shader error : "
+                << manager.annotateLog(program->log()).toStdString() << std::endl;
+      delete program;
+      results.push_back({id, nullptr});
+      continue;
+    }
+    program->moveToThread(thread());
+    results.push_back({id, program});
+  }
+
+  // The programs are used by the rendering context, they must be complete before it sees them
+  m_context->functions()->glFinish();
+  m_context->doneCurrent();
+
+  if(!results.empty())
+  {
+    {
+      QMutexLocker locker(&m_mutex);
+      m_results.insert(m_results.end(), results.begin(), results.end());
+    }
+    emit programsReady();
+  }
+}
@@ -0,0 +1,96 @@
+#ifndef SHADERRELOADER_H
+#define SHADERRELOADER_H
+
+#include <QObject>
+#include <QFileSystemWatcher>
+#include <QOpenGLShaderProgram>
+#include <QMutex>
+#include <QSet>
+#include <QStringList>
+#include <QThread>
+#include <QTimer>
+#include <map>
+#include <vector>
+
+class QOpenGLContext;
+class QOffscreenSurface;
+
+// Recompiles the shader programs whose files changed on disk, without blocking the rendering.
+// Each program is registered with the files it was built from (its ShaderManager dependency closure),
+// a change only recompiles the programs using the file. The programs are compiled in a worker thread
+// on a context sharing its objects with the rendering context, and handed back with takeResults(),
+// which the renderer calls at the start of a frame to swap them in.
+// The same worker compiles the programs of the first launch when the driver can not compile them in parallel
+// itself (see ParallelProgramLinker), so the rendering thread never waits for a compiler.
+class ShaderReloader : public QObject
+{
+  Q_OBJECT
+
+  public:
+    struct Source
+    {
+      QString directory;
+      QString version;
+      QString vertex;
+      QString fragment;
+      QStringList defines;
+    };
+
+    struct Result
+    {
+      int id;
+      QOpenGLShaderProgram *program; // linked or null, owned by the caller, must be deleted before stop()
+    };
+
+    explicit ShaderReloader(QObject *parent = nullptr);
+    ~ShaderReloader();
+
+    // Must be called from the thread of shareContext, while it is current
+    bool start(QOpenGLContext *shareContext);
+    // Must be called while the rendering context is current, the programs not taken yet are deleted.
+    // The taken programs use the functions of the reload context, they must be deleted before.
+    void stop();
+    bool isRunning() const { return m_context != nullptr; }
+
+    // Recompile the program id when one of its files changes, files are relative to the shader directory
+    void watch(int id, const Source &source, const QStringList &files);
+    // Compile the program id now, whether it is watched or not
+    void compile(int id, const Source &source);
+
+    // Programs compiled since the last call
+    std::vector<Result> takeResults();
+
+  signals:
+    void programsReady();
+
+  private slots:
+    void fileChanged(const QString &path);
+    void compilePending();
+
+  private:
+    struct Job
+    {
+      int id;
+      Source source;
+      bool watched; // its files follow the includes of the new sources
+    };
+
+    void compileJobs(const std::vector<Job> &jobs); // in the worker thread
+    void watchFiles(int id, const QString &directory, const QStringList &files);
+
+    QFileSystemWatcher m_watcher;
+    QTimer m_debounce; // editors write a file in several steps
+    std::map<int, Source> m_sources;
+    std::map<int, QStringList> m_files; // absolute paths used by each program
+    QSet<int> m_pending;
+
+    QThread m_thread;
+    QObject *m_worker; // lives in m_thread
+    QOpenGLContext *m_context;
+    QOffscreenSurface *m_surface;
+
+    QMutex m_mutex;
+    std::vector<Result> m_results;
+};
+
+#endif // SHADERRELOADER_H
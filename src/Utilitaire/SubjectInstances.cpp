@@ -0,0 +1,192 @@
+#include "SubjectInstances.h"
+#include <QOpenGLContext>
+#include <QOpenGLFunctions_3_1>
+#include <QFile>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+SubjectInstances::SubjectInstances(int verticesPerSubject)
+    : m_verticesPerSubject(verticesPerSubject)
+    , m_minScalar(std::numeric_limits<float>::max())
+    , m_maxScalar(std::numeric_limits<float>::lowest())
+    , m_gridExtent(0.0f)
+    , m_uniformBuffer(0)
+    , m_scalarBuffer(0)
+    , m_scalarTexture(0)
+    , m_chunkStride(0)
+    , m_uploadedBytes(0)
+{
+}
+
+SubjectInstances::~SubjectInstances()
+{
+  // The owner destroys it while its context is current
+}
+
+bool SubjectInstances::loadSubject(const QString &fileName)
+{
+  QFile file(fileName);
+  if(!file.open(QIODevice::ReadOnly))
+  {
+    qWarning() << "Unable to read" << fileName;
+    return false;
+  }
+
+  const QByteArray data = file.readAll();
+  std::vector<float> scalars(data.size() / sizeof(float));
+  std::copy(data.constData(), data.constData() + scalars.size() * sizeof(float), reinterpret_cast<char *>(scalars.data()));
+  if(!addSubject(scalars))
+  {
+    qWarning() << fileName << "has" << scalars.size() << "values, the template has" << m_verticesPerSubject << "vertices";
+    return false;
+  }
+  return true;
+}
+
+bool SubjectInstances::addSubject(const std::vector<float> &scalars)
+{
+  if(static_cast<int>(scalars.size()) != m_verticesPerSubject)
+  {
+    return false;
+  }
+
+  m_scalars.insert(m_scalars.end(), scalars.begin(), scalars.end());
+  for(float value : scalars)
+  {
+    m_minScalar = std::min(m_minScalar, value);
+    m_maxScalar = std::max(m_maxScalar, value);
+  }
+  m_placements.push_back(QMatrix4x4());
+  return true;
+}
+
+void SubjectInstances::addSyntheticSubjects(int count)
+{
+  std::vector<float> scalars(m_verticesPerSubject);
+  for(int subject = 0; subject < count; ++subject)
+  {
+    for(int i = 0; i < m_verticesPerSubject; ++i)
+    {
+      scalars[i] = std::sin(i * 0.01f + subject * 0.7f);
+    }
+    addSubject(scalars);
+  }
+}
+
+void SubjectInstances::clear()
+{
+  m_placements.clear();
+  m_scalars.clear();
+  m_minScalar = std::numeric_limits<float>::max();
+  m_maxScalar = std::numeric_limits<float>::lowest();
+  m_gridExtent = 0.0f;
+}
+
+void SubjectInstances::layoutGrid(float spacing)
+{
+  const int columns = std::max(1, static_cast<int>(std::ceil(std::sqrt(static_cast<float>(count())))));
+  const int rows = (count() + columns - 1) / columns;
+  for(int i = 0; i < count(); ++i)
+  {
+    QMatrix4x4 placement;
+    placement.translate(((i % columns) - (columns - 1) * 0.5f) * spacing,
+                        ((rows - 1) * 0.5f - (i / columns)) * spacing,
+                        0.0f);
+    m_placements[i] = placement;
+  }
+  m_gridExtent = std::max(columns, rows) * spacing;
+}
+
+int SubjectInstances::chunkSize(int chunk) const
+{
+  return std::min(MaxPerDraw, count() - chunk * MaxPerDraw);
+}
+
+bool SubjectInstances::upload()
+{
+  destroy();
+  if(m_placements.empty())
+  {
+    return false;
+  }
+
+  initializeOpenGLFunctions();
+  QOpenGLFunctions_3_1 *gl31 = QOpenGLContext::currentContext()->versionFunctions<QOpenGLFunctions_3_1>();
+  if(!gl31 || !gl31->initializeOpenGLFunctions())
+  {
+    qWarning() << "Texture buffers need OpenGL 3.1, the subjects are not rendered";
+    return false;
+  }
+
+  GLint maxTexels = 0;
+  glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+  if(static_cast<qint64>(m_scalars.size()) > maxTexels)
+  {
+    qWarning() << "The scalars of" << count() << "subjects do not fit in a texture buffer of" << maxTexels << "texels";
+    return false;
+  }
+
+  // -- Placements, each chunk starts at an offset usable by glBindBufferRange --
+  GLint alignment = 256;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+  const GLint chunkBytes = MaxPerDraw * 16 * sizeof(float);
+  m_chunkStride = (chunkBytes + alignment - 1) / alignment * alignment;
+
+  std::vector<float> matrices(chunkCount() * m_chunkStride / sizeof(float), 0.0f);
+  for(int i = 0; i < count(); ++i)
+  {
+    float *destination = matrices.data() + (i / MaxPerDraw) * m_chunkStride / sizeof(float) + (i % MaxPerDraw) * 16;
+    std::copy(m_placements[i].constData(), m_placements[i].constData() + 16, destination); // column major like std140
+  }
+
+  glGenBuffers(1, &m_uniformBuffer);
+  glBindBuffer(GL_UNIFORM_BUFFER, m_uniformBuffer);
+  glBufferData(GL_UNIFORM_BUFFER, matrices.size() * sizeof(float), matrices.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+  // -- Scalars --
+  glGenBuffers(1, &m_scalarBuffer);
+  glBindBuffer(GL_TEXTURE_BUFFER, m_scalarBuffer);
+  glBufferData(GL_TEXTURE_BUFFER, m_scalars.size() * sizeof(float), m_scalars.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+  glGenTextures(1, &m_scalarTexture);
+  glBindTexture(GL_TEXTURE_BUFFER, m_scalarTexture);
+  gl31->glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, m_scalarBuffer);
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+  m_uploadedBytes = static_cast<qint64>(matrices.size() * sizeof(float)) + scalarBytes();
+  return true;
+}
+
+void SubjectInstances::destroy()
+{
+  if(m_uniformBuffer != 0)
+  {
+    glDeleteBuffers(1, &m_uniformBuffer);
+    glDeleteBuffers(1, &m_scalarBuffer);
+    glDeleteTextures(1, &m_scalarTexture);
+    m_uniformBuffer = 0;
+    m_scalarBuffer = 0;
+    m_scalarTexture = 0;
+  }
+}
+
+void SubjectInstances::setUpProgram(QOpenGLShaderProgram &program)
+{
+  initializeOpenGLFunctions();
+  const GLuint blockIndex = glGetUniformBlockIndex(program.programId(), "SubjectBlock");
+  if(blockIndex != GL_INVALID_INDEX)
+  {
+    glUniformBlockBinding(program.programId(), blockIndex, BlockBinding);
+  }
+}
+
+void SubjectInstances::bind(int chunk, int textureUnit)
+{
+  glBindBufferRange(GL_UNIFORM_BUFFER, BlockBinding, m_uniformBuffer, chunk * m_chunkStride, MaxPerDraw * 16 * sizeof(float));
+  glActiveTexture(GL_TEXTURE0 + textureUnit);
+  glBindTexture(GL_TEXTURE_BUFFER, m_scalarTexture);
+}
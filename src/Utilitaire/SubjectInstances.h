@@ -0,0 +1,71 @@
+#ifndef SUBJECTINSTANCES_H
+#define SUBJECTINSTANCES_H
+
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLShaderProgram>
+#include <QMatrix4x4>
+#include <QVector2D>
+#include <QString>
+#include <vector>
+
+// Per subject data of the instanced rendering: subjects share the meshes of the template model
+// and only differ by their placement and a scalar per vertex (e.g. curvature).
+// The placements go to a uniform buffer, read with gl_InstanceID, and the scalars to a texture
+// buffer laid out subject after subject, read with gl_InstanceID and gl_VertexID.
+// A uniform block holds MaxPerDraw matrices, more subjects are drawn in several chunks.
+class SubjectInstances : protected QOpenGLExtraFunctions
+{
+  public:
+    static const int MaxPerDraw = 256; // size of u_subjectModel in shaders/Mix/instanced.vs.glsl
+    static const int BlockBinding = 0;
+
+    explicit SubjectInstances(int verticesPerSubject = 0);
+    ~SubjectInstances();
+
+    // Number of scalars of a subject: the vertex count of every mesh of the template
+    void setVerticesPerSubject(int vertices) { m_verticesPerSubject = vertices; }
+    int verticesPerSubject() const { return m_verticesPerSubject; }
+
+    // Scalars of a subject, raw 32 bits floats, one per vertex of the template
+    bool loadSubject(const QString &fileName);
+    bool addSubject(const std::vector<float> &scalars);
+    void addSyntheticSubjects(int count); // For testing without data
+    void clear();
+
+    // Place the subjects side by side on a grid facing the camera
+    void layoutGrid(float spacing);
+    float gridExtent() const { return m_gridExtent; }
+
+    int count() const { return static_cast<int>(m_placements.size()); }
+    int chunkCount() const { return (count() + MaxPerDraw - 1) / MaxPerDraw; }
+    int chunkSize(int chunk) const;
+    QVector2D scalarRange() const { return QVector2D(m_minScalar, m_maxScalar); }
+    qint64 scalarBytes() const { return static_cast<qint64>(m_scalars.size()) * sizeof(float); }
+
+    // Must be called with a current context
+    bool upload();
+    qint64 uploadedBytes() const { return m_uploadedBytes; } // by the last upload()
+    void destroy();
+    bool isUploaded() const { return m_uniformBuffer != 0; }
+
+    // Bind the uniform block of program to BlockBinding
+    void setUpProgram(QOpenGLShaderProgram &program);
+    // Bind the matrices of a chunk and the scalars on textureUnit
+    void bind(int chunk, int textureUnit);
+
+  private:
+    int m_verticesPerSubject;
+    std::vector<QMatrix4x4> m_placements;
+    std::vector<float> m_scalars; // subject after subject
+    float m_minScalar;
+    float m_maxScalar;
+    float m_gridExtent;
+
+    GLuint m_uniformBuffer;
+    GLuint m_scalarBuffer;
+    GLuint m_scalarTexture;
+    GLint m_chunkStride; // bytes between the matrices of two chunks, aligned for glBindBufferRange
+    qint64 m_uploadedBytes;
+};
+
+#endif // SUBJECTINSTANCES_H
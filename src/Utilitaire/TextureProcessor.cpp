@@ -0,0 +1,480 @@
+#include "TextureProcessor.h"
+#include <QCoreApplication>
+#include <QMutex>
+#include <QSet>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QDebug>
+#include <cmath>
+
+namespace
+{
+  const quint32 CacheMagic = 0x54584331; // "TXC1"
+  const qint32 CacheVersion = 1;         // change it when the filters or the encoders change
+
+  class ProcessTask : public QRunnable
+  {
+    public:
+      ProcessTask(const TextureProcessor *processor, TextureProcessor::Job *job)
+          : m_processor(processor), m_job(job)
+      {
+      }
+
+      void run() override
+      {
+        m_job->result = m_processor->process(m_job->pixels, m_job->width, m_job->height, m_job->format);
+      }
+
+    private:
+      const TextureProcessor *m_processor;
+      TextureProcessor::Job *m_job;
+  };
+
+  // Zeroth order modified Bessel function of the first kind, for the Kaiser window
+  double besselI0(double x)
+  {
+    double sum = 1.0;
+    double term = 1.0;
+    for(int k = 1; k < 32; ++k)
+    {
+      term *= (x / (2.0 * k)) * (x / (2.0 * k));
+      sum += term;
+    }
+    return sum;
+  }
+
+  // Weight of a source pixel at distance (in destination pixels) from the center of a destination pixel
+  double kaiserWeight(double distance)
+  {
+    const double width = 3.0;
+    const double alpha = 4.0;
+    if(std::abs(distance) >= width)
+    {
+      return 0.0;
+    }
+    const double sinc = distance == 0.0 ? 1.0 : std::sin(M_PI * distance) / (M_PI * distance);
+    const double ratio = distance / width;
+    return sinc * besselI0(alpha * std::sqrt(1.0 - ratio * ratio)) / besselI0(alpha);
+  }
+
+  // Resample a row or a column of RGBA pixels, stride is the distance in pixels between two samples.
+  // The textures repeat, so the samples wrap around.
+  void resampleLine(const float *source, int sourceSize, float *destination, int destinationSize, int stride)
+  {
+    const double scale = static_cast<double>(sourceSize) / destinationSize;
+    const double radius = 3.0 * scale;
+    for(int i = 0; i < destinationSize; ++i)
+    {
+      const double center = (i + 0.5) * scale - 0.5;
+      double sum[4] = {0.0, 0.0, 0.0, 0.0};
+      double total = 0.0;
+      for(int x = static_cast<int>(std::floor(center - radius)); x <= static_cast<int>(std::ceil(center + radius)); ++x)
+      {
+        const double weight = kaiserWeight((x - center) / scale);
+        if(weight == 0.0)
+        {
+          continue;
+        }
+        const int wrapped = ((x % sourceSize) + sourceSize) % sourceSize;
+        for(int c = 0; c < 4; ++c)
+        {
+          sum[c] += weight * source[wrapped * stride * 4 + c];
+        }
+        total += weight;
+      }
+      for(int c = 0; c < 4; ++c)
+      {
+        destination[i * stride * 4 + c] = static_cast<float>(sum[c] / total);
+      }
+    }
+  }
+
+  unsigned char toByte(float value)
+  {
+    return static_cast<unsigned char>(std::max(0.0f, std::min(value + 0.5f, 255.0f)));
+  }
+
+  quint16 toRGB565(const float color[3])
+  {
+    const int r = std::max(0, std::min(static_cast<int>(color[0] * 31.0f / 255.0f + 0.5f), 31));
+    const int g = std::max(0, std::min(static_cast<int>(color[1] * 63.0f / 255.0f + 0.5f), 63));
+    const int b = std::max(0, std::min(static_cast<int>(color[2] * 31.0f / 255.0f + 0.5f), 31));
+    return static_cast<quint16>((r << 11) | (g << 5) | b);
+  }
+
+  void fromRGB565(quint16 color, float rgb[3])
+  {
+    rgb[0] = ((color >> 11) & 31) * 255.0f / 31.0f;
+    rgb[1] = ((color >> 5) & 63) * 255.0f / 63.0f;
+    rgb[2] = (color & 31) * 255.0f / 31.0f;
+  }
+
+  // 4x4 block of RGBA8 pixels, the pixels outside of the image repeat the last row and column
+  void fetchBlock(const std::vector<unsigned char> &pixels, int width, int height, int blockX, int blockY, unsigned char block[16][4])
+  {
+    for(int y = 0; y < 4; ++y)
+    {
+      for(int x = 0; x < 4; ++x)
+      {
+        const int px = std::min(blockX * 4 + x, width - 1);
+        const int py = std::min(blockY * 4 + y, height - 1);
+        for(int c = 0; c < 4; ++c)
+        {
+          block[y * 4 + x][c] = pixels[4 * (py * width + px) + c];
+        }
+      }
+    }
+  }
+
+  // Color endpoints on the diagonal of the bounding box of the block, inset to reduce the error
+  void encodeColorBlock(const unsigned char block[16][4], unsigned char *output)
+  {
+    float minimum[3] = {255.0f, 255.0f, 255.0f};
+    float maximum[3] = {0.0f, 0.0f, 0.0f};
+    for(int i = 0; i < 16; ++i)
+    {
+      for(int c = 0; c < 3; ++c)
+      {
+        minimum[c] = std::min(minimum[c], static_cast<float>(block[i][c]));
+        maximum[c] = std::max(maximum[c], static_cast<float>(block[i][c]));
+      }
+    }
+    for(int c = 0; c < 3; ++c)
+    {
+      const float inset = (maximum[c] - minimum[c]) / 16.0f;
+      minimum[c] += inset;
+      maximum[c] -= inset;
+    }
+
+    quint16 color0 = toRGB565(maximum);
+    quint16 color1 = toRGB565(minimum);
+    if(color0 < color1)
+    {
+      std::swap(color0, color1);
+    }
+
+    // color0 > color1 selects the 4 colors mode, equal endpoints only use the index 0
+    float palette[4][3];
+    fromRGB565(color0, palette[0]);
+    fromRGB565(color1, palette[1]);
+    for(int c = 0; c < 3; ++c)
+    {
+      palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+      palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+    }
+
+    quint32 indices = 0;
+    if(color0 != color1)
+    {
+      for(int i = 0; i < 16; ++i)
+      {
+        int best = 0;
+        float bestDistance = 1e30f;
+        for(int p = 0; p < 4; ++p)
+        {
+          float distance = 0.0f;
+          for(int c = 0; c < 3; ++c)
+          {
+            const float d = block[i][c] - palette[p][c];
+            distance += d * d;
+          }
+          if(distance < bestDistance)
+          {
+            bestDistance = distance;
+            best = p;
+          }
+        }
+        indices |= static_cast<quint32>(best) << (2 * i);
+      }
+    }
+
+    output[0] = color0 & 0xff;
+    output[1] = color0 >> 8;
+    output[2] = color1 & 0xff;
+    output[3] = color1 >> 8;
+    for(int i = 0; i < 4; ++i)
+    {
+      output[4 + i] = (indices >> (8 * i)) & 0xff;
+    }
+  }
+
+  // 8 interpolated alpha values between the extremes of the block
+  void encodeAlphaBlock(const unsigned char block[16][4], unsigned char *output)
+  {
+    int alpha0 = 0;
+    int alpha1 = 255;
+    for(int i = 0; i < 16; ++i)
+    {
+      alpha0 = std::max(alpha0, static_cast<int>(block[i][3]));
+      alpha1 = std::min(alpha1, static_cast<int>(block[i][3]));
+    }
+
+    int palette[8] = {alpha0, alpha1};
+    for(int p = 1; p < 7; ++p)
+    {
+      palette[p + 1] = ((7 - p) * alpha0 + p * alpha1 + 3) / 7;
+    }
+
+    quint64 indices = 0;
+    if(alpha0 != alpha1)
+    {
+      for(int i = 0; i < 16; ++i)
+      {
+        int best = 0;
+        for(int p = 1; p < 8; ++p)
+        {
+          if(std::abs(block[i][3] - palette[p]) < std::abs(block[i][3] - palette[best]))
+          {
+            best = p;
+          }
+        }
+        indices |= static_cast<quint64>(best) << (3 * i);
+      }
+    }
+
+    output[0] = static_cast<unsigned char>(alpha0);
+    output[1] = static_cast<unsigned char>(alpha1);
+    for(int i = 0; i < 6; ++i)
+    {
+      output[2 + i] = (indices >> (8 * i)) & 0xff;
+    }
+  }
+}
+
+TextureProcessor::TextureProcessor(const Options &options)
+    : m_options(options)
+{
+}
+
+void TextureProcessor::process(std::vector<Job> &jobs) const
+{
+  QThreadPool pool;
+  pool.setMaxThreadCount(std::max(1, m_options.threads));
+  for(auto &job : jobs)
+  {
+    pool.start(new ProcessTask(this, &job));
+  }
+  pool.waitForDone();
+}
+
+TextureProcessor::MipChain TextureProcessor::process(const std::vector<unsigned char> &pixels, int width, int height, Format format) const
+{
+  if(!m_options.compress)
+  {
+    format = Format::RGBA8;
+  }
+
+  const QString fileName = m_options.cacheDirectory.isEmpty() ? QString() : cacheFile(pixels, width, height, format);
+  MipChain chain;
+  if(!fileName.isEmpty() && readCache(fileName, chain))
+  {
+    return chain;
+  }
+
+  chain.width = width;
+  chain.height = height;
+  chain.format = format;
+  std::vector<unsigned char> level = pixels;
+  for(int i = 0; i < levelCount(width, height); ++i)
+  {
+    if(i > 0)
+    {
+      level = downsample(level, chain.levelWidth(i - 1), chain.levelHeight(i - 1), m_options.filter);
+    }
+    chain.levels.push_back(encode(level, chain.levelWidth(i), chain.levelHeight(i), format));
+  }
+
+  if(!fileName.isEmpty())
+  {
+    writeCache(fileName, chain);
+  }
+  return chain;
+}
+
+bool TextureProcessor::hasAlpha(const std::vector<unsigned char> &pixels)
+{
+  for(size_t i = 3; i < pixels.size(); i += 4)
+  {
+    if(pixels[i] != 255)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+int TextureProcessor::levelCount(int width, int height)
+{
+  int levels = 1;
+  for(int size = std::max(width, height); size > 1; size /= 2)
+  {
+    levels++;
+  }
+  return levels;
+}
+
+// The next level is half the size, rounded down
+std::vector<unsigned char> TextureProcessor::downsample(const std::vector<unsigned char> &pixels, int width, int height, Filter filter)
+{
+  const int halfWidth = std::max(1, width / 2);
+  const int halfHeight = std::max(1, height / 2);
+  std::vector<unsigned char> result(4 * halfWidth * halfHeight);
+
+  if(filter == Filter::Box)
+  {
+    for(int y = 0; y < halfHeight; ++y)
+    {
+      const int y0 = std::min(2 * y, height - 1);
+      const int y1 = std::min(2 * y + 1, height - 1);
+      for(int x = 0; x < halfWidth; ++x)
+      {
+        const int x0 = std::min(2 * x, width - 1);
+        const int x1 = std::min(2 * x + 1, width - 1);
+        for(int c = 0; c < 4; ++c)
+        {
+          const int sum = pixels[4 * (y0 * width + x0) + c] + pixels[4 * (y0 * width + x1) + c] +
+                          pixels[4 * (y1 * width + x0) + c] + pixels[4 * (y1 * width + x1) + c];
+          result[4 * (y * halfWidth + x) + c] = static_cast<unsigned char>((sum + 2) / 4);
+        }
+      }
+    }
+    return result;
+  }
+
+  // The Kaiser filter is separable: the rows, then the columns
+  std::vector<float> source(pixels.begin(), pixels.end());
+  std::vector<float> rows(4 * halfWidth * height);
+  for(int y = 0; y < height; ++y)
+  {
+    resampleLine(source.data() + 4 * y * width, width, rows.data() + 4 * y * halfWidth, halfWidth, 1);
+  }
+  std::vector<float> columns(4 * halfWidth * halfHeight);
+  for(int x = 0; x < halfWidth; ++x)
+  {
+    resampleLine(rows.data() + 4 * x, height, columns.data() + 4 * x, halfHeight, halfWidth);
+  }
+  for(size_t i = 0; i < columns.size(); ++i)
+  {
+    result[i] = toByte(columns[i]);
+  }
+  return result;
+}
+
+std::vector<unsigned char> TextureProcessor::encode(const std::vector<unsigned char> &pixels, int width, int height, Format format)
+{
+  if(format == Format::RGBA8)
+  {
+    return pixels;
+  }
+
+  const int blocksX = (width + 3) / 4;
+  const int blocksY = (height + 3) / 4;
+  const int blockSize = format == Format::BC1 ? 8 : 16;
+  std::vector<unsigned char> result(static_cast<size_t>(blocksX) * blocksY * blockSize);
+
+  unsigned char block[16][4];
+  for(int by = 0; by < blocksY; ++by)
+  {
+    for(int bx = 0; bx < blocksX; ++bx)
+    {
+      fetchBlock(pixels, width, height, bx, by, block);
+      unsigned char *output = result.data() + static_cast<size_t>(by * blocksX + bx) * blockSize;
+      if(format == Format::BC3)
+      {
+        encodeAlphaBlock(block, output);
+        output += 8;
+      }
+      encodeColorBlock(block, output);
+    }
+  }
+  return result;
+}
+
+// ------------------------------------------------------ Disk cache ------------------------------------------------------
+
+QString TextureProcessor::cacheFile(const std::vector<unsigned char> &pixels, int width, int height, Format format) const
+{
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(reinterpret_cast<const char *>(pixels.data()), static_cast<int>(pixels.size()));
+  hash.addData(QString("%1 %2 %3 %4 %5").arg(width).arg(height).arg(static_cast<int>(format))
+                   .arg(static_cast<int>(m_options.filter)).arg(CacheVersion).toUtf8());
+  return QDir(m_options.cacheDirectory).filePath(QString(hash.result().toHex()) + ".tex");
+}
+
+bool TextureProcessor::readCache(const QString &fileName, MipChain &chain) const
+{
+  QFile file(fileName);
+  if(!file.open(QIODevice::ReadOnly))
+  {
+    return false;
+  }
+
+  QDataStream stream(&file);
+  quint32 magic;
+  qint32 version, width, height, format, levels;
+  stream >> magic >> version >> width >> height >> format >> levels;
+  if(stream.status() != QDataStream::Ok || magic != CacheMagic || version != CacheVersion || levels != levelCount(width, height))
+  {
+    return false;
+  }
+
+  chain.width = width;
+  chain.height = height;
+  chain.format = static_cast<Format>(format);
+  chain.levels.resize(levels);
+  for(auto &level : chain.levels)
+  {
+    QByteArray data;
+    stream >> data;
+    level.assign(data.begin(), data.end());
+  }
+  return stream.status() == QDataStream::Ok;
+}
+
+void TextureProcessor::writeCache(const QString &fileName, const MipChain &chain) const
+{
+  // Two jobs of the same image have the same cache file, only the first one writes it
+  static QMutex writingMutex;
+  static QSet<QString> writing;
+  {
+    QMutexLocker locker(&writingMutex);
+    if(writing.contains(fileName))
+    {
+      return;
+    }
+    writing.insert(fileName);
+  }
+
+  QDir().mkpath(m_options.cacheDirectory);
+  // Written next to the cache file then renamed, another process never reads half a file. The name of the cache
+  // file is the hash of the image and the options, the process id keeps two processes apart.
+  const QString temporaryName = fileName + QString(".%1.tmp").arg(QCoreApplication::applicationPid());
+  QFile file(temporaryName);
+  if(file.open(QIODevice::WriteOnly))
+  {
+    QDataStream stream(&file);
+    stream << CacheMagic << CacheVersion << qint32(chain.width) << qint32(chain.height) << qint32(chain.format)
+           << qint32(chain.levels.size());
+    for(const auto &level : chain.levels)
+    {
+      stream << QByteArray(reinterpret_cast<const char *>(level.data()), static_cast<int>(level.size()));
+    }
+    file.close();
+
+    if(!QFile::rename(temporaryName, fileName))
+    {
+      QFile::remove(temporaryName);
+    }
+  }
+  else
+  {
+    qWarning() << "Unable to write the texture cache" << fileName;
+  }
+
+  QMutexLocker locker(&writingMutex);
+  writing.remove(fileName);
+}
@@ -0,0 +1,80 @@
+#ifndef TEXTUREPROCESSOR_H
+#define TEXTUREPROCESSOR_H
+
+#include <QString>
+#include <QThread>
+#include <vector>
+#include <algorithm>
+
+// CPU side preparation of the RGBA8 textures before their upload: the whole mipmap chain is generated,
+// then optionally compressed to BC1 (opaque) or BC3 (with alpha). The results are cached on disk,
+// keyed by the pixels and the options, so a model is only encoded the first time it is loaded.
+// Nothing here needs an OpenGL context, the textures are prepared the same way by the batch renderer.
+class TextureProcessor
+{
+  public:
+    enum class Filter
+    {
+      Box,   // average of 2x2 pixels
+      Kaiser // Kaiser windowed sinc, sharper when the model is zoomed out
+    };
+
+    enum class Format
+    {
+      RGBA8 = 0,
+      BC1 = 1, // 8 bytes per 4x4 block, no alpha
+      BC3 = 2  // 16 bytes per 4x4 block
+    };
+
+    struct Options
+    {
+      Filter filter = Filter::Kaiser;
+      bool compress = true;
+      QString cacheDirectory = "../TextureCache"; // empty to disable the cache
+      int threads = QThread::idealThreadCount();
+    };
+
+    // Mipmaps of an image, level 0 first, down to 1x1
+    struct MipChain
+    {
+      int width = 0;
+      int height = 0;
+      Format format = Format::RGBA8;
+      std::vector<std::vector<unsigned char>> levels;
+
+      int levelWidth(int level) const { return std::max(1, width >> level); }
+      int levelHeight(int level) const { return std::max(1, height >> level); }
+    };
+
+    // An image to process, rows of RGBA8 pixels
+    struct Job
+    {
+      std::vector<unsigned char> pixels;
+      int width;
+      int height;
+      Format format;
+      MipChain result;
+    };
+
+    explicit TextureProcessor(const Options &options = Options());
+
+    const Options &options() const { return m_options; }
+
+    // Process every job on a pool of threads, one image per thread
+    void process(std::vector<Job> &jobs) const;
+    MipChain process(const std::vector<unsigned char> &pixels, int width, int height, Format format) const;
+
+    static bool hasAlpha(const std::vector<unsigned char> &pixels);
+    static int levelCount(int width, int height);
+    static std::vector<unsigned char> downsample(const std::vector<unsigned char> &pixels, int width, int height, Filter filter);
+    static std::vector<unsigned char> encode(const std::vector<unsigned char> &pixels, int width, int height, Format format);
+
+  private:
+    QString cacheFile(const std::vector<unsigned char> &pixels, int width, int height, Format format) const;
+    bool readCache(const QString &fileName, MipChain &chain) const;
+    void writeCache(const QString &fileName, const MipChain &chain) const;
+
+    Options m_options;
+};
+
+#endif // TEXTUREPROCESSOR_H
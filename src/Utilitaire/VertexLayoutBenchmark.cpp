@@ -0,0 +1,113 @@
+#include "VertexLayoutBenchmark.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QOpenGLFramebufferObject>
+#include <QSettings>
+#include <algorithm>
+#include <iostream>
+
+VertexLayoutBenchmark::VertexLayoutBenchmark(const QString &directory)
+    : m_directory(directory)
+{
+}
+
+GLTFLoader::VertexLayout VertexLayoutBenchmark::choose(const std::shared_ptr<const SceneData> &scene, bool depthPrePass)
+{
+  initializeOpenGLFunctions();
+
+  const QByteArray driver = QByteArray(reinterpret_cast<const char *>(glGetString(GL_VENDOR))) + '\n' +
+                            QByteArray(reinterpret_cast<const char *>(glGetString(GL_RENDERER))) + '\n' +
+                            QByteArray(reinterpret_cast<const char *>(glGetString(GL_VERSION)));
+  const QString key = QString("%1/%2%3")
+                          .arg(QString::fromLatin1(QCryptographicHash::hash(driver, QCryptographicHash::Sha1).toHex()))
+                          .arg(scene->vertices.size())
+                          .arg(depthPrePass ? "-prepass" : "");
+  QDir().mkpath(m_directory);
+  QSettings settings(QDir(m_directory).filePath("vertexlayouts.ini"), QSettings::IniFormat);
+  const QString stored = settings.value(key).toString();
+  if(stored == "split" || stored == "interleaved")
+  {
+    return stored == "split" ? GLTFLoader::VertexLayout::Split : GLTFLoader::VertexLayout::Interleaved;
+  }
+
+  const double interleaved = measure(scene, GLTFLoader::VertexLayout::Interleaved, depthPrePass);
+  const double split = measure(scene, GLTFLoader::VertexLayout::Split, depthPrePass);
+  const GLTFLoader::VertexLayout layout = split < interleaved ? GLTFLoader::VertexLayout::Split : GLTFLoader::VertexLayout::Interleaved;
+  std::cout << "Vertex layouts: interleaved " << interleaved << " ms, split " << split << " ms per frame, "
+            << (layout == GLTFLoader::VertexLayout::Split ? "split" : "interleaved") << " kept" << std::endl;
+
+  settings.setValue(key, layout == GLTFLoader::VertexLayout::Split ? "split" : "interleaved");
+  return layout;
+}
+
+// Milliseconds per frame, glFinish makes the CPU time the GPU time of the frames
+double VertexLayoutBenchmark::measure(const std::shared_ptr<const SceneData> &scene, GLTFLoader::VertexLayout layout, bool depthPrePass)
+{
+  GLTFLoader loader(this);
+  loader.setVertexLayout(layout);
+  loader.upload(scene);
+
+  float radius = 0.0f;
+  for(const auto &mesh : scene->meshes)
+  {
+    radius = std::max(radius, mesh.boundingRadius);
+  }
+  radius = std::max(radius, 1e-3f);
+
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  QOpenGLFramebufferObject framebuffer(Size, Size, QOpenGLFramebufferObject::Depth);
+  framebuffer.bind();
+  glViewport(0, 0, Size, Size);
+  glEnable(GL_DEPTH_TEST);
+
+  drawFrame(loader, radius, depthPrePass); // the first draws may still upload the buffers
+  glFinish();
+  QElapsedTimer timer;
+  timer.start();
+  for(int frame = 0; frame < FrameCount; ++frame)
+  {
+    drawFrame(loader, radius, depthPrePass);
+  }
+  glFinish();
+  const double milliseconds = timer.nsecsElapsed() / 1e6 / FrameCount;
+
+  glDisable(GL_DEPTH_TEST);
+  framebuffer.release();
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+  return milliseconds;
+}
+
+// The model seen from the front, like the passes of a peeled layer
+void VertexLayoutBenchmark::drawFrame(GLTFLoader &loader, float radius, bool depthPrePass)
+{
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  glMatrixMode(GL_PROJECTION);
+  glLoadIdentity();
+  glOrtho(-radius, radius, -radius, radius, -radius, radius);
+  glMatrixMode(GL_MODELVIEW);
+
+  if(depthPrePass)
+  {
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    for(const auto &mesh : loader.m_meshes)
+    {
+      glLoadMatrixf(mesh.modelMatrix.constData());
+      loader.draw(mesh, true);
+    }
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthFunc(GL_LEQUAL);
+  }
+  for(const auto &mesh : loader.m_meshes)
+  {
+    glLoadMatrixf(mesh.modelMatrix.constData());
+    loader.draw(mesh);
+  }
+  glDepthFunc(GL_LESS);
+
+  glLoadIdentity();
+  glMatrixMode(GL_PROJECTION);
+  glLoadIdentity();
+  glMatrixMode(GL_MODELVIEW);
+}
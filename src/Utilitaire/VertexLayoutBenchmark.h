@@ -0,0 +1,33 @@
+#ifndef VERTEXLAYOUTBENCHMARK_H
+#define VERTEXLAYOUTBENCHMARK_H
+
+#include <QOpenGLFunctions>
+#include <QString>
+#include <memory>
+#include "gltfLoader.h"
+
+// Picks the GLTFLoader::VertexLayout of a scene for the driver: the scene is drawn a few frames in an offscreen
+// framebuffer with each layout, a depth-only pass (if the renderer uses one) then a shaded pass, and the fastest
+// layout is kept. Some drivers fetch every attribute of a vertex together whatever the draw enables, the split
+// streams then only cost an extra fetch; others only read the enabled streams.
+// The draws use the fixed function pipeline, so the benchmark does not wait for the programs compiled in the
+// background. The choice is remembered per driver and vertex count in <directory>/vertexlayouts.ini.
+class VertexLayoutBenchmark : protected QOpenGLFunctions
+{
+  public:
+    explicit VertexLayoutBenchmark(const QString &directory = "../ShaderCache");
+
+    // Must be called with a current context
+    GLTFLoader::VertexLayout choose(const std::shared_ptr<const SceneData> &scene, bool depthPrePass);
+
+  private:
+    static const int Size = 512;      // of the framebuffer
+    static const int FrameCount = 8;  // measured frames per layout, after a warm-up frame
+
+    double measure(const std::shared_ptr<const SceneData> &scene, GLTFLoader::VertexLayout layout, bool depthPrePass);
+    void drawFrame(GLTFLoader &loader, float radius, bool depthPrePass);
+
+    QString m_directory;
+};
+
+#endif // VERTEXLAYOUTBENCHMARK_H
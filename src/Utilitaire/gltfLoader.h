@@ -6,8 +6,10 @@
 #include <QOpenGLTexture>
 #include <QOpenGLBuffer>
 #include <QMatrix4x4>
-#include "tiny_gltf.h"
+#include <memory>
+#include "SceneData.h"
 
+// GPU side of a model: uploads a SceneData (see SceneImporter) into vertex and index buffers and textures
 class GLTFLoader : protected QOpenGLFunctions
 {
   public:
@@ -17,8 +19,28 @@ class GLTFLoader : protected QOpenGLFunctions
     ~GLTFLoader();
 
 
-    // Load a glTF model from a file, it can be either a .glb or .gltf file
+    // How the vertex buffer of a mesh stores the vertices.
+    // Interleaved: one Vertex after the other. Split: the positions first, then the other attributes interleaved
+    // (ShadingAttributes), so the depth-only draws read 12 bytes per vertex instead of sizeof(Vertex).
+    // Which one is faster depends on the driver, see VertexLayoutBenchmark.
+    enum class VertexLayout
+    {
+      Interleaved,
+      Split
+    };
+
+    // Layout of the next uploads, the models already uploaded keep theirs
+    void setVertexLayout(VertexLayout layout) { m_vertexLayout = layout; }
+    VertexLayout vertexLayout() const { return m_vertexLayout; }
+
+    // Load a glTF model from a file, it can be either a .glb or .gltf file.
+    // The import is shared with the other loaders of the same file (SceneImporter::load).
     bool loadModel(const QString &filename);
+    // Create the GL objects of an imported scene, the scene is kept for the CPU users (MultiDrawBatch).
+    // The loaders of a share group use the same objects for the same scene (GpuResourceCache).
+    // Returns the bytes of buffers sent to the GPU, 0 if the objects were already there.
+    qint64 upload(std::shared_ptr<const SceneData> scene);
+    const SceneData *scene() const { return m_gpuModel ? m_gpuModel->scene.get() : nullptr; }
     void render(QOpenGLShaderProgram* shaderProgram, const QMatrix4x4& projection, const QMatrix4x4& view);
     void cleanUp();
 
@@ -30,7 +52,7 @@ class GLTFLoader : protected QOpenGLFunctions
 
     struct TextureInfo
     {
-      QOpenGLTexture *texture;
+      int image; // index in the images of the scene
       TextureType type;
     };
 
@@ -38,43 +60,70 @@ class GLTFLoader : protected QOpenGLFunctions
     struct Mesh {
       QOpenGLBuffer vbo;
       QOpenGLBuffer ebo;
-      GLuint displayListId;
+      VertexLayout layout;
       int indexCount; // May be useful if we use VAOs
+      GLenum indexType;
+      int vertexCount;
+      float boundingRadius; // of the centered vertices
       QMatrix4x4 modelMatrix;
       std::vector<TextureInfo> textureInfos; // 0: base color, 1: normal map, 2: metallic-roughness
 
 
       Mesh(): vbo(QOpenGLBuffer(QOpenGLBuffer::VertexBuffer)), 
               ebo(QOpenGLBuffer(QOpenGLBuffer::IndexBuffer)), 
-              displayListId(0), indexCount(0) 
+              layout(VertexLayout::Interleaved), indexCount(0), indexType(GL_UNSIGNED_INT), vertexCount(0), boundingRadius(0.0f)
               {}
     };
 
-    std::vector<Mesh> m_meshes;
+    // GL objects of an uploaded scene, the loaders hold copies of its meshes
+    struct GpuModel
+    {
+      std::shared_ptr<const SceneData> scene;
+      std::vector<Mesh> meshes;
+      // One per image of the scene, only created when render() uses it: the other paths draw with the
+      // textures of MaterialLibrary, built from the images of the scene
+      mutable std::vector<QOpenGLTexture *> textures;
+      qint64 uploadedBytes = 0; // buffers
+      ~GpuModel(); // with a context of the share group current
+    };
+    // Identifies the uploaded model in the keys of the objects derived from it (MaterialLibrary, MultiDrawBatch)
+    std::shared_ptr<const GpuModel> gpuModel() const { return m_gpuModel; }
 
+    // Draw a mesh from its buffers with glDrawElements, only its positions for the depth-only passes. The attributes
+    // are fetched in the layout of the mesh, so the Split layout reads a fraction of the vertex for the depth.
+    void draw(const Mesh &mesh, bool positionsOnly = false);
+    // Draw instanceCount copies of a mesh with the same vertex arrays as draw(), gl_InstanceID tells them apart
+    void drawInstanced(const Mesh &mesh, int instanceCount);
 
+    // Point the client arrays to the bound vertex buffer, laid out like the Interleaved vertex buffers of the meshes
+    void enableVertexArrays(size_t offset = 0);
+    void disableVertexArrays();
+    static int vertexSize() { return sizeof(Vertex); }
 
+    std::vector<Mesh> m_meshes; // in the order of the meshes of the scene
 
-  private:
+    typedef SceneData::Vertex Vertex;
 
-    // The Vertex struct is used to store the vertex data of a mesh
-    struct Vertex {
-        QVector3D position;
-        QVector3D normal;
-        QVector3D color;
-        QVector2D texCoords;
+    // What follows the positions in the Split layout
+    struct ShadingAttributes
+    {
+      QVector3D normal;
+      QVector3D color;
+      QVector2D texCoords;
     };
 
-    // Retrieve the vertex and index data from a mesh primitive and build a Mesh object from it
-    bool setUpMesh(const tinygltf::Model &model, const tinygltf::Mesh &mesh, const tinygltf::Primitive &primitive, const QMatrix4x4 &transform);
 
-    // Recursively process all nodes in the glTF model
-    void processNode(const tinygltf::Model &model, const tinygltf::Node &node, const QMatrix4x4 &parentTransform);
+  private:
 
-    void centerModel(std::vector<Vertex>& vertices);
+    // Build the buffers of a mesh of the scene
+    void setUpMesh(GpuModel &model, const SceneData::Mesh &sceneMesh);
+    static QOpenGLTexture *texture(const GpuModel &model, int imageIndex);
+    // Point the client arrays to the bound vertex buffer of a mesh, only the positions if positionsOnly
+    void enableMeshArrays(const Mesh &mesh, bool positionsOnly);
 
-    tinygltf::Model m_model;
+    std::shared_ptr<const GpuModel> m_gpuModel;
     QOpenGLFunctions *m_glFuncs;
+    VertexLayout m_vertexLayout;
 
 };
 
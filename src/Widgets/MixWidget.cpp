@@ -1,4 +1,7 @@
 #include "MixWidget.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <algorithm>
 #include <iostream>
 
 // ------------------------------------------------------ Constructor ------------------------------------------------------
@@ -12,61 +15,84 @@ MixWidget::MixWidget(QWidget *parent) :
                     m_farPlane(10000.0f),
                     m_cameraType(TRACKBALL),
                     m_useDepthPeeling(1),
-                    m_gltfLoader(this)
+                    m_scheduler(this)
 {
-  // -- init light --
-    m_light.direction = QVector3D(0.0f, -1.0f, -2.0f);
-    m_light.ambient = QVector3D(1.0f, 1.0f, 1.0f);
-    m_light.diffuse = QVector3D(0.5f, 0.5f, 0.5f);
-    m_light.specular = QVector3D(1.0f, 1.0f, 1.0f);
-    m_light.intensity = 1.0f;
-
-  // -- init materials --
-    //m_material.ambient = QVector4D(1.0f, 1.0f, 0.0f, 0.5f); Using the shape's color
-    m_material.diffuse = QVector3D(0.f, 0.0f, 0.0f);
-    m_material.specular = QVector3D(1.0f, 1.0f, 1.0f);
-    m_material.shininess = 32.0f;
-
     m_fpsTimer.start();
     m_displayTimer = new QTimer(this);
     connect(m_displayTimer, &QTimer::timeout, this, &MixWidget::updateFPSDisplay);
     m_displayTimer->start(1000);
+
+    m_interactionTimer = new QTimer(this);
+    m_interactionTimer->setSingleShot(true);
+    m_interactionTimer->setInterval(150);
+    connect(m_interactionTimer, &QTimer::timeout, this, [this]()
+    {
+      m_refiner.setInteracting(false);
+      m_scheduler.markDirty(RenderScheduler::Refine);
+    });
+
+    m_resizeSettleTimer = new QTimer(this);
+    m_resizeSettleTimer->setSingleShot(true);
+    m_resizeSettleTimer->setInterval(200);
+    connect(m_resizeSettleTimer, &QTimer::timeout, this, &MixWidget::updateRenderTargets);
+
+    m_capturePollTimer = new QTimer(this);
+    m_capturePollTimer->setInterval(5);
+    connect(m_capturePollTimer, &QTimer::timeout, this, [this]()
+    {
+      makeCurrent();
+      if(!m_capture.poll())
+      {
+        m_capturePollTimer->stop();
+      }
+      doneCurrent();
+    });
 }
 
 MixWidget::~MixWidget()
 {
     makeCurrent();
     cleanUp();
-    m_gltfLoader.cleanUp();
     doneCurrent();
 }
 
 // ------------------------------------------------------ Event ------------------------------------------------------
 
-/*C to switch camera, P to write each colorTexture on Debug, M to enable/disable depth peeling*/
+/*C to switch camera, P to write each colorTexture on Debug, O to write the blended frame on Debug, M to enable/disable depth peeling, B to toggle continuous rendering,
+  V to print the video memory used by the render targets, F to change the number of frames in flight (0 to 3),
+  I to switch between the per-mesh draws and the multi-draw indirect path, E to enable/disable the depth pre-pass,
+  Space, Page Up/Down and Home to pause and seek the streamed scalars*/
 void MixWidget::keyPressEvent(QKeyEvent *event)
 {
+  // Only the keys changing the image repaint it, the scalar frames mark the widget dirty when they are ready
+  int dirty = RenderScheduler::Clean;
   if(CameraType::TRACKBALL == m_cameraType)
   {
     switch (event->key()) 
     {
       case Qt::Key_Up:
           m_trackBall.rotateUp(1);
+          dirty = RenderScheduler::Camera;
           break;
       case Qt::Key_Down:
           m_trackBall.rotateUp(-1);
+          dirty = RenderScheduler::Camera;
           break;
       case Qt::Key_Left:
           m_trackBall.rotateLeft(-1);
+          dirty = RenderScheduler::Camera;
           break;
       case Qt::Key_Right:
           m_trackBall.rotateLeft(1);
+          dirty = RenderScheduler::Camera;
           break;
       case Qt::Key_Z:
           m_trackBall.moveFront(0.1);
+          dirty = RenderScheduler::Camera;
           break;
       case Qt::Key_S:
           m_trackBall.moveFront(-0.1);
+          dirty = RenderScheduler::Camera;
           break;
       case Qt::Key_Escape:
           close();
@@ -81,15 +107,19 @@ void MixWidget::keyPressEvent(QKeyEvent *event)
     {
       case Qt::Key_Z:
           m_freefly.moveFront(0.1);
+          dirty = RenderScheduler::Camera;
           break;
       case Qt::Key_S:
           m_freefly.moveFront(-0.1);
+          dirty = RenderScheduler::Camera;
           break;
       case Qt::Key_Q:
           m_freefly.moveLeft(0.1);
+          dirty = RenderScheduler::Camera;
           break;
       case Qt::Key_D:
           m_freefly.moveLeft(-0.1);
+          dirty = RenderScheduler::Camera;
           break;
       case Qt::Key_Escape:
           close();
@@ -102,17 +132,80 @@ void MixWidget::keyPressEvent(QKeyEvent *event)
   if(event->key() == Qt::Key_C)
   {
     switchCamera();
+    dirty = RenderScheduler::Camera;
   }
   else if (event->key() == Qt::Key_P)
   {
+    makeCurrent();
     TexToPng();
+    doneCurrent();
+  }
+  else if (event->key() == Qt::Key_O)
+  {
+    captureComposite();
   }
   else if(event->key() == Qt::Key_M)
   {
     m_useDepthPeeling = !m_useDepthPeeling;
+    m_renderer.setDepthPeelingEnabled(m_useDepthPeeling);
+    dirty = RenderScheduler::Data;
+  }
+  else if(event->key() == Qt::Key_B)
+  {
+    m_scheduler.toggleMode();
+  }
+  else if(event->key() == Qt::Key_F)
+  {
+    m_frameSync.setMaxFramesInFlight((m_frameSync.maxFramesInFlight() + 1) % 4);
+    m_frameSync.resetStatistics();
+  }
+  else if(event->key() == Qt::Key_I)
+  {
+    makeCurrent();
+    m_renderer.setMultiDrawIndirect(!m_renderer.isMultiDrawIndirect());
+    doneCurrent();
+    dirty = RenderScheduler::Data;
+  }
+  else if(event->key() == Qt::Key_E)
+  {
+    m_renderer.setDepthPrePass(!m_renderer.isDepthPrePass());
+    dirty = RenderScheduler::Data;
+  }
+  else if(event->key() == Qt::Key_V)
+  {
+    std::cout << m_renderer.renderTargets().memoryReport().toStdString() << std::endl;
+    if(m_renderer.isDrawingSubjects())
+    {
+      const SubjectInstances &subjects = m_renderer.subjects();
+      std::cout << "Subjects: " << subjects.count() << ", scalars " << subjects.scalarBytes() / (1024.0 * 1024.0) << " MB" << std::endl;
+    }
+  }
+  else if(m_renderer.isDrawingScalars())
+  {
+    ScalarStream &scalars = m_renderer.scalarStream();
+    switch(event->key())
+    {
+      case Qt::Key_Space:
+        scalars.setPaused(!scalars.isPaused());
+        break;
+      case Qt::Key_PageUp:
+        scalars.seek(scalars.frame() + 10);
+        break;
+      case Qt::Key_PageDown:
+        scalars.seek(scalars.frame() - 10);
+        break;
+      case Qt::Key_Home:
+        scalars.seek(0);
+        break;
+      default:
+        break;
+    }
   }
 
-  update();
+  if(dirty != RenderScheduler::Clean)
+  {
+    m_scheduler.markDirty(dirty);
+  }
 }
 
 void MixWidget::mousePressEvent(QMouseEvent *event)
@@ -121,28 +214,19 @@ void MixWidget::mousePressEvent(QMouseEvent *event)
     {
       m_lastMousePosition = QVector2D(event->localPos());
     }
-    update();
 }
 
+// The motion is only accumulated here, it is applied once per frame in applyPendingInput()
 void MixWidget::mouseMoveEvent(QMouseEvent *event)
 {
   if(event->buttons() & Qt::LeftButton)
   {
     const QVector2D mousePos(event->localPos());
-    const QVector2D diff = mousePos - m_lastMousePosition;
-    if(m_cameraType == TRACKBALL)
-    {
-      m_trackBall.rotateLeft(diff.x());
-      m_trackBall.rotateUp(diff.y());
-    }
-    else
-    {
-      m_freefly.rotateLeft(-diff.x());
-      m_freefly.rotateUp(-diff.y());
-    }
+    m_pendingMouseDelta += mousePos - m_lastMousePosition;
     m_lastMousePosition = mousePos;
+    beginInteraction();
+    m_scheduler.markDirty(RenderScheduler::Camera);
   }
-  update();
 }
 
 void MixWidget::wheelEvent(QWheelEvent *event)
@@ -152,7 +236,8 @@ void MixWidget::wheelEvent(QWheelEvent *event)
   {
     m_trackBall.moveFront(delta);
   }
-  update();
+  beginInteraction();
+  m_scheduler.markDirty(RenderScheduler::Camera);
 }
 
 // ------------------------------------------------------ QOpenGLWidget functions ------------------------------------------------------
@@ -163,19 +248,51 @@ void MixWidget::initializeGL()
   glClearColor(0.8f, 0.8f, 0.8f, 1.0f);
 
   // scene
-  initShaders();
-  m_gltfLoader.loadModel("../res/brain/brain.gltf");
-  createFullScreenQuad();
+  const bool initialized = m_renderer.initialize("../shaders/Mix");
+  if(m_renderer.enableShaderReload(context()))
+  {
+    // The recompiled programs are swapped in at the start of the next frame by updatePrograms()
+    connect(&m_renderer.shaderReloader(), &ShaderReloader::programsReady, this, [this]()
+    {
+      m_scheduler.markDirty(RenderScheduler::Data);
+    });
+  }
+  m_renderer.setVertexLayout(m_vertexLayout);
+  m_renderer.setDepthPrePass(m_depthPrePass);
+  const bool loaded = m_renderer.loadModel("../res/brain/brain.gltf");
+  if(!m_subjectSource.isEmpty())
+  {
+    loadSubjects();
+  }
+  if(!m_scalarSeries.isEmpty())
+  {
+    // Called by the producer thread, the frame is uploaded by the next paintGL
+    m_renderer.startScalars(m_scalarSeries, m_scalarRate, [this]()
+    {
+      QMetaObject::invokeMethod(this, [this]() { m_scheduler.markDirty(RenderScheduler::Data); }, Qt::QueuedConnection);
+    });
+  }
 
-  // depth peeling
-  initTextures();
-  initFramebuffers();
+  // depth peeling, the render targets are allocated by resizeGL
+  if(!m_gpuTimer.create())
+  {
+    std::cout << "Timer queries are not supported, the frames are timed on the CPU" << std::endl;
+  }
+  m_frameSync.initialize();
+  m_capture.initialize();
 
   m_viewMatrix = m_cameraType == TRACKBALL ? m_trackBall.getViewMatrix() : m_freefly.getViewMatrix();
 
   const float aspect = static_cast<float>(m_viewportWidth) / static_cast<float>(m_viewportHeight);
   m_projectionMatrix.setToIdentity();
   m_projectionMatrix.perspective(45.0f, aspect, m_nearPlane, m_farPlane);
+
+  if(!initialized || !loaded)
+  {
+    std::cerr << (initialized ? "Unable to load the model" : "Unable to compile the shaders") << ", exiting" << std::endl;
+    // The event loop may not run yet, the exit is queued
+    QMetaObject::invokeMethod(qApp, []() { QCoreApplication::exit(1); }, Qt::QueuedConnection);
+  }
 }
 
 void MixWidget::resizeGL(int w, int h)
@@ -184,263 +301,224 @@ void MixWidget::resizeGL(int w, int h)
   m_viewportHeight = h;
   glViewport(0, 0, w, h);
 
-  initTextures();
-  initFramebuffers();
+  // While the window is being resized the current targets are reused, a reduced area is rendered if they
+  // are too small, and they are only reallocated once the size stops changing
+  RenderTargetPool &renderTargets = m_renderer.renderTargets();
+  if(!renderTargets.isAllocated())
+  {
+    renderTargets.reserve(w, h, m_maxLayers);
+  }
+  else if(!renderTargets.covers(w, h) || renderTargets.isOversized(w, h))
+  {
+    m_resizeSettleTimer->start();
+  }
 
   const float aspect = static_cast<float>(w) / static_cast<float>(h);
   m_projectionMatrix.setToIdentity();
   m_projectionMatrix.perspective(45.0f, aspect, m_nearPlane, m_farPlane);
+
+  m_scheduler.markDirty(RenderScheduler::Resize);
 }
 
 void MixWidget::paintGL() 
 {
-  m_viewMatrix = m_cameraType == TRACKBALL ? m_trackBall.getViewMatrix() : m_freefly.getViewMatrix();
-
-  glClearColor(0.8f, 0.8f, 0.8f, 1.0f);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-  if(m_useDepthPeeling)
+  QElapsedTimer cpuTimer;
+  cpuTimer.start();
+  const qint64 frameStart = m_telemetry.elapsedMicroseconds();
+  const int dirtyFlags = m_scheduler.beginFrame();
+
+  // The cost of the frames, not the interval between them which includes the wait for the swap:
+  // the time critical ones feed the resolution controller, the refinement ones the cost of a layer
+  double gpuTime;
+  int frameKind;
+  quint64 measuredFrame;
+  float measuredScale;
+  while(m_gpuTimer.takeResult(gpuTime, frameKind, &measuredFrame, &measuredScale))
   {
-    depthPeeling();
+    m_telemetry.reportGpuTime(measuredFrame, gpuTime);
+    if(frameKind == TimeCriticalFrame)
+    {
+      m_resolution.reportFrameTime(gpuTime, measuredScale);
+    }
+    else if(frameKind > 0)
+    {
+      m_refiner.reportFrameTime(gpuTime, frameKind);
+    }
   }
-  else
+
+  // Compiled in the background since the previous frame, or reloaded
+  const bool programsChanged = m_renderer.updatePrograms();
+  // The newest frame of the streamed scalars, only the scalars are uploaded
+  const bool scalarsChanged = m_renderer.updateScalars();
+  if(programsChanged || scalarsChanged || (dirtyFlags & RenderScheduler::Invalidating))
   {
-    glEnable(GL_DEPTH_TEST);
-    m_mainProgram.bind();
-    setDepthPeelingUniforms(m_mainProgram, 0);
-    renderGLTF(m_mainProgram);
-    m_mainProgram.release();
+    m_refiner.invalidate();
   }
+  applyPendingInput();
 
-  m_frameCount++;
-  update();
-}
-
-// ------------------------------------------------------ Initialize functions ------------------------------------------------------
+  // Let the CPU record this frame while the GPU still renders the previous ones
+  m_frameSync.beginFrame();
 
+  m_viewMatrix = m_cameraType == TRACKBALL ? m_trackBall.getViewMatrix() : m_freefly.getViewMatrix();
+  m_renderer.setCamera(m_viewMatrix, m_projectionMatrix,
+                       m_cameraType == TRACKBALL ? m_trackBall.getPosition() : m_freefly.getPosition());
 
-void MixWidget::createFullScreenQuad()
-{
-  GLuint displayListId = glGenLists(1);
+  glClearColor(0.8f, 0.8f, 0.8f, 1.0f);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-  glNewList(displayListId, GL_COMPILE);
+  m_gpuTimer.begin();
+  QElapsedTimer drawTimer;
+  drawTimer.start();
+  bool timeCritical = false;
+  float renderScale = 1.0f;
+  int refinedLayers = 0;
+  int peeledLayers = 0;
+  if(!m_renderer.isReady())
   {
-    glBegin(GL_TRIANGLES);
-
-    // front face
-    glTexCoord2f(0.0f, 0.0f);
-    glVertex2f(-1.0f, -1.0f);
-    glTexCoord2f(1.0f, 0.0f);
-    glVertex2f(1.0f, -1.0f);
-    glTexCoord2f(1.0f, 1.0f);
-    glVertex2f(1.0f, 1.0f);
-
-    glTexCoord2f(0.0f, 0.0f);
-    glVertex2f(-1.0f, -1.0f);
-    glTexCoord2f(1.0f, 1.0f);
-    glVertex2f(1.0f, 1.0f);
-    glTexCoord2f(0.0f, 1.0f);
-    glVertex2f(-1.0f, 1.0f);
-
-    glEnd();
+    // A cheap frame until the shaders are compiled, the next one polls them again
+    m_renderer.renderFallback();
+    m_scheduler.markDirty(RenderScheduler::Refine);
   }
-  glEndList();
-
-  m_fullScreenQuadList = displayListId;
-}
-
-void MixWidget::initShaders()
-{
-  ShaderManager manager("../shaders/Mix");
-
-  // -- Blinn-Phong + Depth Peeling shaders --
-  manager.loadModule("main.vs.glsl");
-  QString vertexSource = manager.buildShader("main.vs.glsl");
-  if(!m_mainProgram.addShaderFromSourceCode(QOpenGLShader::Vertex, vertexSource))
+  else if(m_useDepthPeeling && m_renderer.renderTargets().isAllocated())
   {
-    std::cout << "Main vertex shader error : " << m_mainProgram.log().toStdString() << std::endl;
+    const ProgressiveRefiner::Step step = nextPeelingStep();
+    timeCritical = step.interactive;
+    renderScale = step.renderScale;
+    depthPeeling(step);
+    peeledLayers = std::max(0, step.lastLayer - step.firstLayer);
+    refinedLayers = step.interactive ? 0 : peeledLayers;
   }
-  
-  manager.loadModule("main.fs.glsl");
-  QString shaderSource = manager.buildShader("main.fs.glsl");
-  if(!m_mainProgram.addShaderFromSourceCode(QOpenGLShader::Fragment, shaderSource))
+  else
   {
-    std::cout << "Main fragment shader error : " << m_mainProgram.log().toStdString() << std::endl;
+    // Without peeling, or without render targets to peel into (their allocation failed)
+    m_renderer.renderScene();
+    peeledLayers = 1;
   }
-
-  if(!m_mainProgram.link())
+  m_gpuTimer.end(timeCritical ? TimeCriticalFrame : refinedLayers, m_frameIndex, renderScale);
+  if(!m_gpuTimer.isSupported())
   {
-    std::cout << "Main link shader error : " << m_mainProgram.log().toStdString() << std::endl;
+    // Only the CPU side of the draws is known, the driver may still be rendering
+    const double drawTime = drawTimer.nsecsElapsed() / 1.0e6;
+    if(timeCritical)
+    {
+      m_resolution.reportFrameTime(drawTime, renderScale);
+    }
+    else if(refinedLayers > 0)
+    {
+      m_refiner.reportFrameTime(drawTime, refinedLayers);
+    }
   }
+  // The uploads done between two frames (model, subjects, scalars) are counted in the next one
+  m_stateCounters = m_renderer.stateCache().counters();
+  m_renderer.stateCache().resetCounters();
 
-
-  // -- Blending shaders --
-
-  manager.loadModule("blend.vs.glsl");
-  vertexSource = manager.buildShader("blend.vs.glsl");
-  if(!m_blendProgram.addShaderFromSourceCode(QOpenGLShader::Vertex, vertexSource))
+  if(m_captureCompositeRequested)
   {
-    std::cout << "Blend vertex shader error : " << m_blendProgram.log().toStdString() << std::endl;
+    m_captureCompositeRequested = false;
+    m_capture.captureFramebuffer(defaultFramebufferObject(), QRect(0, 0, m_viewportWidth, m_viewportHeight),
+                                 QString("../Debug/frame_%1.png").arg(m_captureCount++));
+    m_capturePollTimer->start();
   }
 
-  manager.loadModule("blend.fs.glsl");
-  shaderSource = manager.buildShader("blend.fs.glsl");
-  if(!m_blendProgram.addShaderFromSourceCode(QOpenGLShader::Fragment, shaderSource))
-  {
-    std::cout << "Blend fragment shader error : " << m_blendProgram.log().toStdString() << std::endl;
-  }
+  m_frameSync.endFrame();
 
-  if(!m_blendProgram.link())
+  // Keep peeling the remaining layers in the next frames
+  if(m_useDepthPeeling && m_renderer.renderTargets().isAllocated() && !m_refiner.isInteracting() &&
+     !m_refiner.isComplete(m_maxLayers))
   {
-    std::cout << "Blend link shader error : " << m_blendProgram.log().toStdString() << std::endl;
+    m_scheduler.markDirty(RenderScheduler::Refine);
   }
 
+  FrameTelemetry::Sample sample;
+  sample.frame = m_frameIndex++;
+  sample.startMicroseconds = frameStart;
+  sample.cpuMilliseconds = cpuTimer.nsecsElapsed() / 1.0e6;
+  sample.layers = peeledLayers;
+  sample.draws = m_stateCounters.draws;
+  sample.uniformUpdates = m_stateCounters.uniformUpdates;
+  sample.uploadedBytes = m_stateCounters.uploadedBytes;
+  m_telemetry.record(sample, m_gpuTimer.isSupported());
+
+  m_frameCount++;
+  m_scheduler.endFrame();
 }
 
-void MixWidget::initTextures()
+// ------------------------------------------------------ Initialize functions ------------------------------------------------------
+
+
+// Called once the window stopped being resized
+void MixWidget::updateRenderTargets()
 {
-  m_depthTextures.clear();
-  m_colorTextures.clear();
-  m_depthTextures.reserve(m_maxLayers);
-  m_colorTextures.reserve(m_maxLayers);
-  for(int i = 0; i<m_maxLayers+1; ++i)
-  {
-    //Depth texture
-    QOpenGLTexture *depthTexture = new QOpenGLTexture(QOpenGLTexture::Target2D);
-    depthTexture->create();
-    depthTexture->setSize(m_viewportWidth, m_viewportHeight);
-    depthTexture->setFormat(QOpenGLTexture::D32F);
-    depthTexture->allocateStorage();
-    depthTexture->setMinificationFilter(QOpenGLTexture::Nearest);
-    depthTexture->setMagnificationFilter(QOpenGLTexture::Nearest);
-    depthTexture->setWrapMode(QOpenGLTexture::ClampToEdge);
-    m_depthTextures.push_back(depthTexture);
-
-    //Color texture
-    QOpenGLTexture *colorTexture = new QOpenGLTexture(QOpenGLTexture::Target2D);
-    colorTexture->create();
-    colorTexture->setSize(m_viewportWidth, m_viewportHeight);
-    colorTexture->setFormat(QOpenGLTexture::RGBA32F);
-    colorTexture->allocateStorage();
-    colorTexture->setMinificationFilter(QOpenGLTexture::Nearest);
-    colorTexture->setMagnificationFilter(QOpenGLTexture::Nearest);
-    colorTexture->setWrapMode(QOpenGLTexture::ClampToEdge);
-    m_colorTextures.push_back(colorTexture);
+  makeCurrent();
+  RenderTargetPool &renderTargets = m_renderer.renderTargets();
+  const bool reallocated = renderTargets.covers(m_viewportWidth, m_viewportHeight) ?
+    renderTargets.fit(m_viewportWidth, m_viewportHeight, m_maxLayers) :
+    renderTargets.reserve(m_viewportWidth, m_viewportHeight, m_maxLayers);
+  doneCurrent();
+
+  if(reallocated)
+  {
+    m_scheduler.markDirty(RenderScheduler::Resize);
   }
 }
 
-void MixWidget::initFramebuffers()
+void MixWidget::loadSubjects()
 {
-  m_peelingFbo.clear();
-  m_peelingFbo.reserve(m_maxLayers);
-  for(int i = 0; i<m_maxLayers+1; ++i)
+  SubjectInstances &subjects = m_renderer.subjects();
+  subjects.setVerticesPerSubject(m_renderer.templateVertexCount());
+
+  bool isCount = false;
+  const int syntheticCount = m_subjectSource.toInt(&isCount);
+  if(isCount)
   {
-    QOpenGLFramebufferObject *fbo = new QOpenGLFramebufferObject(m_viewportWidth, m_viewportHeight);
-    if(!fbo->isValid())
+    subjects.addSyntheticSubjects(syntheticCount);
+  }
+  else
+  {
+    const QDir directory(m_subjectSource);
+    for(const QString &fileName : directory.entryList(QDir::Files, QDir::Name))
     {
-      std::cout << "Error: Framebuffer is not valid" << std::endl;
-      delete fbo;
-      continue;
+      subjects.loadSubject(directory.filePath(fileName));
     }
-    fbo->bind();
-
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_colorTextures[i]->textureId(), 0);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_depthTextures[i]->textureId(), 0);
+  }
 
-     if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-    {
-      std::cout << "Error: Framebuffer is not complete" << std::endl;
-      fbo->release();
-      delete fbo;
-      continue;
-    }
-    fbo->release();
-    m_peelingFbo.push_back(fbo);
+  subjects.layoutGrid(2.2f * m_renderer.templateRadius());
+  if(m_renderer.uploadSubjects())
+  {
+    // Step back to see the whole grid
+    m_trackBall.moveFront(-1.2f * subjects.gridExtent());
   }
 }
 
 // ------------------------------------------------------ Drawing functions ------------------------------------------------------
 
-void MixWidget::renderGLTF(QOpenGLShaderProgram &shaderProgram)
+// In continuous mode every layer is peeled at each frame, otherwise the refiner decides.
+// The time critical frames are rendered at the resolution chosen by the controller.
+ProgressiveRefiner::Step MixWidget::nextPeelingStep()
 {
-  if(m_gltfLoader.m_meshes.empty())
+  if(m_scheduler.mode() == RenderScheduler::Mode::Continuous)
   {
-    return;
+    return {0, m_maxLayers, m_resolution.scale(), true};
   }
-
-  shaderProgram.setUniformValue("u_projection", m_projectionMatrix);
-  shaderProgram.setUniformValue("u_view", m_viewMatrix);
-
-  for(const auto& mesh : m_gltfLoader.m_meshes)
-  {
-    if(!mesh.textureInfos.empty())
-    {
-      shaderProgram.setUniformValue("u_hasTexture", true);
-     
-      for(size_t i = 0; i < mesh.textureInfos.size(); i++)
-      {
-        const auto& textureInfo = mesh.textureInfos[i];
-        if(textureInfo.type == GLTFLoader::TextureType::Texture1D)
-        { 
-          shaderProgram.setUniformValue("u_textureType", 0);
-          glActiveTexture(GL_TEXTURE0);
-          textureInfo.texture->bind();
-          shaderProgram.setUniformValue("u_texture1D", 0);
-
-
-          glActiveTexture(GL_TEXTURE1);
-          glBindTexture(GL_TEXTURE_2D, 0);
-          shaderProgram.setUniformValue("u_texture2D", 1);
-        }
-        else
-        {
-          shaderProgram.setUniformValue("u_textureType", 1);
-          glActiveTexture(GL_TEXTURE0);
-          textureInfo.texture->bind();
-          shaderProgram.setUniformValue("u_texture2D", 0);
-
-          glActiveTexture(GL_TEXTURE1);
-          glBindTexture(GL_TEXTURE_1D, 0);
-          shaderProgram.setUniformValue("u_texture1D", 1); 
-        }
-      }
-    }
-    else
-    {
-      shaderProgram.setUniformValue("u_hasTexture", false);
-    }
-
-    shaderProgram.setUniformValue("u_model", mesh.modelMatrix);
-
-                
-    glCallList(mesh.displayListId);
-
-    if(!mesh.textureInfos.empty())
-    {
-      for(size_t i = 0; i < mesh.textureInfos.size(); i++)
-      {
-        mesh.textureInfos[i].texture->release();
-      }
-    }
-  }
-
-
+  m_refiner.setInteractiveScale(m_resolution.scale());
+  return m_refiner.nextStep(m_maxLayers);
 }
 
-
-void MixWidget::drawFullScreenQuad()
+// Apply the depth peeling algorithm with the Blinn-Phong shading
+// Only the layers of the step are peeled, the others are still valid in the textures
+void MixWidget::depthPeeling(const ProgressiveRefiner::Step &step)
 {
-  glCallList(m_fullScreenQuadList);
+  m_renderer.peel(renderSize(step.renderScale), step.firstLayer, step.lastLayer);
+  m_refiner.frameDone(step);
+  m_renderer.blend(defaultFramebufferObject(), renderSize(m_refiner.cachedScale()), m_refiner.cachedLayers());
 }
 
-// Apply the depth peeling algorithm with the Blinn-Phong shading
-void MixWidget::depthPeeling()
+// The area is bounded by the allocated targets, which may be smaller than the viewport while resizing
+QSize MixWidget::renderSize(float scale) const
 {
-  glEnable(GL_DEPTH_TEST);
-  initDepthPeeling();
-  depthPeelingPass();
-  glDisable(GL_DEPTH_TEST);
-  blendPass();
+  const QSize allocated = m_renderer.renderTargets().allocatedSize();
+  return QSize(std::max(1, std::min(static_cast<int>(m_viewportWidth * scale), allocated.width())),
+               std::max(1, std::min(static_cast<int>(m_viewportHeight * scale), allocated.height())));
 }
 
 // ------------------------------------------------------ Uniforms functions ------------------------------------------------------
@@ -452,231 +530,168 @@ void MixWidget::setSceneUniforms(QOpenGLShaderProgram &program)
   program.setUniformValue("u_ProjectionMatrix", m_projectionMatrix);
 }
 
-// set the specific uniforms in shaders/Mix/peeling.frag
-void MixWidget::setDepthPeelingUniforms(QOpenGLShaderProgram &program, const int layer)
-{
-  program.setUniformValue("u_useDepthPeeling", m_useDepthPeeling);
-  program.setUniformValue("u_layer", layer);  
-}
+// ------------------------------------------------------ Clean up functions ------------------------------------------------------
 
-// set the specific uniforms in shaders/Mix/BlinnPhong.frag
-void MixWidget::setBlinnPhongUniforms(QOpenGLShaderProgram &program)
+// Call the clean up functions to delete the objects, textures, shaders and framebuffers
+void MixWidget::cleanUp()
 {
-  program.setUniformValue("u_lightDirection", m_light.direction);
-  program.setUniformValue("u_lightAmbient", m_light.ambient);
-  program.setUniformValue("u_lightDiffuse", m_light.diffuse);
-  program.setUniformValue("u_lightSpecular", m_light.specular);
-  program.setUniformValue("u_lightIntensity", m_light.intensity);
-  
-  //program.setUniformValue("u_materialAmbient", m_material.ambient); // unused because we use the color of the object
-  program.setUniformValue("u_materialDiffuse", m_material.diffuse);
-  program.setUniformValue("u_materialSpecular", m_material.specular);
-  program.setUniformValue("u_materialShininess", m_material.shininess);
-  
-  // Position de la caméra pour le calcul spéculaire
-  QVector3D cameraPos;
-  if (m_cameraType == TRACKBALL) {
-      cameraPos = m_trackBall.getPosition();
-  } else {
-      cameraPos = m_freefly.getPosition();
-  }
-  program.setUniformValue("u_viewPosition", cameraPos);
+  m_telemetry.stop();
+  cleanupObjects();
+  m_renderer.destroy();
 }
-// ------------------------------------------------------ Depth peeling functions ------------------------------------------------------
 
-// Initialize the first depth peeling pass to render the scene in the first framebuffer
-void MixWidget::initDepthPeeling()
+void MixWidget::cleanupObjects()
 {
-  m_peelingFbo[0]->bind();
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  m_mainProgram.bind();
-  //setSceneUniforms(m_mainProgram);
-  //setBlinnPhongUniforms(m_mainProgram);
-  setDepthPeelingUniforms(m_mainProgram, 0);
-
-  glFinish();
-
-  renderGLTF(m_mainProgram);
+  m_gpuTimer.destroy();
+  m_frameSync.destroy();
+  m_capture.finish();
+  m_capture.destroy();
+}
 
+// ------------------------------------------------------ Utility functions ------------------------------------------------------
 
-  //m_gltfLoader.render(&m_mainProgram, m_projectionMatrix, m_viewMatrix);
-  m_mainProgram.release();
-  m_peelingFbo[0]->release();
+void MixWidget::switchCamera()
+{
+  m_cameraType = m_cameraType == TRACKBALL ? FREEFLY : TRACKBALL;
 }
 
-// Render the scene in the i-th framebuffer and perform the depth peeling pass
-void MixWidget::depthPeelingPass()
+void MixWidget::setContinuousRendering(bool continuous)
 {
-  m_mainProgram.bind();
-  for(int i = 1; i<m_maxLayers; ++i)
-  {
-    m_peelingFbo[i]->bind();
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    glActiveTexture(GL_TEXTURE3);
-    m_depthTextures[i-1]->bind();
-    m_mainProgram.setUniformValue("u_previousDepthTexture", 3);
-
-
-    //setSceneUniforms(m_mainProgram);
-    //setBlinnPhongUniforms(m_mainProgram);
-    setDepthPeelingUniforms(m_mainProgram, i);
-        
-    renderGLTF(m_mainProgram);
-
-
-
-
-    m_peelingFbo[i]->release();
-  }
-
-  m_mainProgram.release();
+  m_scheduler.setMode(continuous ? RenderScheduler::Mode::Continuous : RenderScheduler::Mode::OnDemand);
 }
 
-// Blend the color textures of the i-th framebuffer to the default framebuffer
-void MixWidget::blendPass()
+void MixWidget::setTraceFile(const QString &fileName)
 {
-  glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-  m_blendProgram.bind();
-
-  for(int i=0; i<m_maxLayers; ++i)
+  if(m_telemetry.start(fileName))
   {
-    glActiveTexture(GL_TEXTURE4+i);
-    m_colorTextures[i]->bind();
-    m_blendProgram.setUniformValue(QString("u_layerTexture[%1]").arg(i).toStdString().c_str(), 4+i);
+    std::cout << "Frame trace written to " << fileName.toStdString() << std::endl;
   }
-
-  m_blendProgram.setUniformValue("u_numLayers", m_maxLayers);
-  m_blendProgram.setUniformValue("u_useDepthPeeling", m_useDepthPeeling);
-
-  drawFullScreenQuad();
-
-  m_blendProgram.release();
-
-  glDisable(GL_BLEND);
 }
 
-
-// ------------------------------------------------------ Clean up functions ------------------------------------------------------
-
-// Call the clean up functions to delete the objects, textures, shaders and framebuffers
-void MixWidget::cleanUp()
+void MixWidget::setSubjects(const QString &source)
 {
-  cleanupObjects();
-  cleanupTextures();
-  cleanupShaders();
-  cleanupFramebuffers();
+  m_subjectSource = source;
 }
 
-void MixWidget::cleanupObjects()
+void MixWidget::setScalarSeries(const QString &fileName, double framesPerSecond)
 {
-  glDeleteLists(m_fullScreenQuadList, 1);
+  m_scalarSeries = fileName;
+  m_scalarRate = framesPerSecond;
 }
 
-void MixWidget::cleanupTextures()
+void MixWidget::beginInteraction()
 {
-  for(auto texture : m_depthTextures)
-  {
-    if(texture->isCreated())
-    {
-      texture->destroy();
-      delete texture;
-    }
-  }
-
-  for(auto texture : m_colorTextures)
-  {
-    if(texture->isCreated())
-    {
-      texture->destroy();
-      delete texture;
-    }
-  }
+  m_refiner.setInteracting(true);
+  m_interactionTimer->start();
 }
 
-void MixWidget::cleanupShaders()
+void MixWidget::applyPendingInput()
 {
-  if(m_mainProgram.isLinked())
+  if(m_pendingMouseDelta.isNull())
   {
-    m_mainProgram.removeAllShaders();
-    m_mainProgram.release();
+    return;
   }
 
-  if(m_blendProgram.isLinked())
+  if(m_cameraType == TRACKBALL)
   {
-    m_blendProgram.removeAllShaders();
-    m_blendProgram.release();
+    m_trackBall.rotateLeft(m_pendingMouseDelta.x());
+    m_trackBall.rotateUp(m_pendingMouseDelta.y());
   }
-}
-
-void MixWidget::cleanupFramebuffers()
-{
-  for(auto fbo : m_peelingFbo)
+  else
   {
-    if(fbo->isBound())
-    {
-      fbo->release();
-    }
-    delete fbo;
+    m_freefly.rotateLeft(-m_pendingMouseDelta.x());
+    m_freefly.rotateUp(-m_pendingMouseDelta.y());
   }
-}
-
-// ------------------------------------------------------ Utility functions ------------------------------------------------------
-
-void MixWidget::switchCamera()
-{
-  m_cameraType = m_cameraType == TRACKBALL ? FREEFLY : TRACKBALL;
+  m_pendingMouseDelta = QVector2D();
 }
 
 // Render each color textures in PNG files to debug the depth peeling algorithm
+// The readbacks are asynchronous, the files are written by the capture workers a few frames later
 void MixWidget::TexToPng()
 {
-  for(int i=0; i<m_maxLayers; ++i)
+  // Without render targets (their allocation failed) there is no layer to capture
+  const RenderTargetPool &renderTargets = m_renderer.renderTargets();
+  if(renderTargets.isAllocated())
   {
-    GLuint textureID = m_colorTextures[i]->textureId();
-    int width = m_viewportWidth;
-    int height = m_viewportHeight;
-
-    std::vector<GLubyte> pixels(4 * width * height);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
-    glBindTexture(GL_TEXTURE_2D, 0);
-
-    QImage image(reinterpret_cast<const uchar*>(pixels.data()), width, height, QImage::Format_RGBA8888);
-    image = image.mirrored();
-
-    QString filename = QString("../Debug/texture_output_%1.png").arg(i);
-    image.save(filename, "PNG");
+    const QSize textureSize = renderTargets.allocatedSize();
+    const QRect region(QPoint(0, 0), renderSize(m_refiner.cachedScale())); // area rendered by the last frame
+    for(int i=0; i<m_maxLayers; ++i)
+    {
+      m_capture.captureTexture(GL_TEXTURE_2D, renderTargets.colorTexture(i)->textureId(), textureSize, region,
+                               QString("../Debug/texture_output_%1.png").arg(i));
+    }
   }
 
-  GLuint textureID = m_gltfLoader.m_meshes[0].textureInfos[0].texture->textureId();
-  int width = m_gltfLoader.m_meshes[0].textureInfos[0].texture->width();
-  int height = m_gltfLoader.m_meshes[0].textureInfos[0].texture->height();
-
-  std::vector<GLubyte> pixels(4 * width * height);
-  glBindTexture(GL_TEXTURE_1D, textureID);
-  glGetTexImage(GL_TEXTURE_1D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
-  glBindTexture(GL_TEXTURE_1D, 0);
-
-  QImage image(reinterpret_cast<const uchar*>(pixels.data()), width, height, QImage::Format_RGBA8888);
-  image = image.mirrored();
+  // The colormaps of the model, one per row
+  if(QOpenGLTexture *atlas = m_renderer.materials().colormapAtlas())
+  {
+    const QSize size(atlas->width(), atlas->height());
+    m_capture.captureTexture(GL_TEXTURE_2D, atlas->textureId(), size, QRect(QPoint(0, 0), size), "../Debug/texture_after.png");
+  }
 
-  QString filename = QString("../Debug/texture_after.png");
-  image.save(filename, "PNG");
+  m_capturePollTimer->start();
 }
 
-
+// The blended frame only exists during paintGL, it is read back at the end of the next one
+void MixWidget::captureComposite()
+{
+  m_captureCompositeRequested = true;
+  m_scheduler.markDirty(RenderScheduler::Refine);
+}
 
 void MixWidget::updateFPSDisplay()
 {
   qint64 elapsed = m_fpsTimer.elapsed();
   m_fps = m_frameCount * 1000.0 / elapsed;
   
-  // Display the FPS in the window title
-  setWindowTitle(QString("OpenGL - FPS: %1").arg(m_fps, 0, 'f', 1));
+  // Display the FPS in the window title, outside of the continuous mode it only counts the frames that were needed
+  const QString mode = m_scheduler.mode() == RenderScheduler::Mode::Continuous ? "continuous" : "on demand";
+  QString title = QString("OpenGL - FPS: %1 (%2) - %3 ms, resolution x%4")
+                    .arg(m_fps, 0, 'f', 1).arg(mode)
+                    .arg(m_resolution.lastFrameTime(), 0, 'f', 1)
+                    .arg(m_resolution.scale(), 0, 'f', 2);
+
+  if(m_renderer.isMultiDrawIndirect())
+  {
+    title += QString(" - multi-draw indirect");
+  }
+  if(m_renderer.isDepthPrePass())
+  {
+    title += QString(" - depth pre-pass");
+  }
+
+  // State changes of the last frame
+  title += QString(" - %1 draws, %2 binds (%3 skipped), %4 uniforms (%5 skipped)")
+             .arg(m_stateCounters.draws)
+             .arg(m_stateCounters.programBinds + m_stateCounters.textureBinds)
+             .arg(m_stateCounters.skippedBinds)
+             .arg(m_stateCounters.uniformUpdates)
+             .arg(m_stateCounters.skippedUniforms);
+
+  // Distribution of the frame times since the last update, the average hides the stutters
+  const FrameHistogram &cpu = m_telemetry.cpuHistogram();
+  title += QString(" - CPU p95 %1 ms, p99 %2 ms").arg(cpu.percentile(95), 0, 'f', 1).arg(cpu.percentile(99), 0, 'f', 1);
+  const FrameHistogram &gpu = m_telemetry.gpuHistogram();
+  if(gpu.count() > 0)
+  {
+    title += QString(" - GPU p95 %1 ms, p99 %2 ms").arg(gpu.percentile(95), 0, 'f', 1).arg(gpu.percentile(99), 0, 'f', 1);
+  }
+  m_telemetry.resetStatistics();
+
+  // Latency and throughput depend on the number of frames the CPU may record ahead of the GPU
+  if(m_scheduler.mode() == RenderScheduler::Mode::Continuous)
+  {
+    title += QString(" - %1 frames in flight: latency %2%3 ms, CPU wait %4 ms")
+               .arg(m_frameSync.maxFramesInFlight())
+               .arg(m_frameSync.isLatencyExact() ? "" : "up to ")
+               .arg(m_frameSync.averageLatency(), 0, 'f', 1)
+               .arg(m_frameSync.averageWaitTime(), 0, 'f', 1);
+  }
+  if(m_titleOwner)
+  {
+    window()->setWindowTitle(title); // the views of a window share its title
+  }
+  m_frameSync.resetStatistics();
 
   m_frameCount = 0;
   m_fpsTimer.restart();
@@ -8,7 +8,6 @@
 #include <QOpenGLFunctions>
 #include <QOpenGLShaderProgram>
 #include <QOpenGLBuffer>
-#include <QOpenGLFramebufferObject>
 #include <QOpenGLTexture>
 #include <QMatrix4x4>
 #include <vector>
@@ -21,8 +20,14 @@
 #include "../Cameras/TrackBall.h" 
 #include "../Cameras/Freefly.h"
 #include "../Widgets/CameraType.h"
-#include "../Utilitaire/ShaderManager.h"
-#include "../Utilitaire/gltfLoader.h"
+#include "../Utilitaire/RenderScheduler.h"
+#include "../Utilitaire/ProgressiveRefiner.h"
+#include "../Utilitaire/GpuFrameTimer.h"
+#include "../Utilitaire/ResolutionController.h"
+#include "../Utilitaire/PeelingRenderer.h"
+#include "../Utilitaire/FrameSync.h"
+#include "../Utilitaire/FrameCapture.h"
+#include "../Utilitaire/FrameTelemetry.h"
 
 class MixWidget : public QOpenGLWidget, protected QOpenGLFunctions
 {
@@ -34,6 +39,29 @@ class MixWidget : public QOpenGLWidget, protected QOpenGLFunctions
 
     QOpenGLFunctions *getOpenGLFunctions();
 
+    // Redraw every frame instead of only when something changed, used to measure performances
+    void setContinuousRendering(bool continuous);
+
+    // Show one instance of the model per subject, source is a directory of per-vertex scalar files
+    // (raw 32 bits floats) or a number of synthetic subjects. Must be called before the widget is shown.
+    void setSubjects(const QString &source);
+
+    // Color the model with a time series of per-vertex scalars (see ScalarSeries) played at framesPerSecond, the rate
+    // of the file if 0. Space pauses, Page Up/Down steps 10 frames, Home goes back to the first frame.
+    // Must be called before the widget is shown.
+    void setScalarSeries(const QString &fileName, double framesPerSecond = 0.0);
+
+    // Vertex buffers of the model and depth pre-pass, see PeelingRenderer. E toggles the pre-pass.
+    // Must be called before the widget is shown.
+    void setVertexLayout(const QString &name) { m_vertexLayout = name; }
+    void setDepthPrePass(bool enabled) { m_depthPrePass = enabled; }
+
+    // Write one sample per frame to fileName, a CSV file if it ends with .csv, else a Chrome trace
+    void setTraceFile(const QString &fileName);
+
+    // Show the statistics of this view in the title of its window, only one view of a window should be the owner
+    void setTitleOwner(bool owner) { m_titleOwner = owner; }
+
   protected:
     void initializeGL() override;
     void resizeGL(int w, int h) override;
@@ -45,56 +73,30 @@ class MixWidget : public QOpenGLWidget, protected QOpenGLFunctions
 
   private:
     // -- initialize functions --
-    void createFullScreenQuad();                                                                                                  // Create a full screen quad
-    void initShaders();
-    void initTextures();
-    void initFramebuffers();
+    void updateRenderTargets(); // Reallocate the peeling targets to the current viewport size if needed
+    void loadSubjects(); // Load and upload the subjects of m_subjectSource
 
     // -- Drawing functions --
-    void renderGLTF(QOpenGLShaderProgram &shaderProgram);
-    void drawFullScreenQuad();
-    void depthPeeling(); // Perform the depth peeling algorithm
+    ProgressiveRefiner::Step nextPeelingStep(); // Layers and resolution of the current frame
+    void depthPeeling(const ProgressiveRefiner::Step &step); // Perform the depth peeling algorithm on the layers of the step
 
     // -- Uniforms functions --
     void setSceneUniforms(QOpenGLShaderProgram &program); // Set the specific uniforms in shaders/Mix/main.vs and shaders/Mix/main.fs
-    void setBlinnPhongUniforms(QOpenGLShaderProgram &program);  // Set the specific uniforms in shaders/Mix/blinnPhong.frag
-    void setDepthPeelingUniforms(QOpenGLShaderProgram &program, const int layer); // Set the specific uniforms in shaders/Mix/peeling.frag
 
     // -- Depth Peeling functions --
-    void initDepthPeeling(); // Fill the depth peeling FBOs with the scene
-    void depthPeelingPass(); // Perform the depth peeling pass
-    void blendPass(); // Blend the color of each layer
+    QSize renderSize(float scale) const; // Size of the area rendered in the peeling textures
 
     // -- Clean up functions --
     void cleanUp();
     void cleanupObjects();
-    void cleanupTextures();
-    void cleanupShaders();
-    void cleanupFramebuffers();
 
     // -- utility functions --
     void switchCamera();
-    void TexToPng();
-
-    // -- Blinn-Phong parameters --
-    struct Material {
-        QVector4D ambient;
-        QVector3D diffuse;
-        QVector3D specular;
-        float shininess;
-    };
-
-    struct Light {
-        QVector3D direction;
-        QVector3D ambient;
-        QVector3D diffuse;
-        QVector3D specular;
-        float intensity;
-    };
-
-    // -- Blinn-Phong variables --
-    Material m_material;
-    Light m_light;
+    void TexToPng(); // Queue the capture of every layer
+    void captureComposite(); // Queue the capture of the blended frame
+    void applyPendingInput(); // Apply the mouse motion accumulated since the last frame
+    void beginInteraction(); // Render coarse frames until the input stops
+
     int m_useDepthPeeling; // Activate or deactivate the depth peeling algorithm
 
     // -- Camera --
@@ -103,23 +105,38 @@ class MixWidget : public QOpenGLWidget, protected QOpenGLFunctions
     float m_nearPlane;
     float m_farPlane;
     QVector2D m_lastMousePosition;
+    QVector2D m_pendingMouseDelta; // mouse motion not yet applied to the camera
     int m_cameraType;
 
-    // -- Shaders --
-    QOpenGLShaderProgram m_mainProgram; // perform color computation and depth peeling
-    QOpenGLShaderProgram m_blendProgram; // blend the layers
-
-    // -- Objects --
-    GLTFLoader m_gltfLoader;
-    GLuint m_fullScreenQuadList;
-    GLuint m_transparentObjects;
-
-    // -- FBOs --
-    std::vector<QOpenGLFramebufferObject *> m_peelingFbo;
-
-    // -- Textures --
-    std::vector<QOpenGLTexture *> m_colorTextures;
-    std::vector<QOpenGLTexture *> m_depthTextures;
+    // -- Scheduling --
+    RenderScheduler m_scheduler;
+    ProgressiveRefiner m_refiner;
+    QTimer *m_interactionTimer; // fires when the input stopped for a while
+
+    // -- Dynamic resolution --
+    // The tag of a measure is TimeCriticalFrame or the number of layers refined by the frame
+    static const int TimeCriticalFrame = -1;
+    GpuFrameTimer m_gpuTimer;
+    ResolutionController m_resolution; // scale of the time critical frames (interaction, continuous mode)
+
+    // -- CPU/GPU synchronization --
+    FrameSync m_frameSync;
+
+    // -- Capture --
+    FrameCapture m_capture;
+    QTimer *m_capturePollTimer; // polls the readbacks while some are pending
+    bool m_captureCompositeRequested = false;
+    int m_captureCount = 0;
+
+    // -- Shaders, model and peeling layers --
+    PeelingRenderer m_renderer;
+    GLStateCache::Counters m_stateCounters; // state changes of the last frame
+    QString m_subjectSource;
+    QString m_scalarSeries;
+    QString m_vertexLayout = "auto";
+    bool m_depthPrePass = false;
+    double m_scalarRate = 0.0; // frames of the series per second, 0 for the rate of the file
+    QTimer *m_resizeSettleTimer; // fires when the window stopped being resized
 
     // -- Transformation matrix --
     QMatrix4x4 m_projectionMatrix;
@@ -127,9 +144,12 @@ class MixWidget : public QOpenGLWidget, protected QOpenGLFunctions
 
     // -- Frame count --
     QElapsedTimer m_fpsTimer;
-    int m_frameCount = 0;
+    int m_frameCount = 0; // since the last title update
+    quint64 m_frameIndex = 0; // since the start
+    FrameTelemetry m_telemetry;
     qreal m_fps = 0.0;
     QTimer *m_displayTimer;
+    bool m_titleOwner = true;
 
     // -- Variables --
     int m_maxLayers;
@@ -1,15 +1,145 @@
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QHBoxLayout>
+#include <QSurfaceFormat>
+#include <algorithm>
 #include <iostream>
 #include "Widgets/TriangleWidget.h"
 #include "Widgets/MixWidget.h"
+#include "Utilitaire/BatchRenderer.h"
+#include "Utilitaire/ScalarSeries.h"
+#include "Utilitaire/SceneImporter.h"
+
+// b <model> [options]: render a turntable of the model to an image sequence
+int runBatch(const QApplication &app)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Offline turntable rendering with depth peeling.\n"
+                                     "Without a display, run it under Xvfb (xvfb-run) or set QT_QPA_PLATFORM to an EGL platform "
+                                     "(minimalegl or eglfs).");
+    parser.addHelpOption();
+    parser.addPositionalArgument("mode", "b for the batch mode");
+    parser.addPositionalArgument("model", "glTF model (.gltf or .glb)");
+    QCommandLineOption framesOption({"n", "frames"}, "Number of frames of the turn.", "count", "360");
+    QCommandLineOption sizeOption({"s", "size"}, "Resolution of the frames.", "WxH", "1920x1080");
+    QCommandLineOption layersOption({"l", "layers"}, "Number of peeled layers (1 to 16).", "count", "16");
+    QCommandLineOption outputOption({"o", "output"}, "Output directory.", "directory", "../Turntable");
+    QCommandLineOption formatOption({"f", "format"}, "Image format, png or raw (RGBA8 rows, bottom to top).", "format", "png");
+    QCommandLineOption distanceOption("distance", "Distance of the camera to the model.", "distance", "5");
+    QCommandLineOption elevationOption("elevation", "Elevation of the camera in degrees.", "degrees", "0");
+    QCommandLineOption encodersOption("encoders", "Number of encoding threads.", "count", QString::number(QThread::idealThreadCount()));
+    QCommandLineOption uncompressedOption("uncompressed-textures", "Do not compress the textures of the model.");
+    QCommandLineOption boxFilterOption("box-filter", "Build the texture mipmaps with a box filter instead of a Kaiser filter.");
+    QCommandLineOption textureCacheOption("texture-cache", "Directory of the processed textures, empty to disable.", "directory", "../TextureCache");
+    QCommandLineOption traceOption("trace", "Write the frame times to a CSV file (.csv) or a Chrome trace (.json).", "file");
+    QCommandLineOption layoutOption("vertex-layout", "Vertex buffers: interleaved, split or auto (the faster one on this driver).", "layout", "auto");
+    QCommandLineOption prePassOption("depth-prepass", "Fill the depth of each layer with the positions only before shading it.");
+    parser.addOptions({framesOption, sizeOption, layersOption, outputOption, formatOption, distanceOption, elevationOption, encodersOption,
+                       uncompressedOption, boxFilterOption, textureCacheOption, traceOption, layoutOption, prePassOption});
+    parser.process(app);
+
+    const QStringList positional = parser.positionalArguments();
+    const QStringList size = parser.value(sizeOption).split('x');
+    if(positional.size() < 2 || size.size() != 2)
+    {
+        parser.showHelp(1);
+    }
+
+    BatchRenderer::Settings settings;
+    settings.modelFile = positional[1];
+    settings.frames = parser.value(framesOption).toInt();
+    settings.size = QSize(std::max(1, size[0].toInt()), std::max(1, size[1].toInt()));
+    settings.layers = parser.value(layersOption).toInt();
+    settings.outputDirectory = parser.value(outputOption);
+    settings.format = parser.value(formatOption);
+    settings.distance = parser.value(distanceOption).toFloat();
+    settings.elevation = parser.value(elevationOption).toFloat();
+    settings.encoderThreads = std::max(1, parser.value(encodersOption).toInt());
+    settings.textures.compress = !parser.isSet(uncompressedOption);
+    settings.textures.filter = parser.isSet(boxFilterOption) ? TextureProcessor::Filter::Box : TextureProcessor::Filter::Kaiser;
+    settings.textures.cacheDirectory = parser.value(textureCacheOption);
+    settings.traceFile = parser.value(traceOption);
+    settings.vertexLayout = parser.value(layoutOption);
+    settings.depthPrePass = parser.isSet(prePassOption);
+
+    BatchRenderer renderer(settings);
+    return renderer.run() ? 0 : 1;
+}
+
+// c <input> <output> [options]: convert a series of per-vertex scalars to the chunked format of ScalarSeries
+int runConvert(const QApplication &app)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Conversion of per-vertex scalar time series");
+    parser.addHelpOption();
+    parser.addPositionalArgument("mode", "c for the conversion mode");
+    parser.addPositionalArgument("input", "Raw 32 bits floats, frame after frame, or a series to convert again");
+    parser.addPositionalArgument("output", "Series file");
+    QCommandLineOption verticesOption("vertices", "Number of scalars per frame of a raw input.", "count", "0");
+    QCommandLineOption modelOption("model", "glTF model giving the number of scalars per frame of a raw input.", "file");
+    QCommandLineOption float32Option("float32", "Store 32 bits floats instead of 16 bits ones.");
+    QCommandLineOption noDeltaOption("no-delta", "Do not store the scalars as differences with the previous frame.");
+    QCommandLineOption zstdOption("zstd", "Compress the chunks with zstd.");
+    QCommandLineOption chunkOption("chunk", "Number of frames per chunk.", "count", "16");
+    QCommandLineOption rateOption("rate", "Frames per second.", "Hz", "30");
+    parser.addOptions({verticesOption, modelOption, float32Option, noDeltaOption, zstdOption, chunkOption, rateOption});
+    parser.process(app);
+
+    const QStringList positional = parser.positionalArguments();
+    if(positional.size() < 3)
+    {
+        parser.showHelp(1);
+    }
+
+    int vertexCount = parser.value(verticesOption).toInt();
+    if(parser.isSet(modelOption))
+    {
+        SceneData scene;
+        if(!SceneImporter::import(parser.value(modelOption), scene))
+        {
+            return 1;
+        }
+        vertexCount = static_cast<int>(scene.vertices.size());
+    }
+
+    ScalarSeries source;
+    if(!source.open(positional[1], vertexCount))
+    {
+        return 1;
+    }
+    ScalarSeries::Options options;
+    options.encoding = parser.isSet(float32Option) ? ScalarSeries::Float32 : ScalarSeries::Float16;
+    options.compression = (parser.isSet(noDeltaOption) ? ScalarSeries::None : ScalarSeries::Delta) |
+                          (parser.isSet(zstdOption) ? ScalarSeries::Zstd : ScalarSeries::None);
+    options.framesPerChunk = std::max(1, parser.value(chunkOption).toInt());
+    options.framesPerSecond = parser.value(rateOption).toFloat();
+    return ScalarSeries::write(positional[2], source, options) ? 0 : 1;
+}
 
 int main(int argc, char **argv)
 {
+    // The batch and conversion modes do not need a display. The offscreen platform of Qt 5 still needs GLX for
+    // OpenGL, so a headless batch runs under Xvfb or with QT_QPA_PLATFORM set to an EGL platform (minimalegl, eglfs).
+    if(argc > 1 && (argv[1][0] == 'b' || argv[1][0] == 'c') && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM") && qEnvironmentVariableIsEmpty("DISPLAY"))
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    // The multi-draw batch needs OpenGL 4.3 with the client arrays of the per-mesh draws. A driver that
+    // refuses it gives its highest version instead, MultiDrawBatch::isSupported checks the version obtained.
+    // Set before the application, which creates the shared context with the default format.
+    QSurfaceFormat format = QSurfaceFormat::defaultFormat();
+    format.setVersion(4, 3);
+    format.setProfile(QSurfaceFormat::CompatibilityProfile);
+    QSurfaceFormat::setDefaultFormat(format);
+
+    // The widgets of a window share their GL objects (GpuResourceCache)
+    QApplication::setAttribute(Qt::AA_ShareOpenGLContexts);
     QApplication app(argc, argv);
     
     if(argc < 2)
     {
-        std::cerr << "Usage: " << argv[0] << " <m> or <t>" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <m> [--benchmark] [--subjects <directory or count>] [--scalars <file> [--scalar-rate <Hz>]] [--trace <file.json or file.csv>] [--views <count>] [--vertex-layout <auto|interleaved|split>] [--depth-prepass] or <t> or <b> <model> [--help] or <c> <input> <output> [--help]" << std::endl;
         return 1;
     }
 
@@ -22,14 +152,59 @@ int main(int argc, char **argv)
     }
     else if(argv[1][0] == 'm') // GLTF model with depth peeling
     {
-        MixWidget mix;
-        mix.resize(640,480);
-        mix.show();
+        // Several views of the model side by side, their contexts share the buffers and textures of the model
+        const QStringList arguments = app.arguments();
+        const int viewsIndex = arguments.indexOf("--views");
+        const int viewCount = viewsIndex > 0 && viewsIndex + 1 < arguments.size() ? std::max(1, arguments[viewsIndex + 1].toInt()) : 1;
+
+        QWidget window;
+        QHBoxLayout *layout = new QHBoxLayout(&window);
+        layout->setContentsMargins(0, 0, 0, 0);
+        layout->setSpacing(2);
+        for(int i = 0; i < viewCount; ++i)
+        {
+            MixWidget *mix = new MixWidget(&window);
+            mix->setContinuousRendering(arguments.contains("--benchmark"));
+            const int subjects = arguments.indexOf("--subjects");
+            if(subjects > 0 && subjects + 1 < arguments.size())
+            {
+                mix->setSubjects(arguments[subjects + 1]);
+            }
+            const int scalars = arguments.indexOf("--scalars");
+            if(scalars > 0 && scalars + 1 < arguments.size())
+            {
+                const int rate = arguments.indexOf("--scalar-rate");
+                mix->setScalarSeries(arguments[scalars + 1], rate > 0 && rate + 1 < arguments.size() ? arguments[rate + 1].toDouble() : 0.0);
+            }
+            const int vertexLayout = arguments.indexOf("--vertex-layout");
+            if(vertexLayout > 0 && vertexLayout + 1 < arguments.size())
+            {
+                mix->setVertexLayout(arguments[vertexLayout + 1]);
+            }
+            mix->setDepthPrePass(arguments.contains("--depth-prepass"));
+            mix->setTitleOwner(i == 0);
+            const int trace = arguments.indexOf("--trace");
+            if(i == 0 && trace > 0 && trace + 1 < arguments.size())
+            {
+                mix->setTraceFile(arguments[trace + 1]);
+            }
+            layout->addWidget(mix);
+        }
+        window.resize(640 * viewCount, 480);
+        window.show();
         return app.exec();
     }
+    else if(argv[1][0] == 'b') // Turntable of a GLTF model rendered offscreen
+    {
+        return runBatch(app);
+    }
+    else if(argv[1][0] == 'c') // Conversion of a scalar time series
+    {
+        return runConvert(app);
+    }
     else
     {
-        std::cerr << "Usage: " << argv[0] << " <m> or <t>" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <m> [--benchmark] [--subjects <directory or count>] [--scalars <file> [--scalar-rate <Hz>]] [--trace <file.json or file.csv>] [--views <count>] [--vertex-layout <auto|interleaved|split>] [--depth-prepass] or <t> or <b> <model> [--help] or <c> <input> <output> [--help]" << std::endl;
         return 1;
     }
 